@@ -0,0 +1,174 @@
+#include "aveng_culling.h"
+
+#include <algorithm>
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+	#define AVENG_CULL_AVX 1
+	#define AVENG_CULL_SSE 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define AVENG_CULL_SSE 1
+#endif
+
+namespace aveng {
+
+	Frustum Frustum::fromMatrix(const glm::mat4& m)
+	{
+		// glm is column major, row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+		glm::vec4 row0{ m[0][0], m[1][0], m[2][0], m[3][0] };
+		glm::vec4 row1{ m[0][1], m[1][1], m[2][1], m[3][1] };
+		glm::vec4 row2{ m[0][2], m[1][2], m[2][2], m[3][2] };
+		glm::vec4 row3{ m[0][3], m[1][3], m[2][3], m[3][3] };
+
+		Frustum frustum{};
+		frustum.planes[0] = row3 + row0;	// Left
+		frustum.planes[1] = row3 - row0;	// Right
+		frustum.planes[2] = row3 + row1;	// Bottom
+		frustum.planes[3] = row3 - row1;	// Top
+		frustum.planes[4] = row2;			// Near, clip space depth is [0, 1] (GLM_FORCE_DEPTH_ZERO_TO_ONE)
+		frustum.planes[5] = row3 - row2;	// Far
+
+		for (glm::vec4& plane : frustum.planes)
+		{
+			plane /= glm::length(glm::vec3(plane));
+		}
+		return frustum;
+	}
+
+	size_t cullSpheres(const Frustum& frustum, const SphereBounds& bounds, uint8_t* visible, size_t begin, size_t end)
+	{
+		const float* x = bounds.x.data();
+		const float* y = bounds.y.data();
+		const float* z = bounds.z.data();
+		const float* r = bounds.radius.data();
+		const glm::vec4* planes = frustum.planes;
+
+		size_t visibleCount = 0;
+		size_t i = begin;
+
+#if AVENG_CULL_AVX
+		{
+			__m256 nx[6], ny[6], nz[6], nw[6];
+			for (int p = 0; p < 6; p++)
+			{
+				nx[p] = _mm256_set1_ps(planes[p].x);
+				ny[p] = _mm256_set1_ps(planes[p].y);
+				nz[p] = _mm256_set1_ps(planes[p].z);
+				nw[p] = _mm256_set1_ps(planes[p].w);
+			}
+
+			for (; i + 8 <= end; i += 8)
+			{
+				__m256 cx = _mm256_loadu_ps(x + i);
+				__m256 cy = _mm256_loadu_ps(y + i);
+				__m256 cz = _mm256_loadu_ps(z + i);
+				__m256 negR = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(r + i));
+
+				// A sphere is out when it lies entirely behind any one plane
+				__m256 outside = _mm256_setzero_ps();
+				for (int p = 0; p < 6; p++)
+				{
+					__m256 distance = _mm256_add_ps(
+						_mm256_add_ps(_mm256_mul_ps(nx[p], cx), _mm256_mul_ps(ny[p], cy)),
+						_mm256_add_ps(_mm256_mul_ps(nz[p], cz), nw[p]));
+					outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, negR, _CMP_LT_OQ));
+				}
+
+				int mask = _mm256_movemask_ps(outside);
+				for (int lane = 0; lane < 8; lane++)
+				{
+					uint8_t in = !((mask >> lane) & 1);
+					visible[i + lane] = in;
+					visibleCount += in;
+				}
+			}
+		}
+#endif
+
+#if AVENG_CULL_SSE
+		{
+			__m128 nx[6], ny[6], nz[6], nw[6];
+			for (int p = 0; p < 6; p++)
+			{
+				nx[p] = _mm_set1_ps(planes[p].x);
+				ny[p] = _mm_set1_ps(planes[p].y);
+				nz[p] = _mm_set1_ps(planes[p].z);
+				nw[p] = _mm_set1_ps(planes[p].w);
+			}
+
+			for (; i + 4 <= end; i += 4)
+			{
+				__m128 cx = _mm_loadu_ps(x + i);
+				__m128 cy = _mm_loadu_ps(y + i);
+				__m128 cz = _mm_loadu_ps(z + i);
+				__m128 negR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(r + i));
+
+				__m128 outside = _mm_setzero_ps();
+				for (int p = 0; p < 6; p++)
+				{
+					__m128 distance = _mm_add_ps(
+						_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)),
+						_mm_add_ps(_mm_mul_ps(nz[p], cz), nw[p]));
+					outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negR));
+				}
+
+				int mask = _mm_movemask_ps(outside);
+				for (int lane = 0; lane < 4; lane++)
+				{
+					uint8_t in = !((mask >> lane) & 1);
+					visible[i + lane] = in;
+					visibleCount += in;
+				}
+			}
+		}
+#endif
+
+		// Remainder, or everything on targets without SSE
+		for (; i < end; i++)
+		{
+			uint8_t in = 1;
+			for (int p = 0; p < 6; p++)
+			{
+				float distance = planes[p].x * x[i] + planes[p].y * y[i] + planes[p].z * z[i] + planes[p].w;
+				if (distance < -r[i]) { in = 0; break; }
+			}
+			visible[i] = in;
+			visibleCount += in;
+		}
+
+		return visibleCount;
+	}
+
+	size_t cullSpheresParallel(const Frustum& frustum, const SphereBounds& bounds, uint8_t* visible, ThreadPool* workers, size_t minPerThread)
+	{
+		size_t count = bounds.size();
+		size_t threadCount = workers ? workers->threads.size() : 0;
+
+		// Participants are the workers plus this thread, but never so many that a batch drops below minPerThread
+		size_t participants = std::min(threadCount + 1, std::max<size_t>(1, count / minPerThread));
+		if (participants <= 1)
+		{
+			return cullSpheres(frustum, bounds, visible, 0, count);
+		}
+
+		// Batches are kept a multiple of 8 so each one stays on the wide path
+		size_t batch = ((count + participants - 1) / participants + 7) & ~size_t(7);
+
+		// Scratch from wherever the bounds came from, the frame arena on the render paths
+		std::pmr::vector<size_t> visibleCounts(participants, 0, bounds.x.get_allocator().resource());
+		for (size_t t = 1; t < participants; t++)
+		{
+			size_t begin = std::min(count, t * batch);
+			size_t end = std::min(count, begin + batch);
+			workers->threads[t - 1]->addJob([&, t, begin, end] {
+				visibleCounts[t] = cullSpheres(frustum, bounds, visible, begin, end);
+			});
+		}
+		visibleCounts[0] = cullSpheres(frustum, bounds, visible, 0, std::min(count, batch));
+		workers->wait();
+
+		return std::accumulate(visibleCounts.begin(), visibleCounts.end(), size_t{ 0 });
+	}
+
+}
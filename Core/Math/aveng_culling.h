@@ -0,0 +1,51 @@
+#pragma once
+#include "../../avpch.h"
+#include "../Utils/threadpool.h"
+
+#include <cstdint>
+#include <memory_resource>
+
+namespace aveng {
+
+	/*
+	* The 6 planes bounding a camera's view volume, extracted from projection * view
+	* (Gribb / Hartmann). xyz is the inward facing unit normal and w the distance, so a
+	* point p is inside a plane when dot(xyz, p) + w >= 0.
+	*/
+	struct Frustum {
+		glm::vec4 planes[6];
+
+		static Frustum fromMatrix(const glm::mat4& projectionView);
+	};
+
+	/*
+	* World space bounding spheres as a structure of arrays, so the culling kernel can
+	* load 4 (SSE) or 8 (AVX) of each component at once.
+	*/
+	struct SphereBounds {
+		std::pmr::vector<float> x;
+		std::pmr::vector<float> y;
+		std::pmr::vector<float> z;
+		std::pmr::vector<float> radius;
+
+		explicit SphereBounds(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: x{ resource }, y{ resource }, z{ resource }, radius{ resource } {}
+
+		void reserve(size_t count) { x.reserve(count); y.reserve(count); z.reserve(count); radius.reserve(count); }
+		void push(const glm::vec3& center, float r) { x.push_back(center.x); y.push_back(center.y); z.push_back(center.z); radius.push_back(r); }
+		size_t size() const { return x.size(); }
+	};
+
+	/*
+	* Test spheres [begin, end) against the frustum. visible[i] is set to 1 for spheres touching the
+	* view volume and 0 for the rest. Returns the number of visible spheres in the range.
+	*/
+	size_t cullSpheres(const Frustum& frustum, const SphereBounds& bounds, uint8_t* visible, size_t begin, size_t end);
+
+	/*
+	* cullSpheres over every sphere, split across the pool's threads (and the calling thread)
+	* once there are at least minPerThread spheres per participant.
+	*/
+	size_t cullSpheresParallel(const Frustum& frustum, const SphereBounds& bounds, uint8_t* visible, ThreadPool* workers, size_t minPerThread = 4096);
+
+}
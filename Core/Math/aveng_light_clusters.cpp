@@ -0,0 +1,202 @@
+#include "aveng_light_clusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace aveng {
+
+	namespace {
+
+		// A light in view space, and the run of slices its sphere overlaps. lastSlice < firstSlice when it's out of view
+		struct ViewLight {
+			glm::vec3 center;
+			float radius;
+			uint32_t firstSlice;
+			uint32_t lastSlice;
+		};
+
+		struct TileRect {
+			uint32_t x0, x1, y0, y1;
+		};
+
+		/*
+		* The tiles covered by the part of a sphere between view depths d0 and d1, both in front of the camera.
+		* That part fits in a box as wide as the sphere's widest cross section in the range, and x / z is
+		* monotonic in both, so the box's corners bound its projection.
+		*/
+		bool tileRect(const ViewLight& light, float d0, float d1, const glm::mat4& projection, TileRect& rect)
+		{
+			float closest = std::clamp(light.center.z, d0, d1) - light.center.z;
+			float halfWidth = std::sqrt(std::max(light.radius * light.radius - closest * closest, 0.f));
+
+			float minX = 1e30f, maxX = -1e30f, minY = 1e30f, maxY = -1e30f;
+			for (float depth : { d0, d1 })
+			{
+				for (float side : { -halfWidth, halfWidth })
+				{
+					float x = (projection[0][0] * (light.center.x + side) + projection[2][0] * depth) / depth;
+					float y = (projection[1][1] * (light.center.y + side) + projection[2][1] * depth) / depth;
+					minX = std::min(minX, x); maxX = std::max(maxX, x);
+					minY = std::min(minY, y); maxY = std::max(maxY, y);
+				}
+			}
+			if (maxX < -1.f || minX > 1.f || maxY < -1.f || minY > 1.f) return false;
+
+			auto tile = [](float ndc, uint32_t tiles) {
+				float t = std::floor((ndc + 1.f) * .5f * static_cast<float>(tiles));
+				return static_cast<uint32_t>(std::clamp(t, 0.f, static_cast<float>(tiles - 1)));
+			};
+			rect = { tile(minX, LightClusterGrid::X), tile(maxX, LightClusterGrid::X), tile(minY, LightClusterGrid::Y), tile(maxY, LightClusterGrid::Y) };
+			return true;
+		}
+
+		/*
+		* Call visit(cluster, light) for every cluster in slices [sliceBegin, sliceEnd) that a light touches,
+		* lights in order. The counting and filling passes both go through here so they always agree.
+		*/
+		template<typename Visit>
+		void forEachOverlap(const ViewLight* views, uint32_t lightCount, const float* sliceDepths, const glm::mat4& projection,
+			uint32_t sliceBegin, uint32_t sliceEnd, Visit&& visit)
+		{
+			for (uint32_t l = 0; l < lightCount; l++)
+			{
+				const ViewLight& light = views[l];
+				uint32_t first = std::max(light.firstSlice, sliceBegin);
+				uint32_t last = std::min(light.lastSlice + 1, sliceEnd);
+				for (uint32_t s = first; s < last; s++)
+				{
+					float d0 = std::max(sliceDepths[s], light.center.z - light.radius);
+					float d1 = std::min(sliceDepths[s + 1], light.center.z + light.radius);
+					TileRect rect;
+					if (!tileRect(light, d0, d1, projection, rect)) continue;
+
+					for (uint32_t y = rect.y0; y <= rect.y1; y++)
+					{
+						uint32_t row = (s * LightClusterGrid::Y + y) * LightClusterGrid::X;
+						for (uint32_t x = rect.x0; x <= rect.x1; x++) visit(row + x, l);
+					}
+				}
+			}
+		}
+
+		// fn(begin, end) over [0, count) in participants runs, the first on this thread
+		template<typename Fn>
+		void splitAcross(ThreadPool* workers, size_t count, size_t participants, Fn&& fn)
+		{
+			if (participants <= 1)
+			{
+				fn(size_t{ 0 }, count);
+				return;
+			}
+
+			size_t chunk = (count + participants - 1) / participants;
+			for (size_t t = 1; t < participants; t++)
+			{
+				size_t begin = std::min(count, t * chunk);
+				size_t end = std::min(count, begin + chunk);
+				workers->threads[t - 1]->addJob([&fn, begin, end] { fn(begin, end); });
+			}
+			fn(size_t{ 0 }, std::min(count, chunk));
+			workers->wait();
+		}
+
+	}
+
+	LightClusterGrid LightClusterGrid::fromDepthRange(float zNear, float zFar)
+	{
+		float logRange = std::log(zFar / zNear);
+		return { zNear, zFar, Z / logRange, -static_cast<float>(Z) * std::log(zNear) / logRange };
+	}
+
+	uint32_t LightClusterGrid::slice(float depth) const
+	{
+		float s = std::floor(std::log(std::max(depth, zNear)) * sliceScale + sliceBias);
+		return static_cast<uint32_t>(std::clamp(s, 0.f, static_cast<float>(Z - 1)));
+	}
+
+	float LightClusterGrid::sliceNear(uint32_t slice) const
+	{
+		return zNear * std::pow(zFar / zNear, static_cast<float>(slice) / Z);
+	}
+
+	LightClusterStats assignLightClusters(
+		const LightClusterGrid& grid,
+		const GpuPointLight* lights,
+		uint32_t lightCount,
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		glm::uvec2* clusters,
+		uint32_t* indices,
+		uint32_t indexCapacity,
+		ThreadPool* workers,
+		std::pmr::memory_resource* resource,
+		size_t minPerThread)
+	{
+		LightClusterStats stats{};
+		stats.lights = lightCount;
+
+		size_t threadCount = workers ? workers->threads.size() : 0;
+		size_t participants = std::min(threadCount + 1, std::max<size_t>(1, lightCount / minPerThread));
+
+		// Into view space, and out early if nowhere between the near and far planes
+		std::pmr::vector<ViewLight> views(lightCount, resource);
+		splitAcross(workers, lightCount, participants, [&](size_t begin, size_t end) {
+			for (size_t l = begin; l < end; l++)
+			{
+				ViewLight& light = views[l];
+				light.center = glm::vec3(view * glm::vec4(glm::vec3(lights[l].position), 1.f));
+				light.radius = lights[l].position.w;
+
+				float zMin = light.center.z - light.radius;
+				float zMax = light.center.z + light.radius;
+				if (zMax < grid.zNear || zMin > grid.zFar)
+				{
+					light.firstSlice = 1;
+					light.lastSlice = 0;
+					continue;
+				}
+				light.firstSlice = grid.slice(zMin);
+				light.lastSlice = grid.slice(zMax);
+			}
+		});
+
+		float sliceDepths[LightClusterGrid::Z + 1];
+		for (uint32_t s = 0; s <= LightClusterGrid::Z; s++) sliceDepths[s] = grid.sliceNear(s);
+		sliceDepths[LightClusterGrid::Z] = grid.zFar;
+
+		// Slices own disjoint runs of clusters, so each participant counts and fills its own without sharing
+		size_t sliceParticipants = std::min<size_t>(participants, LightClusterGrid::Z);
+		std::pmr::vector<uint32_t> counts(LightClusterGrid::COUNT, 0u, resource);
+		splitAcross(workers, LightClusterGrid::Z, sliceParticipants, [&](size_t begin, size_t end) {
+			forEachOverlap(views.data(), lightCount, sliceDepths, projection, static_cast<uint32_t>(begin), static_cast<uint32_t>(end),
+				[&](uint32_t cluster, uint32_t) { counts[cluster]++; });
+		});
+
+		// Offsets, with the lists that don't fit cut short. The mapped clusters are only written, never read back
+		std::pmr::vector<uint32_t> limits(LightClusterGrid::COUNT, resource);
+		uint32_t offset = 0;
+		for (uint32_t c = 0; c < LightClusterGrid::COUNT; c++)
+		{
+			uint32_t count = std::min(counts[c], indexCapacity - offset);
+			stats.overflowed |= count < counts[c];
+			stats.maxPerCluster = std::max(stats.maxPerCluster, counts[c]);
+			stats.activeClusters += counts[c] > 0;
+
+			clusters[c] = glm::uvec2(offset, count);
+			limits[c] = offset + count;
+			counts[c] = offset;
+			offset += count;
+		}
+		stats.indices = offset;
+
+		splitAcross(workers, LightClusterGrid::Z, sliceParticipants, [&](size_t begin, size_t end) {
+			forEachOverlap(views.data(), lightCount, sliceDepths, projection, static_cast<uint32_t>(begin), static_cast<uint32_t>(end),
+				[&](uint32_t cluster, uint32_t light) {
+					if (counts[cluster] < limits[cluster]) indices[counts[cluster]++] = light;
+				});
+		});
+
+		return stats;
+	}
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "../../avpch.h"
+#include "../Utils/threadpool.h"
+
+#include <cstdint>
+#include <memory_resource>
+
+namespace aveng {
+
+	// A point light as the fragment shaders read it from the light buffer, std430
+	struct GpuPointLight {
+		glm::vec4 position;		// World space, w is the radius past which it adds nothing
+		glm::vec4 color;		// w is intensity
+	};
+
+	/*
+	* The view volume cut into X * Y screen tiles and Z depth slices. Slices are spaced exponentially
+	* between the near and far planes, so a cluster is roughly as deep as it is wide at any distance. A fragment
+	* finds its cluster from gl_FragCoord and its view depth, see clusterLighting in simple_shader.frag.
+	* Clusters are numbered x first, then y, then z.
+	*/
+	struct LightClusterGrid {
+		static constexpr uint32_t X = 16;
+		static constexpr uint32_t Y = 9;
+		static constexpr uint32_t Z = 24;
+		static constexpr uint32_t COUNT = X * Y * Z;
+
+		float zNear;
+		float zFar;
+		float sliceScale;		// slice = log(depth) * sliceScale + sliceBias
+		float sliceBias;
+
+		static LightClusterGrid fromDepthRange(float zNear, float zFar);
+
+		uint32_t slice(float depth) const;
+		float sliceNear(uint32_t slice) const;		// View depth where a slice begins
+	};
+
+	struct LightClusterStats {
+		uint32_t lights = 0;
+		uint32_t indices = 0;			// Light references written across every cluster
+		uint32_t maxPerCluster = 0;
+		uint32_t activeClusters = 0;	// Clusters touched by at least one light
+		bool overflowed = false;		// Some lists were cut short to fit indexCapacity
+	};
+
+	/*
+	* Assign lights to the clusters of one camera. The projection is assumed to be a perspective one
+	* with w = view z, as AvengCamera::setPerspectiveProjection builds. clusters receives an offset and
+	* a count per cluster, indices the light indices each cluster's range refers to, in light order.
+	* A light is tested slice by slice against the screen rectangle of the part of its sphere inside
+	* that slice, rather than once against its whole sphere.
+	*
+	* Each light's view space bounds are found on the pool's threads, then each participant counts and
+	* fills the clusters of its own run of slices, so nothing is shared between them. Lists that would
+	* run past indexCapacity are cut short. Scratch comes from resource.
+	*/
+	LightClusterStats assignLightClusters(
+		const LightClusterGrid& grid,
+		const GpuPointLight* lights,
+		uint32_t lightCount,
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		glm::uvec2* clusters,
+		uint32_t* indices,
+		uint32_t indexCapacity,
+		ThreadPool* workers,
+		std::pmr::memory_resource* resource,
+		size_t minPerThread = 256);
+
+}
@@ -25,4 +25,57 @@ namespace aveng {
 		return glm::vec3{ cos(degreesXZ), sin(degreesXZ), sin(degreesYZ) };
 	}
 
-}
+	glm::quat quatFromEulerYXZ(const glm::vec3& angles)
+	{
+		const glm::vec3 half = angles * 0.5f;
+		const glm::quat yaw{ glm::cos(half.y), 0.f, glm::sin(half.y), 0.f };
+		const glm::quat pitch{ glm::cos(half.x), glm::sin(half.x), 0.f, 0.f };
+		const glm::quat roll{ glm::cos(half.z), 0.f, 0.f, glm::sin(half.z) };
+		return yaw * pitch * roll;
+	}
+
+	glm::vec3 eulerYXZFromQuat(const glm::quat& q)
+	{
+		// The matrix terms of Ry * Rx * Rz that isolate each angle
+		const float m21 = 2.f * (q.y * q.z - q.w * q.x);			// -sin(x)
+		const float m20 = 2.f * (q.x * q.z + q.w * q.y);			// cos(x) sin(y)
+		const float m22 = 1.f - 2.f * (q.x * q.x + q.y * q.y);	// cos(x) cos(y)
+		const float m01 = 2.f * (q.x * q.y + q.w * q.z);			// cos(x) sin(z)
+		const float m11 = 1.f - 2.f * (q.x * q.x + q.z * q.z);	// cos(x) cos(z)
+
+		const float pitch = glm::asin(glm::clamp(-m21, -1.f, 1.f));
+		if (glm::abs(m21) < 0.9999f)
+		{
+			return { pitch, glm::atan(m20, m22), glm::atan(m01, m11) };
+		}
+
+		// Looking straight up or down, yaw and roll share an axis, so it all goes to yaw
+		const float m00 = 1.f - 2.f * (q.y * q.y + q.z * q.z);
+		const float m02 = 2.f * (q.x * q.z - q.w * q.y);
+		return { pitch, glm::atan(-m02, m00), 0.f };
+	}
+
+	glm::quat quatNlerp(const glm::quat& from, const glm::quat& to, float t)
+	{
+		// q and -q are the same rotation, flip to so the blend takes the short way round
+		const float sign = glm::dot(from, to) < 0.f ? -1.f : 1.f;
+		return glm::normalize(from * (1.f - t) + to * (sign * t));
+	}
+
+	glm::quat quatSlerp(const glm::quat& from, const glm::quat& to, float t)
+	{
+		float cosTheta = glm::dot(from, to);
+		glm::quat target = to;
+		if (cosTheta < 0.f)
+		{
+			cosTheta = -cosTheta;
+			target = -to;
+		}
+		if (cosTheta > 0.9995f) return quatNlerp(from, target, t);
+
+		const float theta = glm::acos(cosTheta);
+		const float inverseSin = 1.f / glm::sin(theta);
+		return from * (glm::sin((1.f - t) * theta) * inverseSin) + target * (glm::sin(t * theta) * inverseSin);
+	}
+
+}
\ No newline at end of file
@@ -1,9 +1,23 @@
 #pragma once
 #include "../../avpch.h"
+#include <glm/gtc/quaternion.hpp>
 
 namespace aveng {
 
 	glm::vec3 unitCircleTransform_vec3(float theta, glm::vec3 viewerTranslation, float radius, float modPI, glm::vec3 playerTranslation);
 	glm::vec3 unitSphereTransform_vec3(float theta, float omega, float alpha);
 
+	/*
+	* Tait-Bryan angles Y(1), X(2), Z(3), the order TransformComponent and AvengCamera::setViewYXZ use,
+	* to and from the quaternion Ry * Rx * Rz. Pitch (x) comes back in [-pi/2, pi/2], yaw and roll in [-pi, pi].
+	*/
+	glm::quat quatFromEulerYXZ(const glm::vec3& angles);
+	glm::vec3 eulerYXZFromQuat(const glm::quat& q);
+
+	// Normalized lerp along the shorter arc. Not constant speed, but close for the small steps between simulation states
+	glm::quat quatNlerp(const glm::quat& from, const glm::quat& to, float t);
+
+	// Constant speed along the shorter arc, falls back to quatNlerp where the two are too close for acos to be stable
+	glm::quat quatSlerp(const glm::quat& from, const glm::quat& to, float t);
+
 }
\ No newline at end of file
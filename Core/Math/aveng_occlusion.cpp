@@ -0,0 +1,332 @@
+#include "aveng_occlusion.h"
+#include "../aveng_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define AVENG_OCCLUSION_SSE 1
+#endif
+
+namespace aveng {
+
+	// Clip space w below this is treated as on or behind the camera
+	static constexpr float MIN_W = 1e-5f;
+
+	std::shared_ptr<OccluderMesh> OccluderMesh::fromFile(const std::string& filepath)
+	{
+		AvengModel::Builder builder{};
+		builder.loadModel(filepath);
+
+		auto mesh = std::make_shared<OccluderMesh>();
+		mesh->positions.reserve(builder.vertices.size());
+		for (const AvengModel::Vertex& vertex : builder.vertices)
+		{
+			mesh->positions.push_back(vertex.position);
+		}
+
+		if (builder.indices.empty())
+		{
+			mesh->indices.resize(mesh->positions.size());
+			std::iota(mesh->indices.begin(), mesh->indices.end(), 0u);
+		}
+		else
+		{
+			mesh->indices = std::move(builder.indices);
+		}
+		return mesh;
+	}
+
+	std::shared_ptr<OccluderMesh> OccluderMesh::box(const glm::vec3& center, const glm::vec3& extents)
+	{
+		auto mesh = std::make_shared<OccluderMesh>();
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec3 sign{ corner & 1 ? 1.f : -1.f, corner & 2 ? 1.f : -1.f, corner & 4 ? 1.f : -1.f };
+			mesh->positions.push_back(center + sign * extents);
+		}
+
+		// Two triangles per face, winding doesn't matter to the rasterizer
+		mesh->indices = {
+			0, 1, 3,  0, 3, 2,		// -z
+			4, 5, 7,  4, 7, 6,		// +z
+			0, 1, 5,  0, 5, 4,		// -y
+			2, 3, 7,  2, 7, 6,		// +y
+			0, 2, 6,  0, 6, 4,		// -x
+			1, 3, 7,  1, 7, 5		// +x
+		};
+		return mesh;
+	}
+
+	OcclusionBuffer::OcclusionBuffer()
+		: depth(WIDTH * HEIGHT, 1.f)
+	{
+		static_assert(WIDTH % 4 == 0, "Rows are rasterized 4 pixels at a time");
+	}
+
+	void OcclusionBuffer::begin(const glm::mat4& viewProjection)
+	{
+		projectionView = viewProjection;
+		triangles.clear();
+	}
+
+	void OcclusionBuffer::addOccluder(const OccluderMesh& mesh, const glm::mat4& model)
+	{
+		glm::mat4 toClip = projectionView * model;
+
+		clipScratch.resize(mesh.positions.size());
+		for (size_t v = 0; v < mesh.positions.size(); v++)
+		{
+			clipScratch[v] = toClip * glm::vec4(mesh.positions[v], 1.f);
+		}
+
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			ScreenTriangle triangle{};
+			float z[3];
+			bool usable = true;
+
+			for (int k = 0; k < 3; k++)
+			{
+				const glm::vec4& clip = clipScratch[mesh.indices[i + k]];
+
+				// Clipping isn't worth it here, a dropped triangle only means less occlusion
+				if (clip.w <= MIN_W || clip.z < 0.f) { usable = false; break; }
+
+				float invW = 1.f / clip.w;
+				triangle.x[k] = (clip.x * invW * 0.5f + 0.5f) * WIDTH;
+				triangle.y[k] = (clip.y * invW * 0.5f + 0.5f) * HEIGHT;
+				z[k] = clip.z * invW;
+			}
+			if (!usable) continue;
+
+			float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0])
+					   - (triangle.y[1] - triangle.y[0]) * (triangle.x[2] - triangle.x[0]);
+
+			// Occluders are drawn double sided, flip clockwise triangles so every edge function is positive inside
+			if (area < 0.f)
+			{
+				std::swap(triangle.x[1], triangle.x[2]);
+				std::swap(triangle.y[1], triangle.y[2]);
+				std::swap(z[1], z[2]);
+				area = -area;
+			}
+			if (area < 1e-6f) continue;
+
+			float minX = std::min({ triangle.x[0], triangle.x[1], triangle.x[2] });
+			float maxX = std::max({ triangle.x[0], triangle.x[1], triangle.x[2] });
+			float minY = std::min({ triangle.y[0], triangle.y[1], triangle.y[2] });
+			float maxY = std::max({ triangle.y[0], triangle.y[1], triangle.y[2] });
+
+			// Pixels whose centers (x + 0.5) can fall inside
+			triangle.minX = std::max(0, static_cast<int>(std::ceil(minX - 0.5f)));
+			triangle.maxX = std::min(static_cast<int>(WIDTH) - 1, static_cast<int>(std::floor(maxX - 0.5f)));
+			triangle.minY = std::max(0, static_cast<int>(std::ceil(minY - 0.5f)));
+			triangle.maxY = std::min(static_cast<int>(HEIGHT) - 1, static_cast<int>(std::floor(maxY - 0.5f)));
+			if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) continue;
+
+			float d1x = triangle.x[1] - triangle.x[0], d1y = triangle.y[1] - triangle.y[0];
+			float d2x = triangle.x[2] - triangle.x[0], d2y = triangle.y[2] - triangle.y[0];
+			triangle.z0 = z[0];
+			triangle.dzdx = ((z[1] - z[0]) * d2y - (z[2] - z[0]) * d1y) / area;
+			triangle.dzdy = ((z[2] - z[0]) * d1x - (z[1] - z[0]) * d2x) / area;
+
+			triangles.push_back(triangle);
+		}
+	}
+
+	/*
+	* Every triangle over the rows [rowBegin, rowEnd). Edge (i, j) is the function
+	* (xj - xi)(py - yi) - (yj - yi)(px - xi), non negative on the inside of a counter clockwise triangle.
+	*/
+	void OcclusionBuffer::rasterizeRows(int rowBegin, int rowEnd)
+	{
+		std::fill(depth.begin() + rowBegin * WIDTH, depth.begin() + rowEnd * WIDTH, 1.f);
+
+		for (const ScreenTriangle& triangle : triangles)
+		{
+			int yBegin = std::max(triangle.minY, rowBegin);
+			int yEnd = std::min(triangle.maxY + 1, rowEnd);
+			if (yBegin >= yEnd) continue;
+
+			// Each edge as a * px + b * py + c
+			float a[3], b[3], c[3];
+			for (int e = 0; e < 3; e++)
+			{
+				int j = (e + 1) % 3;
+				a[e] = -(triangle.y[j] - triangle.y[e]);
+				b[e] = triangle.x[j] - triangle.x[e];
+				c[e] = -b[e] * triangle.y[e] - a[e] * triangle.x[e];
+			}
+			float zc = triangle.z0 - triangle.dzdx * triangle.x[0] - triangle.dzdy * triangle.y[0];
+
+			int xBegin = triangle.minX & ~3;
+			int xEnd = triangle.maxX + 1;
+
+			for (int y = yBegin; y < yEnd; y++)
+			{
+				float py = y + 0.5f;
+				float* row = depth.data() + y * WIDTH;
+				int x = xBegin;
+
+#if AVENG_OCCLUSION_SSE
+				__m128 stepX = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+				__m128 zero = _mm_setzero_ps();
+				__m128 edgeA[3], edgeRow[3];
+				for (int e = 0; e < 3; e++)
+				{
+					edgeA[e] = _mm_set1_ps(a[e]);
+					edgeRow[e] = _mm_set1_ps(b[e] * py + c[e]);
+				}
+				__m128 dzdx = _mm_set1_ps(triangle.dzdx);
+				__m128 zRow = _mm_set1_ps(triangle.dzdy * py + zc);
+
+				for (; x < xEnd; x += 4)
+				{
+					__m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), stepX);
+
+					__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], px), edgeRow[0]), zero);
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], px), edgeRow[1]), zero));
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], px), edgeRow[2]), zero));
+					if (_mm_movemask_ps(inside) == 0) continue;
+
+					__m128 z = _mm_add_ps(_mm_mul_ps(dzdx, px), zRow);
+					__m128 stored = _mm_loadu_ps(row + x);
+					__m128 nearest = _mm_min_ps(stored, z);
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, stored)));
+				}
+#endif
+
+				for (; x < xEnd; x++)
+				{
+					float px = x + 0.5f;
+					if (a[0] * px + b[0] * py + c[0] < 0.f) continue;
+					if (a[1] * px + b[1] * py + c[1] < 0.f) continue;
+					if (a[2] * px + b[2] * py + c[2] < 0.f) continue;
+
+					float z = triangle.dzdx * px + triangle.dzdy * py + zc;
+					row[x] = std::min(row[x], z);
+				}
+			}
+		}
+	}
+
+	void OcclusionBuffer::rasterize(ThreadPool* workers)
+	{
+		size_t threadCount = workers ? workers->threads.size() : 0;
+
+		// Bands of at least 8 rows, and none at all when there's nothing to draw
+		size_t participants = triangles.empty() ? 1 : std::min(threadCount + 1, size_t{ HEIGHT / 8 });
+		if (participants <= 1)
+		{
+			rasterizeRows(0, HEIGHT);
+			return;
+		}
+
+		int band = static_cast<int>((HEIGHT + participants - 1) / participants);
+		for (size_t t = 1; t < participants; t++)
+		{
+			int begin = std::min(static_cast<int>(HEIGHT), static_cast<int>(t) * band);
+			int end = std::min(static_cast<int>(HEIGHT), begin + band);
+			workers->threads[t - 1]->addJob([this, begin, end] { rasterizeRows(begin, end); });
+		}
+		rasterizeRows(0, std::min(static_cast<int>(HEIGHT), band));
+		workers->wait();
+	}
+
+	bool OcclusionBuffer::isOccluded(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+	{
+		float minX = static_cast<float>(WIDTH), maxX = 0.f;
+		float minY = static_cast<float>(HEIGHT), maxY = 0.f;
+		float nearest = 1.f;
+
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec4 clip = projectionView * glm::vec4(
+				corner & 1 ? boxMax.x : boxMin.x,
+				corner & 2 ? boxMax.y : boxMin.y,
+				corner & 4 ? boxMax.z : boxMin.z,
+				1.f);
+
+			// Reaching the camera, nothing can be in front of it
+			if (clip.w <= MIN_W) return false;
+
+			float invW = 1.f / clip.w;
+			float x = (clip.x * invW * 0.5f + 0.5f) * WIDTH;
+			float y = (clip.y * invW * 0.5f + 0.5f) * HEIGHT;
+			minX = std::min(minX, x); maxX = std::max(maxX, x);
+			minY = std::min(minY, y); maxY = std::max(maxY, y);
+			nearest = std::min(nearest, clip.z * invW);
+		}
+		if (nearest <= 0.f) return false;
+
+		// Every pixel the rectangle touches, not just those whose centers it covers
+		int x0 = std::max(0, static_cast<int>(std::floor(minX)));
+		int x1 = std::min(static_cast<int>(WIDTH), static_cast<int>(std::ceil(maxX)));
+		int y0 = std::max(0, static_cast<int>(std::floor(minY)));
+		int y1 = std::min(static_cast<int>(HEIGHT), static_cast<int>(std::ceil(maxY)));
+		if (x0 >= x1 || y0 >= y1) return false;
+
+		for (int y = y0; y < y1; y++)
+		{
+			const float* row = depth.data() + y * WIDTH;
+			int x = x0;
+
+#if AVENG_OCCLUSION_SSE
+			__m128 boxDepth = _mm_set1_ps(nearest);
+			for (; x + 4 <= x1; x += 4)
+			{
+				// Visible as soon as one pixel's occluder is at or behind the box
+				if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), boxDepth)) != 0) return false;
+			}
+#endif
+
+			for (; x < x1; x++)
+			{
+				if (row[x] >= nearest) return false;
+			}
+		}
+		return true;
+	}
+
+	size_t OcclusionBuffer::testBoxes(const glm::vec3* boxMin, const glm::vec3* boxMax, uint8_t* visible, size_t count, ThreadPool* workers) const
+	{
+		auto testRange = [&](size_t begin, size_t end) {
+			size_t occluded = 0;
+			for (size_t i = begin; i < end; i++)
+			{
+				if (visible[i] && isOccluded(boxMin[i], boxMax[i]))
+				{
+					visible[i] = 0;
+					occluded++;
+				}
+			}
+			return occluded;
+		};
+
+		if (triangles.empty()) return 0;
+
+		size_t threadCount = workers ? workers->threads.size() : 0;
+		size_t participants = std::min(threadCount + 1, std::max<size_t>(1, count / 256));
+		if (participants <= 1)
+		{
+			return testRange(0, count);
+		}
+
+		size_t batch = (count + participants - 1) / participants;
+		occludedCounts.assign(participants, 0);
+		for (size_t t = 1; t < participants; t++)
+		{
+			size_t begin = std::min(count, t * batch);
+			size_t end = std::min(count, begin + batch);
+			workers->threads[t - 1]->addJob([&, t, begin, end] { occludedCounts[t] = testRange(begin, end); });
+		}
+		occludedCounts[0] = testRange(0, std::min(count, batch));
+		workers->wait();
+
+		return std::accumulate(occludedCounts.begin(), occludedCounts.end(), size_t{ 0 });
+	}
+
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "../../avpch.h"
+#include "../Utils/threadpool.h"
+
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string>
+
+namespace aveng {
+
+	// Triangles an object hides the scene with. Usually far fewer than the mesh it's drawn with
+	struct OccluderMesh {
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+
+		// Every triangle of an .obj, positions only
+		static std::shared_ptr<OccluderMesh> fromFile(const std::string& filepath);
+
+		// A closed box, e.g. the inside of a hull
+		static std::shared_ptr<OccluderMesh> box(const glm::vec3& center, const glm::vec3& extents);
+	};
+
+	/*
+	* @class OcclusionBuffer
+	* A small software depth buffer for occlusion culling on the CPU, for when culling on the GPU isn't available.
+	*
+	* Designated occluders are transformed, set up as screen space triangles, and rasterized 4 pixels at a
+	* time, keeping the nearest depth per pixel. The buffer is split into horizontal bands, one per
+	* ThreadPool participant, so bands never share pixels. Objects are then tested by the screen
+	* rectangle of their world space box: hidden when every pixel under it holds an occluder nearer
+	* than the box's nearest corner.
+	*
+	* Depth is clip space z / w, [0, 1] with 1 the far plane, which is affine in screen space
+	* and so is interpolated exactly across a triangle.
+	*/
+	class OcclusionBuffer {
+
+	public:
+
+		static constexpr uint32_t WIDTH = 256;		// Multiple of 4
+		static constexpr uint32_t HEIGHT = 144;
+
+		OcclusionBuffer();
+
+		// Start a frame, dropping last frame's occluders
+		void begin(const glm::mat4& projectionView);
+
+		// Queue an occluder's triangles. Triangles crossing the near plane are skipped, which only loses occlusion
+		void addOccluder(const OccluderMesh& mesh, const glm::mat4& model);
+
+		// Clear and draw every queued triangle
+		void rasterize(ThreadPool* workers);
+
+		// Whether the world space box [boxMin, boxMax] is hidden behind what was rasterized
+		bool isOccluded(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
+		/*
+		* isOccluded over count boxes, split across the pool's threads. visible[i] is cleared for
+		* hidden boxes and left alone otherwise. Returns the number of boxes found hidden.
+		*/
+		size_t testBoxes(const glm::vec3* boxMin, const glm::vec3* boxMax, uint8_t* visible, size_t count, ThreadPool* workers) const;
+
+		size_t triangleCount() const { return triangles.size(); }
+		const float* depthData() const { return depth.data(); }
+
+	private:
+
+		struct ScreenTriangle {
+			float x[3];
+			float y[3];
+			float z0, dzdx, dzdy;		// Depth plane through vertex 0
+			int minX, maxX, minY, maxY;	// Pixel bounds, clamped to the buffer
+		};
+
+		void rasterizeRows(int rowBegin, int rowEnd);
+
+		glm::mat4 projectionView{ 1.f };
+		std::vector<ScreenTriangle> triangles;
+		std::vector<glm::vec4> clipScratch;
+		std::vector<float> depth;
+		mutable std::vector<size_t> occludedCounts;		// testBoxes' per participant results, kept so it doesn't allocate
+
+	};
+
+}
@@ -0,0 +1,311 @@
+#include "aveng_transform_batch.h"
+#include "../Scene/aveng_registry.h"
+#include "../Scene/AvengComponent.h"
+#include "aveng_math.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+	#define AVENG_XFORM_AVX 1
+	#define AVENG_XFORM_SSE 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define AVENG_XFORM_SSE 1
+#endif
+
+namespace aveng {
+
+#if AVENG_XFORM_SSE
+	// Column `column` of 4 consecutive matrices, from one vector per row
+	static inline void storeColumns4(glm::mat4* out, int column, __m128 x, __m128 y, __m128 z, __m128 w)
+	{
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		_mm_storeu_ps(&out[0][column].x, x);
+		_mm_storeu_ps(&out[1][column].x, y);
+		_mm_storeu_ps(&out[2][column].x, z);
+		_mm_storeu_ps(&out[3][column].x, w);
+	}
+
+	// out[k][column][row] = m[column * 3 + row] lane k. A mat3 column is 3 floats, so it goes through the stack
+	static inline void storeMat3x4(glm::mat3* out, const __m128* m)
+	{
+		alignas(16) float lanes[9][4];
+		for (int e = 0; e < 9; e++) _mm_store_ps(lanes[e], m[e]);
+		for (int k = 0; k < 4; k++)
+		{
+			for (int column = 0; column < 3; column++)
+			{
+				out[k][column] = glm::vec3{ lanes[column * 3][k], lanes[column * 3 + 1][k], lanes[column * 3 + 2][k] };
+			}
+		}
+	}
+
+	static inline void transform4(__m128 t[3], __m128 q[4], __m128 s[3], glm::mat4* models, glm::mat3* normals)
+	{
+		// Rotation terms r[column * 3 + row], see buildTransform
+		__m128 x2 = _mm_add_ps(q[0], q[0]), y2 = _mm_add_ps(q[1], q[1]), z2 = _mm_add_ps(q[2], q[2]);
+		__m128 xx = _mm_mul_ps(q[0], x2), yy = _mm_mul_ps(q[1], y2), zz = _mm_mul_ps(q[2], z2);
+		__m128 xy = _mm_mul_ps(q[0], y2), xz = _mm_mul_ps(q[0], z2), yz = _mm_mul_ps(q[1], z2);
+		__m128 wx = _mm_mul_ps(q[3], x2), wy = _mm_mul_ps(q[3], y2), wz = _mm_mul_ps(q[3], z2);
+
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.f);
+		__m128 r[9];
+		r[0] = _mm_sub_ps(one, _mm_add_ps(yy, zz));
+		r[1] = _mm_add_ps(xy, wz);
+		r[2] = _mm_sub_ps(xz, wy);
+		r[3] = _mm_sub_ps(xy, wz);
+		r[4] = _mm_sub_ps(one, _mm_add_ps(xx, zz));
+		r[5] = _mm_add_ps(yz, wx);
+		r[6] = _mm_add_ps(xz, wy);
+		r[7] = _mm_sub_ps(yz, wx);
+		r[8] = _mm_sub_ps(one, _mm_add_ps(xx, yy));
+
+		__m128 n[9];
+		for (int column = 0; column < 3; column++)
+		{
+			__m128 inv = _mm_div_ps(one, s[column]);
+			for (int row = 0; row < 3; row++) n[column * 3 + row] = _mm_mul_ps(inv, r[column * 3 + row]);
+			storeColumns4(models, column,
+				_mm_mul_ps(s[column], r[column * 3]), _mm_mul_ps(s[column], r[column * 3 + 1]), _mm_mul_ps(s[column], r[column * 3 + 2]), zero);
+		}
+		storeColumns4(models, 3, t[0], t[1], t[2], one);
+		storeMat3x4(normals, n);
+	}
+#endif
+
+#if AVENG_XFORM_AVX
+	static inline void transform8(__m256 t[3], __m256 q[4], __m256 s[3], glm::mat4* models, glm::mat3* normals)
+	{
+		__m256 x2 = _mm256_add_ps(q[0], q[0]), y2 = _mm256_add_ps(q[1], q[1]), z2 = _mm256_add_ps(q[2], q[2]);
+		__m256 xx = _mm256_mul_ps(q[0], x2), yy = _mm256_mul_ps(q[1], y2), zz = _mm256_mul_ps(q[2], z2);
+		__m256 xy = _mm256_mul_ps(q[0], y2), xz = _mm256_mul_ps(q[0], z2), yz = _mm256_mul_ps(q[1], z2);
+		__m256 wx = _mm256_mul_ps(q[3], x2), wy = _mm256_mul_ps(q[3], y2), wz = _mm256_mul_ps(q[3], z2);
+
+		const __m256 one8 = _mm256_set1_ps(1.f);
+		__m256 r[9];
+		r[0] = _mm256_sub_ps(one8, _mm256_add_ps(yy, zz));
+		r[1] = _mm256_add_ps(xy, wz);
+		r[2] = _mm256_sub_ps(xz, wy);
+		r[3] = _mm256_sub_ps(xy, wz);
+		r[4] = _mm256_sub_ps(one8, _mm256_add_ps(xx, zz));
+		r[5] = _mm256_add_ps(yz, wx);
+		r[6] = _mm256_add_ps(xz, wy);
+		r[7] = _mm256_sub_ps(yz, wx);
+		r[8] = _mm256_sub_ps(one8, _mm256_add_ps(xx, yy));
+
+		// Written out as two groups of 4 through the SSE transposes
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.f);
+		__m128 n[2][9];
+		for (int column = 0; column < 3; column++)
+		{
+			__m256 inv = _mm256_div_ps(one8, s[column]);
+			__m256 m[3];
+			for (int row = 0; row < 3; row++)
+			{
+				__m256 normal = _mm256_mul_ps(inv, r[column * 3 + row]);
+				n[0][column * 3 + row] = _mm256_castps256_ps128(normal);
+				n[1][column * 3 + row] = _mm256_extractf128_ps(normal, 1);
+				m[row] = _mm256_mul_ps(s[column], r[column * 3 + row]);
+			}
+			storeColumns4(models, column, _mm256_castps256_ps128(m[0]), _mm256_castps256_ps128(m[1]), _mm256_castps256_ps128(m[2]), zero);
+			storeColumns4(models + 4, column, _mm256_extractf128_ps(m[0], 1), _mm256_extractf128_ps(m[1], 1), _mm256_extractf128_ps(m[2], 1), zero);
+		}
+		storeColumns4(models, 3, _mm256_castps256_ps128(t[0]), _mm256_castps256_ps128(t[1]), _mm256_castps256_ps128(t[2]), one);
+		storeColumns4(models + 4, 3, _mm256_extractf128_ps(t[0], 1), _mm256_extractf128_ps(t[1], 1), _mm256_extractf128_ps(t[2], 1), one);
+		storeMat3x4(normals, n[0]);
+		storeMat3x4(normals + 4, n[1]);
+	}
+#endif
+
+	void TransformBatch::reserve(size_t count)
+	{
+		for (std::pmr::vector<float>* lane : { &tx, &ty, &tz, &qx, &qy, &qz, &qw, &sx, &sy, &sz }) lane->reserve(count);
+	}
+
+	void TransformBatch::push(const glm::vec3& translation, const glm::quat& orientation, const glm::vec3& scale)
+	{
+		tx.push_back(translation.x); ty.push_back(translation.y); tz.push_back(translation.z);
+		qx.push_back(orientation.x); qy.push_back(orientation.y); qz.push_back(orientation.z); qw.push_back(orientation.w);
+		sx.push_back(scale.x); sy.push_back(scale.y); sz.push_back(scale.z);
+	}
+
+	void buildTransform(const glm::vec3& translation, const glm::quat& orientation, const glm::vec3& scale, glm::mat4& model, glm::mat3& normal)
+	{
+		const float x2 = orientation.x + orientation.x;
+		const float y2 = orientation.y + orientation.y;
+		const float z2 = orientation.z + orientation.z;
+		const float xx = orientation.x * x2, yy = orientation.y * y2, zz = orientation.z * z2;
+		const float xy = orientation.x * y2, xz = orientation.x * z2, yz = orientation.y * z2;
+		const float wx = orientation.w * x2, wy = orientation.w * y2, wz = orientation.w * z2;
+		const glm::vec3 invScale = 1.0f / scale;
+
+		const glm::vec3 r0{ 1.f - (yy + zz), xy + wz, xz - wy };
+		const glm::vec3 r1{ xy - wz, 1.f - (xx + zz), yz + wx };
+		const glm::vec3 r2{ xz + wy, yz - wx, 1.f - (xx + yy) };
+
+		model = glm::mat4{
+			glm::vec4{ scale.x * r0, 0.0f },
+			glm::vec4{ scale.y * r1, 0.0f },
+			glm::vec4{ scale.z * r2, 0.0f },
+			glm::vec4{ translation, 1.0f } };
+
+		normal = glm::mat3{ invScale.x * r0, invScale.y * r1, invScale.z * r2 };
+	}
+
+	void buildTransforms(const TransformBatch& batch, glm::mat4* models, glm::mat3* normals, size_t begin, size_t end)
+	{
+		size_t i = begin;
+
+#if AVENG_XFORM_AVX
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 t[3] = { _mm256_loadu_ps(batch.tx.data() + i), _mm256_loadu_ps(batch.ty.data() + i), _mm256_loadu_ps(batch.tz.data() + i) };
+			__m256 q[4] = { _mm256_loadu_ps(batch.qx.data() + i), _mm256_loadu_ps(batch.qy.data() + i), _mm256_loadu_ps(batch.qz.data() + i), _mm256_loadu_ps(batch.qw.data() + i) };
+			__m256 s[3] = { _mm256_loadu_ps(batch.sx.data() + i), _mm256_loadu_ps(batch.sy.data() + i), _mm256_loadu_ps(batch.sz.data() + i) };
+			transform8(t, q, s, models + i, normals + i);
+		}
+#endif
+
+#if AVENG_XFORM_SSE
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 t[3] = { _mm_loadu_ps(batch.tx.data() + i), _mm_loadu_ps(batch.ty.data() + i), _mm_loadu_ps(batch.tz.data() + i) };
+			__m128 q[4] = { _mm_loadu_ps(batch.qx.data() + i), _mm_loadu_ps(batch.qy.data() + i), _mm_loadu_ps(batch.qz.data() + i), _mm_loadu_ps(batch.qw.data() + i) };
+			__m128 s[3] = { _mm_loadu_ps(batch.sx.data() + i), _mm_loadu_ps(batch.sy.data() + i), _mm_loadu_ps(batch.sz.data() + i) };
+			transform4(t, q, s, models + i, normals + i);
+		}
+#endif
+
+		// Remainder, or everything on targets without SSE
+		for (; i < end; i++)
+		{
+			buildTransform(
+				{ batch.tx[i], batch.ty[i], batch.tz[i] },
+				glm::quat{ batch.qw[i], batch.qx[i], batch.qy[i], batch.qz[i] },
+				{ batch.sx[i], batch.sy[i], batch.sz[i] },
+				models[i], normals[i]);
+		}
+	}
+
+	void buildTransformsParallel(const TransformBatch& batch, glm::mat4* models, glm::mat3* normals, ThreadPool* workers, size_t minPerThread)
+	{
+		size_t count = batch.size();
+		size_t threadCount = workers ? workers->threads.size() : 0;
+
+		size_t participants = std::min(threadCount + 1, std::max<size_t>(1, count / minPerThread));
+		if (participants <= 1)
+		{
+			buildTransforms(batch, models, normals, 0, count);
+			return;
+		}
+
+		// Batches are kept a multiple of 8 so each one stays on the wide path
+		size_t chunk = ((count + participants - 1) / participants + 7) & ~size_t(7);
+
+		for (size_t t = 1; t < participants; t++)
+		{
+			size_t begin = std::min(count, t * chunk);
+			size_t end = std::min(count, begin + chunk);
+			workers->threads[t - 1]->addJob([&batch, models, normals, begin, end] {
+				buildTransforms(batch, models, normals, begin, end);
+			});
+		}
+		buildTransforms(batch, models, normals, 0, std::min(count, chunk));
+		workers->wait();
+	}
+
+	size_t refreshTransforms(AvengRegistry& scene, ThreadPool* workers, std::pmr::memory_resource* resource)
+	{
+		ComponentPool<TransformComponent>& pool = scene.pool<TransformComponent>();
+		TransformComponent* transforms = pool.data();
+
+		std::pmr::vector<uint32_t> stale{ resource };
+		TransformBatch batch{ resource };
+		for (uint32_t n = 0; n < pool.size(); n++)
+		{
+			const TransformComponent& transform = transforms[n];
+			if (!transform.matricesStale()) continue;
+			stale.push_back(n);
+			batch.push(transform.translation, transform.orientation, transform.scale);
+		}
+		if (stale.empty()) return 0;
+
+		std::pmr::vector<glm::mat4> models(stale.size(), resource);
+		std::pmr::vector<glm::mat3> normals(stale.size(), resource);
+		buildTransformsParallel(batch, models.data(), normals.data(), workers);
+
+		for (size_t k = 0; k < stale.size(); k++)
+		{
+			transforms[stale[k]].storeMatrices(models[k], normals[k]);
+		}
+		TransformComponent::countRebuilds(static_cast<uint32_t>(stale.size()));
+		return stale.size();
+	}
+
+	TransformBenchmark benchmarkTransforms(size_t count, ThreadPool* workers)
+	{
+		constexpr int RUNS = 5;
+
+		std::mt19937 random{ 1234 };
+		std::uniform_real_distribution<float> position{ -100.f, 100.f };
+		std::uniform_real_distribution<float> angle{ -3.2f, 3.2f };
+		std::uniform_real_distribution<float> size{ .1f, 4.f };
+
+		TransformBatch batch{};
+		batch.reserve(count);
+		for (size_t n = 0; n < count; n++)
+		{
+			glm::quat orientation = quatFromEulerYXZ({ angle(random), angle(random), angle(random) });
+			batch.push({ position(random), position(random), position(random) }, orientation, { size(random), size(random), size(random) });
+		}
+
+		std::vector<glm::mat4> scalarModels(count), models(count);
+		std::vector<glm::mat3> scalarNormals(count), normals(count);
+
+		// Best of RUNS
+		auto time = [](auto&& run) {
+			float best = FLT_MAX;
+			for (int r = 0; r < RUNS; r++)
+			{
+				auto start = std::chrono::high_resolution_clock::now();
+				run();
+				best = std::min(best, std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count());
+			}
+			return best;
+		};
+
+		TransformBenchmark result{ count };
+		result.scalarMs = time([&] {
+			for (size_t n = 0; n < count; n++)
+			{
+				buildTransform({ batch.tx[n], batch.ty[n], batch.tz[n] }, glm::quat{ batch.qw[n], batch.qx[n], batch.qy[n], batch.qz[n] }, { batch.sx[n], batch.sy[n], batch.sz[n] }, scalarModels[n], scalarNormals[n]);
+			}
+		});
+		result.batchMs = time([&] { buildTransforms(batch, models.data(), normals.data(), 0, count); });
+		result.parallelMs = time([&] { buildTransformsParallel(batch, models.data(), normals.data(), workers); });
+
+		result.maxError = 0.f;
+		for (size_t n = 0; n < count; n++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				glm::vec4 difference = glm::abs(models[n][column] - scalarModels[n][column]);
+				result.maxError = std::max({ result.maxError, difference.x, difference.y, difference.z, difference.w });
+			}
+			for (int column = 0; column < 3; column++)
+			{
+				glm::vec3 difference = glm::abs(normals[n][column] - scalarNormals[n][column]);
+				result.maxError = std::max({ result.maxError, difference.x, difference.y, difference.z });
+			}
+		}
+		return result;
+	}
+
+}
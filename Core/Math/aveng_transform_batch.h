@@ -0,0 +1,66 @@
+#pragma once
+#include "../../avpch.h"
+#include "../Utils/threadpool.h"
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <memory_resource>
+
+namespace aveng {
+
+	class AvengRegistry;
+
+	/*
+	* Translation, orientation and scale of many objects as a structure of arrays, so the
+	* kernel below can load 4 (SSE) or 8 (AVX) of each component at once.
+	* Rotation is the unit quaternion TransformComponent stores, not Y-X-Z Euler angles, so there
+	* is no Euler variant of the kernel and no vectorized sincos. Angles go through quatFromEulerYXZ once.
+	*/
+	struct TransformBatch {
+		std::pmr::vector<float> tx, ty, tz;
+		std::pmr::vector<float> qx, qy, qz, qw;
+		std::pmr::vector<float> sx, sy, sz;
+
+		explicit TransformBatch(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: tx{ resource }, ty{ resource }, tz{ resource },
+			  qx{ resource }, qy{ resource }, qz{ resource }, qw{ resource },
+			  sx{ resource }, sy{ resource }, sz{ resource } {}
+
+		void reserve(size_t count);
+		void push(const glm::vec3& translation, const glm::quat& orientation, const glm::vec3& scale);
+		size_t size() const { return tx.size(); }
+	};
+
+	/*
+	* Model and normal matrix of one transform, Translate * R * Scale and its inverse transpose, with R
+	* from a unit quaternion and no trig. The definition TransformComponent and the batch kernel both follow.
+	*/
+	void buildTransform(const glm::vec3& translation, const glm::quat& orientation, const glm::vec3& scale, glm::mat4& model, glm::mat3& normal);
+
+	// buildTransform for transforms [begin, end) of the batch, written to models[i] and normals[i]
+	void buildTransforms(const TransformBatch& batch, glm::mat4* models, glm::mat3* normals, size_t begin, size_t end);
+
+	/*
+	* buildTransforms over the whole batch, split across the pool's threads (and the calling thread)
+	* once there are at least minPerThread transforms per participant.
+	*/
+	void buildTransformsParallel(const TransformBatch& batch, glm::mat4* models, glm::mat3* normals, ThreadPool* workers, size_t minPerThread = 2048);
+
+	/*
+	* Rebuild the cached matrices of every TransformComponent in the scene whose translation, rotation
+	* or scale changed, all in one batch. Returns the number rebuilt. Scratch comes from resource.
+	*/
+	size_t refreshTransforms(AvengRegistry& scene, ThreadPool* workers, std::pmr::memory_resource* resource);
+
+	// Milliseconds for count transforms, best of a few runs
+	struct TransformBenchmark {
+		size_t count;
+		float scalarMs;			// buildTransform one at a time
+		float batchMs;			// buildTransforms on this thread
+		float parallelMs;		// buildTransformsParallel
+		float maxError;			// Largest difference between the batch and scalar results
+	};
+
+	TransformBenchmark benchmarkTransforms(size_t count, ThreadPool* workers);
+
+}
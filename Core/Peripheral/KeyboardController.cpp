@@ -31,19 +31,23 @@ namespace aveng{
 			rotate.y += 1.f;
 		}
 
+		// Look input is in angles, the transform holds a quaternion
+		glm::vec3 rotation = viewerObject.transform.getRotation();
+
 		// This if statement effectively makes sure that rotate (matrix) is non-zero
 		if (glm::dot(rotate, rotate) > std::numeric_limits<float>::epsilon()) {
 			// Update according to Delta Time. Normalize keeps multiple rotations in sync so one direction doesn't rotate faster than another
-			viewerObject.transform.rotation += lookSpeed * dt * glm::normalize(rotate);
+			rotation += lookSpeed * dt * glm::normalize(rotate);
 		}
 		//
 		// Prevent things from going upside down
-		viewerObject.transform.rotation.x = glm::clamp(viewerObject.transform.rotation.x, -1.5f, 1.5f);
+		rotation.x = glm::clamp(rotation.x, -1.5f, 1.5f);
 		// 360 degree max rotation then repeat
-		viewerObject.transform.rotation.y = glm::mod(viewerObject.transform.rotation.y, glm::two_pi<float>());
+		rotation.y = glm::mod(rotation.y, glm::two_pi<float>());
+		viewerObject.transform.setRotation(rotation);
 		
 		
-		float yaw = viewerObject.transform.rotation.y;
+		float yaw = rotation.y;
 		const glm::vec3 forwardDir{ sin(yaw), 0.f, cos(yaw) };
 		const glm::vec3 rightDir{ forwardDir.z, 0.f, -forwardDir.x };
 		const glm::vec3 upDir{ 0.f, -1.f, 0.f };
@@ -28,6 +28,11 @@ namespace aveng {
 			texture_paths.push_back(text);
 		}
 
+		// The defragmenter holds pointers into these
+		images.reserve(texture_paths.size());
+		allImageMemory.reserve(texture_paths.size());
+		moveTargets.reserve(texture_paths.size());
+
 		for (size_t i = 0; i < texture_paths.size(); i++)
 		{
 			createTextureImage(textures[i], i);
@@ -37,13 +42,46 @@ namespace aveng {
 		createImageDescriptors(textureImageViews);
 	}
 
+	/*
+	* Let the defragmenter relocate texture i. Once it has, the view is rebuilt
+	* against the new image and every frame's global descriptor set is flagged for a rewrite.
+	*/
+	void ImageSystem::registerMoveTarget(size_t i, const VkImageCreateInfo& imageInfo)
+	{
+		AvengMoveTarget& target = moveTargets.emplace_back();
+		target.allocation = &allImageMemory[i];
+		target.image = &images[i];
+		target.imageInfo = imageInfo;
+		target.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		target.imageAspect = VK_IMAGE_ASPECT_COLOR_BIT;
+		target.onMoved = [this, i]() {
+			VkImageView oldView = textureImageViews[i];
+			VkDevice device = engineDevice.device();
+			engineDevice.deletionQueue().push([device, oldView]() { vkDestroyImageView(device, oldView, nullptr); });
+
+			textureImageViews[i] = createImageView(images[i], VK_FORMAT_R8G8B8A8_SRGB, mipLevels[i]);
+			imageInfosArray[i].imageView = textureImageViews[i];
+			descriptorsDirty = (1u << SwapChain::MAX_FRAMES_IN_FLIGHT) - 1;
+		};
+
+		engineDevice.allocator().setMoveTarget(allImageMemory[i], &target);
+	}
+
+	bool ImageSystem::consumeDescriptorsDirty(int frameIndex)
+	{
+		uint32_t bit = 1u << frameIndex;
+		bool dirty = descriptorsDirty & bit;
+		descriptorsDirty &= ~bit;
+		return dirty;
+	}
+
 	ImageSystem::~ImageSystem() 
 	{
 		for (int i=0; i < images.size(); i++) 
 		{
 			vkDestroyImage(engineDevice.device(), images[i], nullptr);
 			vkDestroyImageView(engineDevice.device(), textureImageViews[i], nullptr);
-			vkFreeMemory(engineDevice.device(), allImageMemory[i], nullptr);
+			engineDevice.allocator().free(allImageMemory[i]);
 		}
 		vkDestroySampler(engineDevice.device(), textureSampler, nullptr);
 	}
@@ -51,7 +89,7 @@ namespace aveng {
 	void ImageSystem::createTextureImage(const char* filepath, size_t i)
 	{
 		VkImage image;
-		VkDeviceMemory imageMemory;
+		AvengAllocation imageMemory;
 
 		// Load our image
 		int texWidth, texHeight, texChannels;
@@ -109,17 +147,13 @@ namespace aveng {
 		* TODO It is possible that the VK_FORMAT_R8G8B8A8_SRGB format is not supported by the graphics hardware. 
 		* You should have a list of acceptable alternatives and go with the best one that is supported.
 		*/
-		if (vkCreateImage(engineDevice.device(), &imageInfo, nullptr, &image) != VK_SUCCESS) 
-		{
-			throw std::runtime_error("failed to create image!");
-		}
-
 		engineDevice.createImageWithInfo(
 			imageInfo,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, // Memory properties - This is GPU heap allocated and super fast
 			image,
 			imageMemory
 		);
+		images.push_back(image);
 		allImageMemory.push_back(imageMemory);
 
 		transitionImageLayout(image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevel);
@@ -128,6 +162,7 @@ namespace aveng {
 		
 		generateMipmaps(image, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevel);
 
+		registerMoveTarget(i, imageInfo);
 	}
 
 	void ImageSystem::generateMipmaps(VkImage _image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t _mipLevels)
@@ -220,8 +255,6 @@ namespace aveng {
 			0, nullptr,
 			1, &barrier);
 
-		images.push_back(_image);
-
 		engineDevice.endSingleTimeCommands(commandBuffer);
 	}
 
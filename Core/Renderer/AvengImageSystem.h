@@ -1,5 +1,6 @@
 #pragma once
 #include "../../CoreVK/EngineDevice.h"
+#include "../../CoreVK/aveng_allocator.h"
 #include "Renderer.h"
 #include "../../stb/stb_image.h"
 
@@ -38,7 +39,10 @@ namespace aveng {
 		void createImageDescriptors(std::vector<VkImageView> views);
 
 		VkDescriptorImageInfo getImageInfoAtIndex(int index)    { return imageInfosArray[index]; }
-		std::vector<VkDescriptorImageInfo> descriptorInfoForAllImages(){ return imageInfosArray; }
+		const std::vector<VkDescriptorImageInfo>& descriptorInfoForAllImages() const { return imageInfosArray; }
+
+		// True once per frame index after the defragmenter has moved a texture, so that frame's global set gets rewritten
+		bool consumeDescriptorsDirty(int frameIndex);
 
 		std::vector<const char*> texture_paths;
 
@@ -51,8 +55,12 @@ namespace aveng {
 		std::vector<VkImage> images;
 		std::vector<uint32_t> mipLevels;
 		std::vector<VkImageView> textureImageViews;
-		std::vector<VkDeviceMemory> allImageMemory;
+		std::vector<AvengAllocation> allImageMemory;
+		std::vector<AvengMoveTarget> moveTargets;	// Point into images / allImageMemory, which are reserved up front and never reallocate
 		std::vector<VkDescriptorImageInfo> imageInfosArray;
+		uint32_t descriptorsDirty = 0;				// One bit per frame in flight
+
+		void registerMoveTarget(size_t i, const VkImageCreateInfo& imageInfo);
 		
 		//std::unordered_map<std::string, Texture> textures;
 
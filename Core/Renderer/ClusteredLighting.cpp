@@ -0,0 +1,96 @@
+#include "ClusteredLighting.h"
+#include "../../CoreVK/swapchain.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace aveng {
+
+	ClusteredLighting::ClusteredLighting(EngineDevice& device) : engineDevice{ device }
+	{
+
+	}
+
+	void ClusteredLighting::initialize()
+	{
+		frames.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (Frame& frame : frames)
+		{
+			frame.lights = std::make_unique<AvengBuffer>(
+				engineDevice,
+				sizeof(GpuPointLight),
+				MAX_LIGHTS,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			frame.lights->map();
+
+			frame.clusters = std::make_unique<AvengBuffer>(
+				engineDevice,
+				sizeof(glm::uvec2),
+				LightClusterGrid::COUNT,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			frame.clusters->map();
+
+			frame.indices = std::make_unique<AvengBuffer>(
+				engineDevice,
+				sizeof(uint32_t),
+				MAX_LIGHT_INDICES,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			frame.indices->map();
+		}
+	}
+
+	LightClusterStats ClusteredLighting::update(
+		int frameIndex,
+		AvengRegistry& scene,
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		float zNear,
+		float zFar,
+		ThreadPool* workers,
+		std::pmr::memory_resource* frameArena)
+	{
+		Frame& frame = frames[frameIndex];
+		grid = LightClusterGrid::fromDepthRange(zNear, zFar);
+
+		// Gathered here rather than kept in the buffer, lights come and go with their entities
+		ComponentPool<PointLightComponent>& pointLights = scene.pool<PointLightComponent>();
+		ComponentPool<TransformComponent>& transforms = scene.pool<TransformComponent>();
+		std::pmr::vector<GpuPointLight> lights{ frameArena };
+		lights.reserve(std::min<size_t>(pointLights.size(), MAX_LIGHTS));
+		for (size_t n = 0; n < pointLights.size() && lights.size() < MAX_LIGHTS; n++)
+		{
+			Entity entity = pointLights.owners()[n];
+			if (!transforms.has(entity)) continue;
+
+			// The world matrix, so lights attached to something in the hierarchy follow it
+			const PointLightComponent& light = pointLights.data()[n];
+			const glm::mat4& world = transforms.get(entity)._mat4();
+			lights.push_back({ glm::vec4(glm::vec3(world[3]), light.radius), glm::vec4(light.color, light.intensity) });
+		}
+		uint32_t lightCount = static_cast<uint32_t>(lights.size());
+
+		// Assignment reads the lights many times over, so from here rather than the mapped buffer
+		if (lightCount > 0) std::memcpy(frame.lights->getMappedMemory(), lights.data(), sizeof(GpuPointLight) * lightCount);
+		frame.lights->flush();
+
+		LightClusterStats stats = assignLightClusters(
+			grid,
+			lights.data(),
+			lightCount,
+			view,
+			projection,
+			static_cast<glm::uvec2*>(frame.clusters->getMappedMemory()),
+			static_cast<uint32_t*>(frame.indices->getMappedMemory()),
+			MAX_LIGHT_INDICES,
+			workers,
+			frameArena);
+		frame.clusters->flush();
+		frame.indices->flush();
+
+		return stats;
+	}
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "../Math/aveng_light_clusters.h"
+#include "../Scene/AvengComponent.h"
+#include "../Scene/aveng_registry.h"
+#include "../Utils/threadpool.h"
+#include "../../CoreVK/EngineDevice.h"
+#include "../../CoreVK/aveng_buffer.h"
+
+#include "../../avpch.h"
+
+#include <memory_resource>
+
+namespace aveng {
+
+	/*
+	* @class ClusteredLighting
+	* Clustered forward shading for the scene's PointLightComponents.
+	*
+	* Every frame the lights are gathered into a storage buffer, assigned to the clusters of the
+	* camera's view volume on the thread pool (see assignLightClusters), and the per cluster lists
+	* written next to them. The three buffers sit at bindings 2 to 4 of the global set, so the object
+	* shaders find their fragment's cluster and only shade the handful of lights that reach it,
+	* rather than every light in the scene.
+	*
+	* The buffers are host visible and sized for MAX_LIGHTS once, one set per frame in flight,
+	* so the global descriptor sets never have to be rewritten.
+	*/
+	class ClusteredLighting {
+
+	public:
+
+		static constexpr uint32_t MAX_LIGHTS = 4096;
+		static constexpr uint32_t MAX_LIGHT_INDICES = 256 * 1024;	// Light references across all clusters
+
+		ClusteredLighting(EngineDevice& device);
+
+		ClusteredLighting(const ClusteredLighting&) = delete;
+		ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+
+		void initialize();
+
+		/*
+		* Gather the lights and rebuild this frame slot's cluster lists for the camera. Lights past MAX_LIGHTS
+		* are left out. The slot's last submission must have retired.
+		*/
+		LightClusterStats update(
+			int frameIndex,
+			AvengRegistry& scene,
+			const glm::mat4& view,
+			const glm::mat4& projection,
+			float zNear,
+			float zFar,
+			ThreadPool* workers,
+			std::pmr::memory_resource* frameArena);
+
+		// As of the last update, for the cluster fields of the global UBO
+		const LightClusterGrid& getGrid() const { return grid; }
+
+		// Bindings 2, 3 and 4 of the global set
+		VkDescriptorBufferInfo lightBufferInfo(int frameIndex) const { return frames[frameIndex].lights->descriptorInfo(); }
+		VkDescriptorBufferInfo clusterBufferInfo(int frameIndex) const { return frames[frameIndex].clusters->descriptorInfo(); }
+		VkDescriptorBufferInfo indexBufferInfo(int frameIndex) const { return frames[frameIndex].indices->descriptorInfo(); }
+
+	private:
+
+		struct Frame {
+			std::unique_ptr<AvengBuffer> lights;		// GpuPointLight per light
+			std::unique_ptr<AvengBuffer> clusters;		// Offset and count per cluster
+			std::unique_ptr<AvengBuffer> indices;		// Light indices the cluster ranges refer to
+		};
+
+		EngineDevice& engineDevice;
+		LightClusterGrid grid{};
+		std::vector<Frame> frames;
+
+	};
+
+}
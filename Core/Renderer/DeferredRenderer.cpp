@@ -0,0 +1,402 @@
+#include "DeferredRenderer.h"
+
+#include <array>
+
+namespace aveng {
+
+	DeferredRenderer::DeferredRenderer(EngineDevice& device) : engineDevice{ device }
+	{
+
+	}
+
+	DeferredRenderer::~DeferredRenderer()
+	{
+		for (Frame& frame : frames)
+		{
+			vkDestroyFramebuffer(engineDevice.device(), frame.framebuffer, nullptr);
+			vkDestroyImageView(engineDevice.device(), frame.surfaceView, nullptr);
+			vkDestroyImage(engineDevice.device(), frame.surface, nullptr);
+			vkFreeMemory(engineDevice.device(), frame.surfaceMemory, nullptr);
+			vkDestroyImageView(engineDevice.device(), frame.depthView, nullptr);
+			vkDestroyImage(engineDevice.device(), frame.depth, nullptr);
+			vkFreeMemory(engineDevice.device(), frame.depthMemory, nullptr);
+		}
+		vkDestroyPipelineLayout(engineDevice.device(), lightingPipelineLayout, nullptr);
+		vkDestroySampler(engineDevice.device(), sampler, nullptr);
+		vkDestroyRenderPass(engineDevice.device(), geometryRenderPass, nullptr);
+		vkDestroyRenderPass(engineDevice.device(), geometryLoadRenderPass, nullptr);
+	}
+
+	void DeferredRenderer::initialize(VkRenderPass swapChainRenderPass, VkDescriptorSetLayout globalDescriptorSetLayout)
+	{
+		// The lighting pass samples it, and occlusion culling reduces it into the Hi-Z pyramid
+		depthFormat = engineDevice.findSupportedFormat(
+			{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
+		createRenderPasses();
+
+		// Texels are fetched, never filtered. Integer formats can't be anyway
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+		if (vkCreateSampler(engineDevice.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create G-buffer sampler!");
+		}
+
+		lightingSetLayout = AvengDescriptorSetLayout::Builder(engineDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)		// Albedo and normal
+			.addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)		// Depth
+			.build();
+
+		descriptorPool = AvengDescriptorPool::Builder(engineDevice)
+			.setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, SwapChain::MAX_FRAMES_IN_FLIGHT * 2)
+			.build();
+
+		createLightingPipeline(swapChainRenderPass, globalDescriptorSetLayout);
+
+		frames.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (Frame& frame : frames)
+		{
+			if (!descriptorPool->allocateDescriptors(lightingSetLayout->getDescriptorSetLayout(), frame.lightingSet))
+			{
+				throw std::runtime_error("failed to allocate G-buffer descriptor set!");
+			}
+		}
+	}
+
+	/*
+	* The surface ends up ready to be sampled. Depth stays an attachment, as the swap chain's does, so the
+	* Hi-Z pyramid can take it between geometry passes; finishGeometry moves it on once they're done.
+	*/
+	void DeferredRenderer::createRenderPasses()
+	{
+		VkAttachmentDescription surfaceAttachment{};
+		surfaceAttachment.format = SURFACE_FORMAT;
+		surfaceAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		surfaceAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		surfaceAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		surfaceAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		surfaceAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		surfaceAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		surfaceAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkAttachmentDescription depthAttachment{};
+		depthAttachment.format = depthFormat;
+		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference surfaceAttachmentRef{ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthAttachmentRef{ 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &surfaceAttachmentRef;
+		subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+		std::array<VkSubpassDependency, 2> dependencies{};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = 0;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		// Surface writes land before the lighting pass reads them
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		std::array<VkAttachmentDescription, 2> attachments = { surfaceAttachment, depthAttachment };
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+
+		if (vkCreateRenderPass(engineDevice.device(), &renderPassInfo, nullptr, &geometryRenderPass) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create G-buffer render pass!");
+		}
+
+		// As SwapChain's loadRenderPass, picks up after compute has run over the depth
+		surfaceAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		surfaceAttachment.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		attachments = { surfaceAttachment, depthAttachment };
+
+		dependencies[0].srcStageMask =
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstStageMask =
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstAccessMask =
+			VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		if (vkCreateRenderPass(engineDevice.device(), &renderPassInfo, nullptr, &geometryLoadRenderPass) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create G-buffer render pass!");
+		}
+	}
+
+	void DeferredRenderer::createLightingPipeline(VkRenderPass swapChainRenderPass, VkDescriptorSetLayout globalDescriptorSetLayout)
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(LightingPushConstants);
+
+		VkDescriptorSetLayout descriptorSetLayouts[2] = { globalDescriptorSetLayout, lightingSetLayout->getDescriptorSetLayout() };
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 2;
+		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(engineDevice.device(), &pipelineLayoutInfo, nullptr, &lightingPipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create lighting pipeline layout!");
+		}
+
+		// No vertex input, the triangle comes from gl_VertexIndex. Depth is written as read, whatever is already there
+		PipelineConfig pipelineConfig{};
+		GFXPipeline::defaultPipelineConfig(pipelineConfig);
+		pipelineConfig.attributeDescriptions.clear();
+		pipelineConfig.bindingDescriptions.clear();
+		pipelineConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_ALWAYS;
+		pipelineConfig.renderPass = swapChainRenderPass;
+		pipelineConfig.pipelineLayout = lightingPipelineLayout;
+
+		lightingPipeline = std::make_unique<GFXPipeline>(
+			engineDevice,
+			"shaders/deferred_lighting.vert.spv",
+			"shaders/deferred_lighting.frag.spv",
+			pipelineConfig
+		);
+	}
+
+	void DeferredRenderer::prepareFrame(int frameIndex, VkExtent2D extent, std::pmr::memory_resource* frameArena)
+	{
+		Frame& frame = frames[frameIndex];
+		if (frame.framebuffer != VK_NULL_HANDLE && frame.extent.width == extent.width && frame.extent.height == extent.height) return;
+
+		destroyTargets(frame);
+		createTargets(frame, extent, frameArena);
+	}
+
+	void DeferredRenderer::createTargets(Frame& frame, VkExtent2D extent, std::pmr::memory_resource* frameArena)
+	{
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = { extent.width, extent.height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = SURFACE_FORMAT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		engineDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.surface, frame.surfaceMemory);
+
+		imageInfo.format = depthFormat;
+		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+		engineDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.depth, frame.depthMemory);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = frame.surface;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = SURFACE_FORMAT;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+		if (vkCreateImageView(engineDevice.device(), &viewInfo, nullptr, &frame.surfaceView) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create G-buffer image view!");
+		}
+
+		// Sampled as depth only
+		viewInfo.image = frame.depth;
+		viewInfo.format = depthFormat;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+
+		if (vkCreateImageView(engineDevice.device(), &viewInfo, nullptr, &frame.depthView) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create G-buffer image view!");
+		}
+
+		std::array<VkImageView, 2> attachments = { frame.surfaceView, frame.depthView };
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = geometryRenderPass;
+		framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		framebufferInfo.pAttachments = attachments.data();
+		framebufferInfo.width = extent.width;
+		framebufferInfo.height = extent.height;
+		framebufferInfo.layers = 1;
+
+		if (vkCreateFramebuffer(engineDevice.device(), &framebufferInfo, nullptr, &frame.framebuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create G-buffer framebuffer!");
+		}
+
+		// This slot's last submission has retired, its set is free to rewrite
+		VkDescriptorImageInfo surfaceInfo{ sampler, frame.surfaceView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		VkDescriptorImageInfo depthInfo{ sampler, frame.depthView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		AvengDescriptorSetWriter(*lightingSetLayout, *descriptorPool, frameArena)
+			.writeImage(0, &surfaceInfo, 1)
+			.writeImage(1, &depthInfo, 1)
+			.overwrite(frame.lightingSet);
+
+		frame.extent = extent;
+		frame.id = ++nextId;
+	}
+
+	// The other frame in flight may still be using the old targets of its own slot, but never these
+	void DeferredRenderer::destroyTargets(Frame& frame)
+	{
+		if (frame.framebuffer == VK_NULL_HANDLE) return;
+
+		VkDevice device = engineDevice.device();
+		Frame old = frame;
+		engineDevice.deletionQueue().push([device, old]() {
+			vkDestroyFramebuffer(device, old.framebuffer, nullptr);
+			vkDestroyImageView(device, old.surfaceView, nullptr);
+			vkDestroyImage(device, old.surface, nullptr);
+			vkFreeMemory(device, old.surfaceMemory, nullptr);
+			vkDestroyImageView(device, old.depthView, nullptr);
+			vkDestroyImage(device, old.depth, nullptr);
+			vkFreeMemory(device, old.depthMemory, nullptr);
+		});
+
+		VkDescriptorSet lightingSet = frame.lightingSet;
+		frame = Frame{};
+		frame.lightingSet = lightingSet;
+	}
+
+	void DeferredRenderer::beginGeometryPass(VkCommandBuffer commandBuffer, int frameIndex, VkSubpassContents contents)
+	{
+		beginRenderPass(commandBuffer, frames[frameIndex], geometryRenderPass, true, contents);
+	}
+
+	void DeferredRenderer::resumeGeometryPass(VkCommandBuffer commandBuffer, int frameIndex, VkSubpassContents contents)
+	{
+		beginRenderPass(commandBuffer, frames[frameIndex], geometryLoadRenderPass, false, contents);
+	}
+
+	void DeferredRenderer::beginRenderPass(VkCommandBuffer commandBuffer, const Frame& frame, VkRenderPass renderPass, bool clear, VkSubpassContents contents)
+	{
+		assert(frame.framebuffer != VK_NULL_HANDLE && "G-buffer pass begun before prepareFrame");
+
+		// A cleared surface decodes to black, depth 1 is where the lighting pass leaves the background alone
+		std::array<VkClearValue, 2> clearValues{};
+		clearValues[0].color.uint32[0] = 0;
+		clearValues[0].color.uint32[1] = 0;
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = renderPass;
+		renderPassInfo.framebuffer = frame.framebuffer;
+		renderPassInfo.renderArea = { { 0, 0 }, frame.extent };
+		renderPassInfo.clearValueCount = clear ? static_cast<uint32_t>(clearValues.size()) : 0;
+		renderPassInfo.pClearValues = clear ? clearValues.data() : nullptr;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+
+		// Secondary buffers don't inherit dynamic state, they set their own
+		if (contents != VK_SUBPASS_CONTENTS_INLINE) return;
+
+		VkViewport viewport{ 0.0f, 0.0f, static_cast<float>(frame.extent.width), static_cast<float>(frame.extent.height), 0.0f, 1.0f };
+		VkRect2D scissor{ { 0, 0 }, frame.extent };
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	}
+
+	SwapChain::DepthTarget DeferredRenderer::getDepthTarget(int frameIndex) const
+	{
+		const Frame& frame = frames[frameIndex];
+		return { frame.depth, frame.depthView, depthFormat, frame.extent, true, frame.id };
+	}
+
+	VkCommandBufferInheritanceInfo DeferredRenderer::getInheritance(int frameIndex) const
+	{
+		VkCommandBufferInheritanceInfo inheritance{};
+		inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritance.renderPass = geometryRenderPass;
+		inheritance.subpass = 0;
+		inheritance.framebuffer = frames[frameIndex].framebuffer;
+		return inheritance;
+	}
+
+	VkImageAspectFlags DeferredRenderer::depthAspect() const
+	{
+		VkImageAspectFlags aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+		if (depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || depthFormat == VK_FORMAT_D24_UNORM_S8_UINT)
+			aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		return aspect;
+	}
+
+	void DeferredRenderer::finishGeometry(VkCommandBuffer commandBuffer, int frameIndex)
+	{
+		// Left this way until the slot comes around again, when the next geometry pass discards it
+		VkImageMemoryBarrier depthBarrier{};
+		depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		depthBarrier.image = frames[frameIndex].depth;
+		depthBarrier.subresourceRange = { depthAspect(), 0, 1, 0, 1 };
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+	}
+
+	void DeferredRenderer::renderLighting(FrameContent& frame_content)
+	{
+		VkCommandBuffer commandBuffer = frame_content.commandBuffer;
+		const Frame& frame = frames[frame_content.frameIndex];
+
+		LightingPushConstants push{};
+		push.inverseViewProjection = glm::inverse(frame_content.camera.getProjection() * frame_content.camera.getView());
+
+		lightingPipeline->bind(commandBuffer);
+
+		VkDescriptorSet sets[2] = { frame_content.globalDescriptorSet, frame.lightingSet };
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lightingPipelineLayout, 0, 2, sets, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, lightingPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(LightingPushConstants), &push);
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	}
+
+}
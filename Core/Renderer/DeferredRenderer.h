@@ -0,0 +1,113 @@
+#pragma once
+
+#include "../aveng_frame_content.h"
+#include "../../CoreVK/EngineDevice.h"
+#include "../../CoreVK/GFXPipeline.h"
+#include "../../CoreVK/aveng_descriptors.h"
+#include "../../CoreVK/swapchain.h"
+
+#include "../../avpch.h"
+
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace aveng {
+
+	/*
+	* @class DeferredRenderer
+	* The deferred alternative to shading objects as they're drawn. The object pass writes a G-buffer
+	* instead of colors: albedo and a world space normal packed into one R32G32_UINT target (see gbuffer.frag)
+	* next to its own depth buffer. A fullscreen pass in the swap chain render pass then shades each pixel
+	* once from those, with the key light, the ambient term and the point lights of the pixel's cluster
+	* (see ClusteredLighting), so overdraw costs G-buffer writes rather than lighting. The lighting pass
+	* writes the G-buffer's depth through, so what is drawn forward after it is still depth tested.
+	*
+	* A frame goes prepareFrame, beginGeometryPass, the object pass, endGeometryPass (resumeGeometryPass
+	* and endGeometryPass again around the object pass after a depth pre-pass, and around occlusion
+	* culling's late phase), finishGeometry outside of any render pass, then renderLighting inside the swap chain render pass.
+	* Targets are one set per frame in flight at the swap chain's extent.
+	*/
+	class DeferredRenderer {
+
+	public:
+
+		static constexpr VkFormat SURFACE_FORMAT = VK_FORMAT_R32G32_UINT;
+
+		DeferredRenderer(EngineDevice& device);
+		~DeferredRenderer();
+
+		DeferredRenderer(const DeferredRenderer&) = delete;
+		DeferredRenderer& operator=(const DeferredRenderer&) = delete;
+
+		// The lighting pipeline is made for swapChainRenderPass and reads the global set for its lights
+		void initialize(VkRenderPass swapChainRenderPass, VkDescriptorSetLayout globalDescriptorSetLayout);
+
+		// What the object pipelines are made for when shading is deferred
+		VkRenderPass getGeometryRenderPass() const { return geometryRenderPass; }
+
+		// (Re)create this frame slot's targets when the extent changed. The slot's last submission must have retired
+		void prepareFrame(int frameIndex, VkExtent2D extent, std::pmr::memory_resource* frameArena);
+
+		// With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS the pass may only vkCmdExecuteCommands until it ends
+		void beginGeometryPass(VkCommandBuffer commandBuffer, int frameIndex, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+		// Begin it again after ending it mid frame, keeping what was written so far
+		void resumeGeometryPass(VkCommandBuffer commandBuffer, int frameIndex, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+		void endGeometryPass(VkCommandBuffer commandBuffer) { vkCmdEndRenderPass(commandBuffer); }
+
+		// The G-buffer's depth, in VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL between geometry passes
+		SwapChain::DepthTarget getDepthTarget(int frameIndex) const;
+
+		// What a secondary command buffer executed in the geometry pass inherits
+		VkCommandBufferInheritanceInfo getInheritance(int frameIndex) const;
+
+		// After the last geometry pass and outside of a render pass, hands the depth to the lighting pass
+		void finishGeometry(VkCommandBuffer commandBuffer, int frameIndex);
+
+		// One fullscreen triangle, recorded inline in the swap chain render pass
+		void renderLighting(FrameContent& frame_content);
+
+	private:
+
+		struct Frame {
+			VkImage surface = VK_NULL_HANDLE;
+			VkDeviceMemory surfaceMemory = VK_NULL_HANDLE;
+			VkImageView surfaceView = VK_NULL_HANDLE;
+			VkImage depth = VK_NULL_HANDLE;
+			VkDeviceMemory depthMemory = VK_NULL_HANDLE;
+			VkImageView depthView = VK_NULL_HANDLE;
+			VkFramebuffer framebuffer = VK_NULL_HANDLE;
+			VkDescriptorSet lightingSet = VK_NULL_HANDLE;
+			VkExtent2D extent{ 0, 0 };
+			uint64_t id = 0;		// Changes whenever the targets are replaced, DepthTarget::swapChainId
+		};
+
+		struct LightingPushConstants {
+			glm::mat4 inverseViewProjection;	// Back from the depth buffer to world space
+		};
+
+		void createRenderPasses();
+		void createLightingPipeline(VkRenderPass swapChainRenderPass, VkDescriptorSetLayout globalDescriptorSetLayout);
+		void createTargets(Frame& frame, VkExtent2D extent, std::pmr::memory_resource* frameArena);
+		void destroyTargets(Frame& frame);
+		void beginRenderPass(VkCommandBuffer commandBuffer, const Frame& frame, VkRenderPass renderPass, bool clear, VkSubpassContents contents);
+		VkImageAspectFlags depthAspect() const;
+
+		EngineDevice& engineDevice;
+
+		VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+		VkRenderPass geometryRenderPass = VK_NULL_HANDLE;
+		VkRenderPass geometryLoadRenderPass = VK_NULL_HANDLE;	// Loaded instead of cleared. Compatible with geometryRenderPass
+		VkSampler sampler = VK_NULL_HANDLE;
+
+		std::unique_ptr<AvengDescriptorSetLayout> lightingSetLayout;
+		std::unique_ptr<AvengDescriptorPool> descriptorPool;
+		VkPipelineLayout lightingPipelineLayout = VK_NULL_HANDLE;
+		std::unique_ptr<GFXPipeline> lightingPipeline;
+
+		std::vector<Frame> frames;
+		uint64_t nextId = 0;
+
+	};
+
+}
@@ -0,0 +1,395 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace aveng {
+
+	DynamicResolution::DynamicResolution(EngineDevice& device) : engineDevice{ device }
+	{
+
+	}
+
+	DynamicResolution::~DynamicResolution()
+	{
+		for (Frame& frame : frames)
+		{
+			vkDestroyFramebuffer(engineDevice.device(), frame.framebuffer, nullptr);
+			vkDestroyImageView(engineDevice.device(), frame.colorView, nullptr);
+			vkDestroyImage(engineDevice.device(), frame.color, nullptr);
+			vkFreeMemory(engineDevice.device(), frame.colorMemory, nullptr);
+			vkDestroyImageView(engineDevice.device(), frame.depthView, nullptr);
+			vkDestroyImage(engineDevice.device(), frame.depth, nullptr);
+			vkFreeMemory(engineDevice.device(), frame.depthMemory, nullptr);
+		}
+		vkDestroyPipelineLayout(engineDevice.device(), upscalePipelineLayout, nullptr);
+		vkDestroySampler(engineDevice.device(), sampler, nullptr);
+		vkDestroyRenderPass(engineDevice.device(), sceneRenderPass, nullptr);
+		vkDestroyRenderPass(engineDevice.device(), sceneLoadRenderPass, nullptr);
+	}
+
+	void DynamicResolution::initialize(VkRenderPass swapChainRenderPass, VkFormat swapChainColorFormat, VkFormat swapChainDepthFormat)
+	{
+		colorFormat = swapChainColorFormat;
+		depthFormat = swapChainDepthFormat;
+
+		createRenderPasses();
+
+		// Filtered, that's the bilinear part of the upscale
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+		if (vkCreateSampler(engineDevice.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create upscale sampler!");
+		}
+
+		upscaleSetLayout = AvengDescriptorSetLayout::Builder(engineDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)		// The scene's color
+			.build();
+
+		descriptorPool = AvengDescriptorPool::Builder(engineDevice)
+			.setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, SwapChain::MAX_FRAMES_IN_FLIGHT)
+			.build();
+
+		createUpscalePipeline(swapChainRenderPass);
+
+		frames.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (Frame& frame : frames)
+		{
+			if (!descriptorPool->allocateDescriptors(upscaleSetLayout->getDescriptorSetLayout(), frame.upscaleSet))
+			{
+				throw std::runtime_error("failed to allocate upscale descriptor set!");
+			}
+		}
+	}
+
+	/*
+	* Color ends up ready to be sampled by the upscale. Depth stays an attachment between scene passes,
+	* as the swap chain's does.
+	*/
+	void DynamicResolution::createRenderPasses()
+	{
+		VkAttachmentDescription colorAttachment{};
+		colorAttachment.format = colorFormat;
+		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkAttachmentDescription depthAttachment{};
+		depthAttachment.format = depthFormat;
+		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorAttachmentRef{ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthAttachmentRef{ 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorAttachmentRef;
+		subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+		std::array<VkSubpassDependency, 2> dependencies{};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = 0;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		// Color writes land before the upscale reads them
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+
+		if (vkCreateRenderPass(engineDevice.device(), &renderPassInfo, nullptr, &sceneRenderPass) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create scaled scene render pass!");
+		}
+
+		// As SwapChain's loadRenderPass, picks up after compute has run between passes
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		attachments = { colorAttachment, depthAttachment };
+
+		dependencies[0].srcStageMask =
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstStageMask =
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstAccessMask =
+			VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		if (vkCreateRenderPass(engineDevice.device(), &renderPassInfo, nullptr, &sceneLoadRenderPass) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create scaled scene render pass!");
+		}
+	}
+
+	void DynamicResolution::createUpscalePipeline(VkRenderPass swapChainRenderPass)
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(UpscalePushConstants);
+
+		VkDescriptorSetLayout descriptorSetLayout = upscaleSetLayout->getDescriptorSetLayout();
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(engineDevice.device(), &pipelineLayoutInfo, nullptr, &upscalePipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create upscale pipeline layout!");
+		}
+
+		// No vertex input, the triangle comes from gl_VertexIndex. It covers everything, depth has no say
+		PipelineConfig pipelineConfig{};
+		GFXPipeline::defaultPipelineConfig(pipelineConfig);
+		pipelineConfig.attributeDescriptions.clear();
+		pipelineConfig.bindingDescriptions.clear();
+		pipelineConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
+		pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+		pipelineConfig.renderPass = swapChainRenderPass;
+		pipelineConfig.pipelineLayout = upscalePipelineLayout;
+
+		upscalePipeline = std::make_unique<GFXPipeline>(
+			engineDevice,
+			"shaders/upscale.vert.spv",
+			"shaders/upscale.frag.spv",
+			pipelineConfig
+		);
+	}
+
+	void DynamicResolution::update(float gpuFrameMs, float targetMs, float minScale, float maxScale)
+	{
+		if (gpuFrameMs > 0.f && targetMs > 0.f)
+		{
+			float ideal = scale * std::sqrt(targetMs / gpuFrameMs);
+			scale += (ideal - scale) * RESPONSE;
+		}
+
+		maxScale = std::clamp(maxScale, MIN_SCALE, 1.f);
+		scale = std::clamp(scale, std::clamp(minScale, MIN_SCALE, maxScale), maxScale);
+	}
+
+	VkExtent2D DynamicResolution::renderExtent(VkExtent2D swapChainExtent) const
+	{
+		float stepped = std::round(scale / SCALE_STEP) * SCALE_STEP;
+		return {
+			std::clamp(static_cast<uint32_t>(swapChainExtent.width * stepped), 1u, swapChainExtent.width),
+			std::clamp(static_cast<uint32_t>(swapChainExtent.height * stepped), 1u, swapChainExtent.height)
+		};
+	}
+
+	void DynamicResolution::prepareFrame(int frameIndex, VkExtent2D swapChainExtent, std::pmr::memory_resource* frameArena)
+	{
+		Frame& frame = frames[frameIndex];
+		if (frame.framebuffer == VK_NULL_HANDLE || frame.extent.width != swapChainExtent.width || frame.extent.height != swapChainExtent.height)
+		{
+			destroyTargets(frame);
+			createTargets(frame, swapChainExtent, frameArena);
+		}
+		frame.renderExtent = renderExtent(swapChainExtent);
+	}
+
+	void DynamicResolution::createTargets(Frame& frame, VkExtent2D extent, std::pmr::memory_resource* frameArena)
+	{
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = { extent.width, extent.height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = colorFormat;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		engineDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.color, frame.colorMemory);
+
+		imageInfo.format = depthFormat;
+		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+
+		engineDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.depth, frame.depthMemory);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = frame.color;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = colorFormat;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+		if (vkCreateImageView(engineDevice.device(), &viewInfo, nullptr, &frame.colorView) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create scaled scene image view!");
+		}
+
+		viewInfo.image = frame.depth;
+		viewInfo.format = depthFormat;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+
+		if (vkCreateImageView(engineDevice.device(), &viewInfo, nullptr, &frame.depthView) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create scaled scene image view!");
+		}
+
+		std::array<VkImageView, 2> attachments = { frame.colorView, frame.depthView };
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = sceneRenderPass;
+		framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		framebufferInfo.pAttachments = attachments.data();
+		framebufferInfo.width = extent.width;
+		framebufferInfo.height = extent.height;
+		framebufferInfo.layers = 1;
+
+		if (vkCreateFramebuffer(engineDevice.device(), &framebufferInfo, nullptr, &frame.framebuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create scaled scene framebuffer!");
+		}
+
+		// This slot's last submission has retired, its set is free to rewrite
+		VkDescriptorImageInfo colorInfo{ sampler, frame.colorView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		AvengDescriptorSetWriter(*upscaleSetLayout, *descriptorPool, frameArena)
+			.writeImage(0, &colorInfo, 1)
+			.overwrite(frame.upscaleSet);
+
+		frame.extent = extent;
+		frame.id = ++nextId;
+	}
+
+	// The other frame in flight may still be using the old targets of its own slot, but never these
+	void DynamicResolution::destroyTargets(Frame& frame)
+	{
+		if (frame.framebuffer == VK_NULL_HANDLE) return;
+
+		VkDevice device = engineDevice.device();
+		Frame old = frame;
+		engineDevice.deletionQueue().push([device, old]() {
+			vkDestroyFramebuffer(device, old.framebuffer, nullptr);
+			vkDestroyImageView(device, old.colorView, nullptr);
+			vkDestroyImage(device, old.color, nullptr);
+			vkFreeMemory(device, old.colorMemory, nullptr);
+			vkDestroyImageView(device, old.depthView, nullptr);
+			vkDestroyImage(device, old.depth, nullptr);
+			vkFreeMemory(device, old.depthMemory, nullptr);
+		});
+
+		VkDescriptorSet upscaleSet = frame.upscaleSet;
+		frame = Frame{};
+		frame.upscaleSet = upscaleSet;
+	}
+
+	void DynamicResolution::beginScenePass(VkCommandBuffer commandBuffer, int frameIndex, VkSubpassContents contents)
+	{
+		beginRenderPass(commandBuffer, frames[frameIndex], sceneRenderPass, true, contents);
+	}
+
+	void DynamicResolution::resumeScenePass(VkCommandBuffer commandBuffer, int frameIndex, VkSubpassContents contents)
+	{
+		beginRenderPass(commandBuffer, frames[frameIndex], sceneLoadRenderPass, false, contents);
+	}
+
+	// Only the drawn corner is cleared and stored, the upscale never reads past it
+	void DynamicResolution::beginRenderPass(VkCommandBuffer commandBuffer, const Frame& frame, VkRenderPass renderPass, bool clear, VkSubpassContents contents)
+	{
+		assert(frame.framebuffer != VK_NULL_HANDLE && "Scaled scene pass begun before prepareFrame");
+
+		// As the swap chain render pass clears
+		std::array<VkClearValue, 2> clearValues{};
+		clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = renderPass;
+		renderPassInfo.framebuffer = frame.framebuffer;
+		renderPassInfo.renderArea = { { 0, 0 }, frame.renderExtent };
+		renderPassInfo.clearValueCount = clear ? static_cast<uint32_t>(clearValues.size()) : 0;
+		renderPassInfo.pClearValues = clear ? clearValues.data() : nullptr;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+
+		// Secondary buffers don't inherit dynamic state, they set their own from DepthTarget::extent
+		if (contents != VK_SUBPASS_CONTENTS_INLINE) return;
+
+		VkViewport viewport{ 0.0f, 0.0f, static_cast<float>(frame.renderExtent.width), static_cast<float>(frame.renderExtent.height), 0.0f, 1.0f };
+		VkRect2D scissor{ { 0, 0 }, frame.renderExtent };
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	}
+
+	SwapChain::DepthTarget DynamicResolution::getDepthTarget(int frameIndex) const
+	{
+		const Frame& frame = frames[frameIndex];
+		return { frame.depth, frame.depthView, depthFormat, frame.renderExtent, false, frame.id };
+	}
+
+	VkCommandBufferInheritanceInfo DynamicResolution::getInheritance(int frameIndex) const
+	{
+		VkCommandBufferInheritanceInfo inheritance{};
+		inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritance.renderPass = sceneRenderPass;
+		inheritance.subpass = 0;
+		inheritance.framebuffer = frames[frameIndex].framebuffer;
+		return inheritance;
+	}
+
+	void DynamicResolution::renderUpscale(VkCommandBuffer commandBuffer, int frameIndex, float sharpness)
+	{
+		const Frame& frame = frames[frameIndex];
+
+		UpscalePushConstants push{};
+		push.uvScale = glm::vec2(
+			static_cast<float>(frame.renderExtent.width) / static_cast<float>(frame.extent.width),
+			static_cast<float>(frame.renderExtent.height) / static_cast<float>(frame.extent.height));
+		push.texelSize = glm::vec2(1.f / static_cast<float>(frame.extent.width), 1.f / static_cast<float>(frame.extent.height));
+		push.sharpness = sharpness;
+
+		upscalePipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, upscalePipelineLayout, 0, 1, &frame.upscaleSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, upscalePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(UpscalePushConstants), &push);
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	}
+
+}
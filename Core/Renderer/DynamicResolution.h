@@ -0,0 +1,125 @@
+#pragma once
+
+#include "../../CoreVK/EngineDevice.h"
+#include "../../CoreVK/GFXPipeline.h"
+#include "../../CoreVK/aveng_descriptors.h"
+#include "../../CoreVK/swapchain.h"
+
+#include "../../avpch.h"
+
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace aveng {
+
+	/*
+	* @class DynamicResolution
+	* Renders the forward scene into an offscreen color and depth target at a fraction of the swap chain's
+	* extent, then upscales it into the swap chain render pass ahead of the GUI. The fraction follows the
+	* GPU time of the frames before: over the target frame time it shrinks, under it grows back, within
+	* [minScale, maxScale] of each axis.
+	*
+	* Targets are made at the swap chain's extent and the scene is drawn into their top left corner, so a new
+	* scale changes the viewport and not the images. The scene render passes take the swap chain's formats,
+	* so pipelines made for the swap chain render pass draw into them as they are.
+	*
+	* A frame goes update, prepareFrame, beginScenePass, the scene, endScenePass (resumeScenePass and
+	* endScenePass again as often as the scene splits its pass), then renderUpscale inside the swap chain
+	* render pass. The depth isn't sampleable, so occlusion culling's Hi-Z pass sits out while scaled.
+	*/
+	class DynamicResolution {
+
+	public:
+
+		static constexpr float MIN_SCALE = .25f;
+		static constexpr float RESPONSE = .1f;		// Of the way to the ideal scale taken per frame
+		static constexpr float SCALE_STEP = 1.f / 32.f;
+
+		DynamicResolution(EngineDevice& device);
+		~DynamicResolution();
+
+		DynamicResolution(const DynamicResolution&) = delete;
+		DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+		// The scene is drawn in the swap chain's formats. The upscale pipeline is made for swapChainRenderPass
+		void initialize(VkRenderPass swapChainRenderPass, VkFormat swapChainColorFormat, VkFormat swapChainDepthFormat);
+
+		/*
+		* Move the scale toward the one that would bring gpuFrameMs to targetMs. GPU time goes with the pixel
+		* count, so an axis scales with its square root. gpuFrameMs is MAX_FRAMES_IN_FLIGHT frames old by the
+		* time it's read, so only RESPONSE of the way is taken each frame, or the scale would oscillate.
+		*/
+		void update(float gpuFrameMs, float targetMs, float minScale, float maxScale);
+		float getScale() const { return scale; }
+
+		// What the scene is drawn at for a swap chain of this extent. Whole SCALE_STEPs, so it settles rather than jitters
+		VkExtent2D renderExtent(VkExtent2D swapChainExtent) const;
+
+		// (Re)create this frame slot's targets when the extent changed, and fix the frame's render extent
+		void prepareFrame(int frameIndex, VkExtent2D swapChainExtent, std::pmr::memory_resource* frameArena);
+
+		// With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS the pass may only vkCmdExecuteCommands until it ends
+		void beginScenePass(VkCommandBuffer commandBuffer, int frameIndex, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+		// Begin it again after ending it mid frame, keeping what was drawn so far
+		void resumeScenePass(VkCommandBuffer commandBuffer, int frameIndex, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+		void endScenePass(VkCommandBuffer commandBuffer) { vkCmdEndRenderPass(commandBuffer); }
+
+		// The scene's depth, at the frame's render extent
+		SwapChain::DepthTarget getDepthTarget(int frameIndex) const;
+
+		// What a secondary command buffer executed in the scene pass inherits
+		VkCommandBufferInheritanceInfo getInheritance(int frameIndex) const;
+
+		// One fullscreen triangle, recorded inline in the swap chain render pass. sharpness 0 is plain bilinear
+		void renderUpscale(VkCommandBuffer commandBuffer, int frameIndex, float sharpness);
+
+	private:
+
+		struct Frame {
+			VkImage color = VK_NULL_HANDLE;
+			VkDeviceMemory colorMemory = VK_NULL_HANDLE;
+			VkImageView colorView = VK_NULL_HANDLE;
+			VkImage depth = VK_NULL_HANDLE;
+			VkDeviceMemory depthMemory = VK_NULL_HANDLE;
+			VkImageView depthView = VK_NULL_HANDLE;
+			VkFramebuffer framebuffer = VK_NULL_HANDLE;
+			VkDescriptorSet upscaleSet = VK_NULL_HANDLE;
+			VkExtent2D extent{ 0, 0 };			// Of the targets
+			VkExtent2D renderExtent{ 0, 0 };	// Drawn this frame
+			uint64_t id = 0;					// Changes whenever the targets are replaced, DepthTarget::swapChainId
+		};
+
+		struct UpscalePushConstants {
+			glm::vec2 uvScale;		// The drawn corner of the target, in its texture coordinates
+			glm::vec2 texelSize;	// Of the target
+			float sharpness;
+		};
+
+		void createRenderPasses();
+		void createUpscalePipeline(VkRenderPass swapChainRenderPass);
+		void createTargets(Frame& frame, VkExtent2D extent, std::pmr::memory_resource* frameArena);
+		void destroyTargets(Frame& frame);
+		void beginRenderPass(VkCommandBuffer commandBuffer, const Frame& frame, VkRenderPass renderPass, bool clear, VkSubpassContents contents);
+
+		EngineDevice& engineDevice;
+
+		float scale = 1.f;
+
+		VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+		VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+		VkRenderPass sceneRenderPass = VK_NULL_HANDLE;
+		VkRenderPass sceneLoadRenderPass = VK_NULL_HANDLE;	// Loaded instead of cleared. Compatible with sceneRenderPass
+		VkSampler sampler = VK_NULL_HANDLE;
+
+		std::unique_ptr<AvengDescriptorSetLayout> upscaleSetLayout;
+		std::unique_ptr<AvengDescriptorPool> descriptorPool;
+		VkPipelineLayout upscalePipelineLayout = VK_NULL_HANDLE;
+		std::unique_ptr<GFXPipeline> upscalePipeline;
+
+		std::vector<Frame> frames;
+		uint64_t nextId = 0;
+
+	};
+
+}
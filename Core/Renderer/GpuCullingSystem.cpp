@@ -0,0 +1,305 @@
+#include "GpuCullingSystem.h"
+#include "../../CoreVK/swapchain.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace aveng {
+
+	GpuCullingSystem::GpuCullingSystem(EngineDevice& device) : engineDevice{ device }
+	{
+
+	}
+
+	GpuCullingSystem::~GpuCullingSystem()
+	{
+		vkDestroyPipelineLayout(engineDevice.device(), pipelineLayout, nullptr);
+	}
+
+	void GpuCullingSystem::initialize()
+	{
+		hiZ.initialize();
+
+		// 0 instances, 1 groups, 2 commands, 3 visible instances, 4 draw counts, 5 compacted commands, 6 retest flags
+		AvengDescriptorSetLayout::Builder layoutBuilder{ engineDevice };
+		for (uint32_t binding = 0; binding < 7; binding++)
+		{
+			layoutBuilder.addBinding(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+		}
+		layoutBuilder.addBinding(7, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT);	// Hi-Z pyramid
+		layoutBuilder.addBinding(8, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);			// CullParams
+		descriptorSetLayout = layoutBuilder.build();
+
+		descriptorPool = AvengDescriptorPool::Builder(engineDevice)
+			.setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT * 7)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, SwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT)
+			.build();
+
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(CullPushConstants);
+
+		VkDescriptorSetLayout setLayout = descriptorSetLayout->getDescriptorSetLayout();
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &setLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(engineDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create culling pipeline layout!");
+		}
+
+		cullPipeline = std::make_unique<ComputePipeline>(engineDevice, "shaders/cull.comp.spv", pipelineLayout);
+		compactPipeline = std::make_unique<ComputePipeline>(engineDevice, "shaders/compact.comp.spv", pipelineLayout);
+
+		// Written once the buffers exist, see cull
+		frames.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (Frame& frame : frames)
+		{
+			if (!descriptorPool->allocateDescriptors(setLayout, frame.descriptorSet))
+			{
+				throw std::runtime_error("failed to allocate culling descriptor set!");
+			}
+
+			frame.params = std::make_unique<AvengBuffer>(
+				engineDevice,
+				sizeof(CullParams),
+				1,
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			frame.params->map();
+		}
+	}
+
+	void GpuCullingSystem::cull(
+		VkCommandBuffer commandBuffer,
+		int frameIndex,
+		const Frustum* frustum,
+		const Occlusion& occlusion,
+		AvengBuffer* instanceBuffer,
+		uint32_t instanceCount,
+		const GpuDrawGroup* groups,
+		uint32_t groupCount,
+		std::pmr::memory_resource* frameArena)
+	{
+		Frame& frame = frames[frameIndex];
+		readBack(frame);
+
+		// The pyramid is bound whether or not it's used, so it has to exist
+		hiZ.resize(commandBuffer, occlusion.depthExtent);
+
+		frame.lastInstances = instanceCount;
+		frame.groupCount = instanceCount > 0 ? groupCount : 0;
+		frame.occlusion = occlusion.enabled && frame.groupCount > 0;
+		frame.viewProj = occlusion.viewProj;
+		if (frame.groupCount == 0) return;
+
+		// Per group inputs, the only thing written per frame that scales with anything but the scene's meshes
+		auto* groupData = static_cast<GpuDrawGroup*>(reserve(
+			frame.groups, sizeof(GpuDrawGroup), groupCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT));
+		std::memcpy(groupData, groups, sizeof(GpuDrawGroup) * groupCount);
+		frame.groups->flush();
+
+		// The early phase's commands, then the late phase's
+		auto* commands = static_cast<VkDrawIndexedIndirectCommand*>(reserve(
+			frame.commands, sizeof(VkDrawIndexedIndirectCommand), groupCount * 2,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT));
+		for (uint32_t g = 0; g < groupCount; g++)
+		{
+			// instanceCount is filled in by cull.comp, and the late firstInstance by compact.comp
+			commands[g] = { groups[g].indexCount, 0, groups[g].firstIndex, groups[g].vertexOffset, groups[g].firstInstance };
+			commands[groupCount + g] = commands[g];
+		}
+		frame.commands->flush();
+
+		auto* drawCount = static_cast<uint32_t*>(reserve(
+			frame.drawCount, sizeof(uint32_t), 2,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT));
+		drawCount[EARLY_PHASE] = 0;
+		drawCount[LATE_PHASE] = 0;
+		frame.drawCount->flush();
+
+		reserve(frame.compacted, sizeof(VkDrawIndexedIndirectCommand), groupCount * 2,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		reserve(frame.visible, instanceBuffer->getInstanceSize(), instanceCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		reserve(frame.retest, sizeof(uint32_t), instanceCount,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		CullParams* params = static_cast<CullParams*>(frame.params->getMappedMemory());
+		for (int p = 0; p < 6; p++)
+		{
+			// A plane with no normal and a positive distance keeps everything
+			params->planes[p] = frustum ? frustum->planes[p] : glm::vec4{ 0.f, 0.f, 0.f, 1.f };
+		}
+		params->occluderViewProj[EARLY_PHASE] = hiZ.getViewProj();
+		params->occluderViewProj[LATE_PHASE] = occlusion.viewProj;
+		params->pyramidSize = glm::vec2(hiZ.getExtent().width, hiZ.getExtent().height);
+		params->pyramidLevels = static_cast<float>(hiZ.getLevelCount());
+		params->instanceCount = instanceCount;
+		params->groupCount = groupCount;
+		frame.params->flush();
+
+		// Only rewrite the set when a buffer was grown or moved by the defragmenter, or the pyramid was resized
+		std::array<VkBuffer, 8> buffers = {
+			instanceBuffer->getBuffer(),
+			frame.groups->getBuffer(),
+			frame.commands->getBuffer(),
+			frame.visible->getBuffer(),
+			frame.drawCount->getBuffer(),
+			frame.compacted->getBuffer(),
+			frame.retest->getBuffer(),
+			frame.params->getBuffer()
+		};
+		if (buffers != frame.boundBuffers || hiZ.getImageView() != frame.boundPyramid)
+		{
+			VkDescriptorBufferInfo bufferInfos[8] = {
+				instanceBuffer->descriptorInfo(),
+				frame.groups->descriptorInfo(),
+				frame.commands->descriptorInfo(),
+				frame.visible->descriptorInfo(),
+				frame.drawCount->descriptorInfo(),
+				frame.compacted->descriptorInfo(),
+				frame.retest->descriptorInfo(),
+				frame.params->descriptorInfo()
+			};
+			VkDescriptorImageInfo pyramidInfo = hiZ.descriptorInfo();
+
+			AvengDescriptorSetWriter writer{ *descriptorSetLayout, *descriptorPool, frameArena };
+			for (uint32_t binding = 0; binding < 7; binding++)
+			{
+				writer.writeBuffer(binding, &bufferInfos[binding]);
+			}
+			writer.writeImage(7, &pyramidInfo, 1);
+			writer.writeBuffer(8, &bufferInfos[7]);
+			writer.overwrite(frame.descriptorSet);
+
+			frame.boundBuffers = buffers;
+			frame.boundPyramid = hiZ.getImageView();
+		}
+
+		// Without last frame's pyramid the early phase can only frustum cull, and the late phase finds nothing to retest
+		dispatchPhase(commandBuffer, frame, EARLY_PHASE, frame.occlusion && hiZ.builtLastFrame(), instanceCount);
+	}
+
+	void GpuCullingSystem::cullLate(VkCommandBuffer commandBuffer, int frameIndex, const SwapChain::DepthTarget& depth, std::pmr::memory_resource* frameArena)
+	{
+		Frame& frame = frames[frameIndex];
+		if (!frame.occlusion) return;
+
+		// The early draws read their half of the outputs while the late phase writes the other
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		hiZ.build(commandBuffer, frameIndex, depth, frame.viewProj, frameArena);
+		dispatchPhase(commandBuffer, frame, LATE_PHASE, true, frame.lastInstances);
+	}
+
+	void GpuCullingSystem::dispatchPhase(VkCommandBuffer commandBuffer, Frame& frame, uint32_t phase, bool occlusion, uint32_t instanceCount)
+	{
+		CullPushConstants push{ phase, occlusion ? 1u : 0u };
+
+		cullPipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &push);
+		vkCmdDispatch(commandBuffer, (instanceCount + 63) / 64, 1, 1);
+
+		// compact.comp reads the instance counts cull.comp just finished adding up
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		// Same layout, the set and push constants stay bound
+		compactPipeline->bind(commandBuffer);
+		vkCmdDispatch(commandBuffer, (frame.groupCount + 63) / 64, 1, 1);
+
+		// Commands and instances feed the draws; the counts are also read back by the CPU once the frame retires
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	int GpuCullingSystem::draw(VkCommandBuffer commandBuffer, int frameIndex, uint32_t phase)
+	{
+		Frame& frame = frames[frameIndex];
+		if (frame.groupCount == 0 || (phase == LATE_PHASE && !frame.occlusion)) return 0;
+
+		const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+		const VkDeviceSize firstCommand = static_cast<VkDeviceSize>(phase) * frame.groupCount * stride;
+
+		if (engineDevice.cmdDrawIndexedIndirectCount != nullptr)
+		{
+			engineDevice.cmdDrawIndexedIndirectCount(
+				commandBuffer,
+				frame.compacted->getBuffer(), firstCommand,
+				frame.drawCount->getBuffer(), phase * sizeof(uint32_t),
+				frame.groupCount, stride);
+			return 1;
+		}
+
+		// No count buffer support, draw every group's command. The empty ones draw nothing
+		uint32_t maxPerCall = engineDevice.enabledFeatures.multiDrawIndirect
+			? engineDevice.properties.limits.maxDrawIndirectCount : 1;
+
+		int drawCalls = 0;
+		for (uint32_t first = 0; first < frame.groupCount; first += maxPerCall)
+		{
+			uint32_t count = std::min(maxPerCall, frame.groupCount - first);
+			vkCmdDrawIndexedIndirect(commandBuffer, frame.commands->getBuffer(), firstCommand + first * stride, count, stride);
+			drawCalls++;
+		}
+		return drawCalls;
+	}
+
+	// This frame slot's last submission has retired, the counts cull.comp wrote are final
+	void GpuCullingSystem::readBack(Frame& frame)
+	{
+		frame.lastVisible = 0;
+		frame.lastLate = 0;
+		if (frame.groupCount == 0) return;
+
+		frame.commands->invalidate();
+		auto* commands = static_cast<const VkDrawIndexedIndirectCommand*>(frame.commands->getMappedMemory());
+		for (uint32_t g = 0; g < frame.groupCount; g++)
+		{
+			frame.lastVisible += commands[g].instanceCount;
+			frame.lastLate += commands[frame.groupCount + g].instanceCount;
+		}
+		frame.lastVisible += frame.lastLate;
+	}
+
+	/*
+	* Grow one of the frame's buffers to hold count elements. Host visible buffers come back mapped.
+	* Replaced buffers are retired through the deletion queue.
+	*/
+	void* GpuCullingSystem::reserve(std::unique_ptr<AvengBuffer>& buffer, VkDeviceSize elementSize, size_t count, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
+	{
+		if (!buffer || buffer->getInstanceCount() < count)
+		{
+			size_t capacity = std::max<size_t>(count, buffer ? buffer->getInstanceCount() * 2 : 64);
+			buffer = std::make_unique<AvengBuffer>(engineDevice, elementSize, static_cast<uint32_t>(capacity), usage, properties);
+			if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) buffer->map();
+		}
+		return buffer->getMappedMemory();
+	}
+
+}
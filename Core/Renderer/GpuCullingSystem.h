@@ -0,0 +1,155 @@
+#pragma once
+
+#include "HiZPyramid.h"
+#include "../Math/aveng_culling.h"
+#include "../../CoreVK/EngineDevice.h"
+#include "../../CoreVK/ComputePipeline.h"
+#include "../../CoreVK/aveng_buffer.h"
+#include "../../CoreVK/aveng_descriptors.h"
+#include "../../CoreVK/aveng_geometry_arena.h"
+#include "../../CoreVK/swapchain.h"
+
+#include "../../avpch.h"
+
+#include <array>
+#include <memory_resource>
+
+namespace aveng {
+
+	/*
+	* @class GpuCullingSystem
+	* Frustum and occlusion culls instances in a compute pass and writes the indirect draws for whatever survives.
+	*
+	* cull.comp runs one invocation per instance: it tests the instance's world bounding sphere,
+	* and a survivor bumps its group's instanceCount and copies itself to the next free slot of
+	* that group's range in the visible buffer. compact.comp then packs the non empty commands
+	* to the front and counts them, for vkCmdDrawIndexedIndirectCount. The CPU only writes
+	* one command per group, so its cost no longer scales with what is in view.
+	*
+	* With occlusion enabled culling runs in two phases. The early phase (cull) also tests each
+	* instance against the Hi-Z pyramid of the previous frame's depth, and draws what passes.
+	* Whatever it rejected as hidden is tested again in the late phase (cullLate), against a pyramid
+	* reduced from the depth the early draws just wrote. Objects that came into view this frame are
+	* caught there and drawn after the early ones, so nothing pops in a frame late.
+	* The late pyramid is also the one the next frame's early phase uses.
+	*/
+	class GpuCullingSystem {
+
+	public:
+
+		// Mirrors DrawGroup in cull.comp
+		struct GpuDrawGroup {
+			glm::vec4 sphere{};			// Object space bounding sphere of the mesh
+			uint32_t indexCount = 0;	// 0 for meshes outside the geometry arena, which are skipped
+			uint32_t firstIndex = 0;
+			int32_t vertexOffset = 0;
+			uint32_t firstInstance = 0;
+		};
+
+		struct Occlusion {
+			bool enabled;
+			glm::mat4 viewProj;			// This frame's
+			VkExtent2D depthExtent;
+		};
+
+		static constexpr uint32_t EARLY_PHASE = 0;
+		static constexpr uint32_t LATE_PHASE = 1;
+
+		GpuCullingSystem(EngineDevice& device);
+		~GpuCullingSystem();
+
+		GpuCullingSystem(const GpuCullingSystem&) = delete;
+		GpuCullingSystem& operator=(const GpuCullingSystem&) = delete;
+
+		void initialize();
+
+		/*
+		* Record the early phase for instanceCount instances of instanceBuffer, in any order. Each names its
+		* group by drawGroup, or is skipped with UINT32_MAX, and a group's survivors are written from its
+		* firstInstance on, so the groups' ranges have to leave room for all of their instances.
+		* frustum may be nullptr to keep everything. Must be recorded outside of a render pass.
+		*/
+		void cull(
+			VkCommandBuffer commandBuffer,
+			int frameIndex,
+			const Frustum* frustum,
+			const Occlusion& occlusion,
+			AvengBuffer* instanceBuffer,
+			uint32_t instanceCount,
+			const GpuDrawGroup* groups,
+			uint32_t groupCount,
+			std::pmr::memory_resource* frameArena);
+
+		// Whether cull left a late phase to run this frame
+		bool hasLatePhase(int frameIndex) const { return frames[frameIndex].occlusion; }
+
+		/*
+		* Record the late phase: reduce depth, holding what the early draws wrote, into the pyramid
+		* and retest what the early phase found hidden. Must be recorded outside of a render pass.
+		*/
+		void cullLate(VkCommandBuffer commandBuffer, int frameIndex, const SwapChain::DepthTarget& depth, std::pmr::memory_resource* frameArena);
+
+		// Issue the draws written by one phase. The caller binds the pipeline, the arena, and visibleInstances at binding 1
+		int draw(VkCommandBuffer commandBuffer, int frameIndex, uint32_t phase = EARLY_PHASE);
+
+		VkBuffer visibleInstances(int frameIndex) const { return frames[frameIndex].visible->getBuffer(); }
+
+		// Survivors of the last cull recorded for this frame slot, read back once it has retired
+		uint32_t lastVisibleCount(int frameIndex) const { return frames[frameIndex].lastVisible; }
+		uint32_t lastLateCount(int frameIndex) const { return frames[frameIndex].lastLate; }
+		uint32_t lastInstanceCount(int frameIndex) const { return frames[frameIndex].lastInstances; }
+
+	private:
+
+		struct Frame {
+			std::unique_ptr<AvengBuffer> params;		// Host visible, CullParams
+			std::unique_ptr<AvengBuffer> groups;		// Host visible, GpuDrawGroup per group
+			std::unique_ptr<AvengBuffer> commands;		// Host visible, one VkDrawIndexedIndirectCommand per group per phase
+			std::unique_ptr<AvengBuffer> drawCount;		// Host visible, one count per phase, written by compact.comp
+			std::unique_ptr<AvengBuffer> compacted;		// Device local, each phase's non empty commands packed to the front of its half
+			std::unique_ptr<AvengBuffer> visible;		// Device local, surviving instances
+			std::unique_ptr<AvengBuffer> retest;		// Device local, per instance flag set by the early phase
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			std::array<VkBuffer, 8> boundBuffers{};		// What descriptorSet currently points at
+			VkImageView boundPyramid = VK_NULL_HANDLE;
+			uint32_t groupCount = 0;
+			bool occlusion = false;
+			glm::mat4 viewProj{ 1.f };
+			uint32_t lastVisible = 0;
+			uint32_t lastLate = 0;
+			uint32_t lastInstances = 0;
+		};
+
+		// Mirrors Params in cull.comp, std140
+		struct CullParams {
+			glm::vec4 planes[6];
+			glm::mat4 occluderViewProj[2];		// What the pyramid each phase tests against was rendered with
+			glm::vec2 pyramidSize;
+			float pyramidLevels;
+			uint32_t instanceCount;
+			uint32_t groupCount;
+		};
+
+		struct CullPushConstants {
+			uint32_t phase;
+			uint32_t occlusion;
+		};
+
+		void dispatchPhase(VkCommandBuffer commandBuffer, Frame& frame, uint32_t phase, bool occlusion, uint32_t instanceCount);
+		void readBack(Frame& frame);
+		void* reserve(std::unique_ptr<AvengBuffer>& buffer, VkDeviceSize elementSize, size_t count, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+
+		EngineDevice& engineDevice;
+		HiZPyramid hiZ{ engineDevice };
+
+		std::unique_ptr<AvengDescriptorSetLayout> descriptorSetLayout;
+		std::unique_ptr<AvengDescriptorPool> descriptorPool;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		std::unique_ptr<ComputePipeline> cullPipeline;
+		std::unique_ptr<ComputePipeline> compactPipeline;
+
+		std::vector<Frame> frames;
+
+	};
+
+}
@@ -0,0 +1,128 @@
+#include "GpuInstanceStore.h"
+#include "../../CoreVK/swapchain.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace aveng {
+
+	GpuInstanceStore::GpuInstanceStore(EngineDevice& device, VkDeviceSize elementSize)
+		: engineDevice{ device }, elementSize{ elementSize }
+	{
+		staging.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+	}
+
+	uint32_t GpuInstanceStore::acquire()
+	{
+		if (!freeSlots.empty())
+		{
+			uint32_t slot = freeSlots.back();
+			freeSlots.pop_back();
+			return slot;
+		}
+
+		pendingOf.push_back(NO_SLOT);
+		return slotCount() - 1;
+	}
+
+	void GpuInstanceStore::release(uint32_t slot)
+	{
+		assert(slot < slotCount() && "Releasing a slot that was never acquired");
+		freeSlots.push_back(slot);
+	}
+
+	void* GpuInstanceStore::write(uint32_t slot)
+	{
+		uint32_t& index = pendingOf[slot];
+		if (index == NO_SLOT)
+		{
+			index = static_cast<uint32_t>(pendingSlots.size());
+			pendingSlots.push_back(slot);
+			pending.resize(pending.size() + elementSize);
+		}
+		return pending.data() + index * elementSize;
+	}
+
+	void GpuInstanceStore::upload(VkCommandBuffer commandBuffer, int frameIndex)
+	{
+		if (pendingSlots.empty()) return;
+
+		if (!resident || resident->getInstanceCount() < slotCount())
+		{
+			grow(commandBuffer, std::max(slotCount(), resident ? resident->getInstanceCount() * 2 : 64u));
+		}
+
+		// This frame slot's last submission has retired, its staging buffer is free again
+		std::unique_ptr<AvengBuffer>& stage = staging[frameIndex];
+		if (!stage || stage->getInstanceCount() < pendingSlots.size())
+		{
+			size_t capacity = std::max<size_t>(pendingSlots.size(), stage ? stage->getInstanceCount() * 2 : 64);
+			stage = std::make_unique<AvengBuffer>(engineDevice, elementSize, static_cast<uint32_t>(capacity),
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			stage->map();
+		}
+		std::memcpy(stage->getMappedMemory(), pending.data(), pending.size());
+		stage->flush();
+
+		regions.resize(pendingSlots.size());
+		for (size_t n = 0; n < pendingSlots.size(); n++)
+		{
+			regions[n].srcOffset = n * elementSize;
+			regions[n].dstOffset = pendingSlots[n] * elementSize;
+			regions[n].size = elementSize;
+			pendingOf[pendingSlots[n]] = NO_SLOT;
+		}
+
+		// The previous frame may still be reading the slots about to be overwritten
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+		vkCmdCopyBuffer(commandBuffer, stage->getBuffer(), resident->getBuffer(), static_cast<uint32_t>(regions.size()), regions.data());
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		pending.clear();
+		pendingSlots.clear();
+	}
+
+	// Replace the resident buffer with a larger one holding the same elements. The old one is retired through the deletion queue
+	void GpuInstanceStore::grow(VkCommandBuffer commandBuffer, uint32_t capacity)
+	{
+		auto grown = std::make_unique<AvengBuffer>(engineDevice, elementSize, capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		if (resident)
+		{
+			// The old buffer's last upload has to land before it is copied
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+			VkBufferCopy region{};
+			region.size = resident->getBufferSize();
+			vkCmdCopyBuffer(commandBuffer, resident->getBuffer(), grown->getBuffer(), 1, &region);
+
+			// upload's copies overwrite some of what was just copied
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+
+		resident = std::move(grown);
+	}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "../../CoreVK/EngineDevice.h"
+#include "../../CoreVK/aveng_buffer.h"
+
+#include "../../avpch.h"
+
+#include <memory>
+#include <vector>
+
+namespace aveng {
+
+	/*
+	* @class GpuInstanceStore
+	* Fixed size elements kept resident in a device local storage buffer across frames, one per slot.
+	* A slot keeps its element until it is written again, so the CPU only uploads what changed:
+	* write stages an element for its slot, and upload records the copies of everything staged
+	* since the last upload out of a host visible staging buffer per frame in flight.
+	*
+	* Released slots are handed out again before the buffer grows, and the buffer keeps its
+	* contents when it does. What a released slot holds is up to the caller, who should
+	* overwrite it with something its readers skip.
+	*/
+	class GpuInstanceStore {
+
+	public:
+
+		static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+		GpuInstanceStore(EngineDevice& device, VkDeviceSize elementSize);
+
+		GpuInstanceStore(const GpuInstanceStore&) = delete;
+		GpuInstanceStore& operator=(const GpuInstanceStore&) = delete;
+
+		uint32_t acquire();
+		void release(uint32_t slot);
+
+		// Space for slot's new element, valid until the next write and uploaded by the next upload. Writing a slot twice before then keeps the last
+		void* write(uint32_t slot);
+
+		/*
+		* Record the copies of every staged element into the resident buffer, growing it first if slots
+		* went past its end. Must be recorded outside of a render pass, before anything reads the buffer
+		* this frame; the copies wait for the previous frames' compute reads of it.
+		*/
+		void upload(VkCommandBuffer commandBuffer, int frameIndex);
+
+		// Slots handed out so far, released ones included. Readers go over [0, slotCount)
+		uint32_t slotCount() const { return static_cast<uint32_t>(pendingOf.size()); }
+		bool empty() const { return slotCount() == 0; }
+
+		// Null until the first upload with a slot in use
+		AvengBuffer* buffer() const { return resident.get(); }
+
+	private:
+
+		void grow(VkCommandBuffer commandBuffer, uint32_t capacity);
+
+		EngineDevice& engineDevice;
+		VkDeviceSize elementSize;
+
+		std::unique_ptr<AvengBuffer> resident;					// Device local
+		std::vector<std::unique_ptr<AvengBuffer>> staging;		// Host visible, one per frame in flight. Grown on demand, never shrunk
+
+		std::vector<uint32_t> freeSlots;
+		std::vector<uint8_t> pending;			// Elements staged since the last upload, back to back
+		std::vector<uint32_t> pendingSlots;		// The slot of each element in pending
+		std::vector<uint32_t> pendingOf;		// By slot, its element's index in pending or NO_SLOT
+		std::vector<VkBufferCopy> regions;		// upload's, kept so it doesn't allocate every frame
+
+	};
+
+}
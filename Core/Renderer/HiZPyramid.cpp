@@ -0,0 +1,285 @@
+#include "HiZPyramid.h"
+
+#include <algorithm>
+
+namespace aveng {
+
+	HiZPyramid::HiZPyramid(EngineDevice& device) : engineDevice{ device }
+	{
+
+	}
+
+	HiZPyramid::~HiZPyramid()
+	{
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			vkDestroyImageView(engineDevice.device(), levelViews[level], nullptr);
+		}
+		vkDestroyImageView(engineDevice.device(), imageView, nullptr);
+		vkDestroyImage(engineDevice.device(), image, nullptr);
+		vkFreeMemory(engineDevice.device(), imageMemory, nullptr);
+		vkDestroySampler(engineDevice.device(), sampler, nullptr);
+		vkDestroyPipelineLayout(engineDevice.device(), pipelineLayout, nullptr);
+	}
+
+	void HiZPyramid::initialize()
+	{
+		descriptorSetLayout = AvengDescriptorSetLayout::Builder(engineDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)		// Level below, or the depth buffer
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)				// Level being written
+			.build();
+
+		descriptorPool = AvengDescriptorPool::Builder(engineDevice)
+			.setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT * MAX_LEVELS)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, SwapChain::MAX_FRAMES_IN_FLIGHT * MAX_LEVELS)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, SwapChain::MAX_FRAMES_IN_FLIGHT * MAX_LEVELS)
+			.build();
+
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(ReducePushConstants);
+
+		VkDescriptorSetLayout setLayout = descriptorSetLayout->getDescriptorSetLayout();
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &setLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(engineDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create Hi-Z pipeline layout!");
+		}
+
+		reducePipeline = std::make_unique<ComputePipeline>(engineDevice, "shaders/hiz_reduce.comp.spv", pipelineLayout);
+
+		// Point sampling, the culling shader picks the level itself
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.minLod = 0.f;
+		samplerInfo.maxLod = static_cast<float>(MAX_LEVELS);
+
+		if (vkCreateSampler(engineDevice.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create Hi-Z sampler!");
+		}
+
+		frames.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (Frame& frame : frames)
+		{
+			for (VkDescriptorSet& set : frame.sets)
+			{
+				if (!descriptorPool->allocateDescriptors(setLayout, set))
+				{
+					throw std::runtime_error("failed to allocate Hi-Z descriptor set!");
+				}
+			}
+		}
+	}
+
+	void HiZPyramid::resize(VkCommandBuffer commandBuffer, VkExtent2D newDepthExtent)
+	{
+		if (image != VK_NULL_HANDLE && newDepthExtent.width == depthExtent.width && newDepthExtent.height == depthExtent.height) return;
+
+		destroyImage();
+
+		auto previousPowerOfTwo = [](uint32_t value) {
+			uint32_t power = 1;
+			while (power * 2 <= value) power *= 2;
+			return power;
+		};
+
+		depthExtent = newDepthExtent;
+		extent = { previousPowerOfTwo(depthExtent.width), previousPowerOfTwo(depthExtent.height) };
+		levelCount = 1;
+		while (levelCount < MAX_LEVELS && (std::max(extent.width, extent.height) >> levelCount) > 0) levelCount++;
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = { extent.width, extent.height, 1 };
+		imageInfo.mipLevels = levelCount;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = VK_FORMAT_R32_SFLOAT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		engineDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+
+		if (vkCreateImageView(engineDevice.device(), &viewInfo, nullptr, &imageView) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create Hi-Z image view!");
+		}
+
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+			if (vkCreateImageView(engineDevice.device(), &viewInfo, nullptr, &levelViews[level]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create Hi-Z image view!");
+			}
+		}
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		// Nothing has been reduced into the new image yet
+		builtFrame = UINT64_MAX;
+	}
+
+	void HiZPyramid::build(VkCommandBuffer commandBuffer, int frameIndex, const SwapChain::DepthTarget& depth, const glm::mat4& depthViewProj, std::pmr::memory_resource* frameArena)
+	{
+		assert(image != VK_NULL_HANDLE && "Hi-Z pyramid built before resize");
+		assert(depth.sampleable && "Depth buffer can't be sampled");
+
+		Frame& frame = frames[frameIndex];
+		updateDescriptorSets(frame, depth, frameArena);
+
+		VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+		if (depth.format == VK_FORMAT_D32_SFLOAT_S8_UINT || depth.format == VK_FORMAT_D24_UNORM_S8_UINT)
+			depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+		// Depth writes land before the reduction reads them, and earlier culling reads of the pyramid finish before it's overwritten
+		VkImageMemoryBarrier depthBarrier{};
+		depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		depthBarrier.image = depth.image;
+		depthBarrier.subresourceRange = { depthAspect, 0, 1, 0, 1 };
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+
+		reducePipeline->bind(commandBuffer);
+
+		VkMemoryBarrier levelBarrier{};
+		levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		glm::ivec2 srcSize(depthExtent.width, depthExtent.height);
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			ReducePushConstants push{};
+			push.srcSize = srcSize;
+			push.dstSize = glm::ivec2(std::max(1u, extent.width >> level), std::max(1u, extent.height >> level));
+
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &frame.sets[level], 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ReducePushConstants), &push);
+			vkCmdDispatch(commandBuffer, (push.dstSize.x + 7) / 8, (push.dstSize.y + 7) / 8, 1);
+
+			// The next level reads this one, and after the last level, whoever culls against it
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+
+			srcSize = push.dstSize;
+		}
+
+		// Hand the depth buffer back to the render pass
+		depthBarrier.srcAccessMask = 0;
+		depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depthBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+
+		viewProj = depthViewProj;
+		builtFrame = engineDevice.deletionQueue().currentFrame();
+	}
+
+	bool HiZPyramid::builtLastFrame() const
+	{
+		return builtFrame != UINT64_MAX && builtFrame + 1 == engineDevice.deletionQueue().currentFrame();
+	}
+
+	void HiZPyramid::updateDescriptorSets(Frame& frame, const SwapChain::DepthTarget& depth, std::pmr::memory_resource* frameArena)
+	{
+		// This frame slot's last submission has retired, its sets are free to rewrite
+		if (frame.swapChainId == depth.swapChainId && frame.depthView == depth.view && frame.pyramidView == imageView) return;
+
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			VkDescriptorImageInfo src = level == 0
+				? VkDescriptorImageInfo{ sampler, depth.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL }
+				: VkDescriptorImageInfo{ sampler, levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL };
+			VkDescriptorImageInfo dst{ VK_NULL_HANDLE, levelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+
+			AvengDescriptorSetWriter(*descriptorSetLayout, *descriptorPool, frameArena)
+				.writeImage(0, &src, 1)
+				.writeImage(1, &dst, 1)
+				.overwrite(frame.sets[level]);
+		}
+
+		frame.swapChainId = depth.swapChainId;
+		frame.depthView = depth.view;
+		frame.pyramidView = imageView;
+	}
+
+	// Frames still in flight may sample the old pyramid, it goes once they retire
+	void HiZPyramid::destroyImage()
+	{
+		if (image == VK_NULL_HANDLE) return;
+
+		VkDevice device = engineDevice.device();
+		VkImage oldImage = image;
+		VkDeviceMemory oldMemory = imageMemory;
+		VkImageView oldView = imageView;
+		std::array<VkImageView, MAX_LEVELS> oldLevelViews = levelViews;
+		uint32_t oldLevelCount = levelCount;
+
+		engineDevice.deletionQueue().push([=]() {
+			for (uint32_t level = 0; level < oldLevelCount; level++)
+			{
+				vkDestroyImageView(device, oldLevelViews[level], nullptr);
+			}
+			vkDestroyImageView(device, oldView, nullptr);
+			vkDestroyImage(device, oldImage, nullptr);
+			vkFreeMemory(device, oldMemory, nullptr);
+		});
+
+		image = VK_NULL_HANDLE;
+		imageMemory = VK_NULL_HANDLE;
+		imageView = VK_NULL_HANDLE;
+		levelViews = {};
+		levelCount = 0;
+	}
+
+}
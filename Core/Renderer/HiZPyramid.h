@@ -0,0 +1,100 @@
+#pragma once
+
+#include "../../CoreVK/EngineDevice.h"
+#include "../../CoreVK/ComputePipeline.h"
+#include "../../CoreVK/aveng_descriptors.h"
+#include "../../CoreVK/swapchain.h"
+
+#include "../../avpch.h"
+
+#include <array>
+#include <memory_resource>
+
+namespace aveng {
+
+	/*
+	* @class HiZPyramid
+	* Hierarchical depth: a mip chain in which every texel holds the farthest depth of the texels it
+	* covers in the level below, with level 0 reduced from the depth buffer itself. An object whose
+	* nearest depth is behind the farthest depth under its screen space bounds is hidden, and with the
+	* right level that takes four samples no matter how large the object is on screen.
+	*
+	* Level 0 is the largest power of two that fits in the depth buffer. The reduction takes every
+	* source texel a destination texel covers, so it stays conservative for odd sizes.
+	* The image lives in VK_IMAGE_LAYOUT_GENERAL.
+	*/
+	class HiZPyramid {
+
+	public:
+
+		static constexpr uint32_t MAX_LEVELS = 16;
+
+		HiZPyramid(EngineDevice& device);
+		~HiZPyramid();
+
+		HiZPyramid(const HiZPyramid&) = delete;
+		HiZPyramid& operator=(const HiZPyramid&) = delete;
+
+		void initialize();
+
+		// (Re)create the pyramid for a depth buffer of this size. Must be recorded before anything samples it this frame
+		void resize(VkCommandBuffer commandBuffer, VkExtent2D depthExtent);
+
+		/*
+		* Record the reduction of depth into the pyramid. The depth image is expected in
+		* VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, outside of a render pass, and is left there.
+		* viewProj is what that depth was rendered with.
+		*/
+		void build(VkCommandBuffer commandBuffer, int frameIndex, const SwapChain::DepthTarget& depth, const glm::mat4& viewProj, std::pmr::memory_resource* frameArena);
+
+		// True when the frame before the one being recorded built the pyramid, and nothing has resized it since
+		bool builtLastFrame() const;
+
+		const glm::mat4& getViewProj() const { return viewProj; }
+		VkExtent2D getExtent() const { return extent; }
+		uint32_t getLevelCount() const { return levelCount; }
+		VkImageView getImageView() const { return imageView; }
+		VkDescriptorImageInfo descriptorInfo() const { return { sampler, imageView, VK_IMAGE_LAYOUT_GENERAL }; }
+
+	private:
+
+		// One set per level per frame in flight, rewritten when the depth buffer or the pyramid is replaced
+		struct Frame {
+			std::array<VkDescriptorSet, MAX_LEVELS> sets{};
+			uint64_t swapChainId = 0;
+			VkImageView depthView = VK_NULL_HANDLE;
+			VkImageView pyramidView = VK_NULL_HANDLE;
+		};
+
+		struct ReducePushConstants {
+			glm::ivec2 srcSize;
+			glm::ivec2 dstSize;
+		};
+
+		void destroyImage();
+		void updateDescriptorSets(Frame& frame, const SwapChain::DepthTarget& depth, std::pmr::memory_resource* frameArena);
+
+		EngineDevice& engineDevice;
+
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+		VkImageView imageView = VK_NULL_HANDLE;				// Every level, for culling
+		std::array<VkImageView, MAX_LEVELS> levelViews{};	// One level each, for the reduction
+		VkSampler sampler = VK_NULL_HANDLE;
+		VkExtent2D extent{ 0, 0 };
+		VkExtent2D depthExtent{ 0, 0 };
+		uint32_t levelCount = 0;
+
+		glm::mat4 viewProj{ 1.f };
+		uint64_t builtFrame = UINT64_MAX;
+
+		std::unique_ptr<AvengDescriptorSetLayout> descriptorSetLayout;
+		std::unique_ptr<AvengDescriptorPool> descriptorPool;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		std::unique_ptr<ComputePipeline> reducePipeline;
+
+		std::vector<Frame> frames;
+
+	};
+
+}
@@ -2,6 +2,11 @@
 #include "../Math/aveng_math.h"
 #include "../Events/window_callbacks.h"
 #include "../Player/GameplayFunctions.h"
+#include "../Math/aveng_culling.h"
+#include "../../CoreVK/swapchain.h"
+
+#include <algorithm>
+#include <memory_resource>
 
 namespace aveng {
 
@@ -17,11 +22,12 @@ namespace aveng {
 
 	}
 
-	void ObjectRenderSystem::initialize( VkRenderPass renderPass, VkDescriptorSetLayout globalDescriptorSetLayout, VkDescriptorSetLayout objDescriptorSetLayout)
+	void ObjectRenderSystem::initialize( VkRenderPass renderPass, VkDescriptorSetLayout globalDescriptorSetLayout, VkDescriptorSetLayout objDescriptorSetLayout, bool gBuffer)
 	{
 		VkDescriptorSetLayout descriptorSetLayouts[2] = { globalDescriptorSetLayout , objDescriptorSetLayout };
 		createPipelineLayout(descriptorSetLayouts);
-		createPipeline(renderPass);
+		createPipeline(renderPass, gBuffer);
+		gpuCulling.initialize();
 	}
 
 	ObjectRenderSystem::~ObjectRenderSystem()
@@ -62,7 +68,7 @@ namespace aveng {
 	* Call to the construction of a Graphics Pipeline.
 	* Note that shader filepaths are relative to the GFXPipeline.cpp file.
 	*/
-	void ObjectRenderSystem::createPipeline(VkRenderPass renderPass)
+	void ObjectRenderSystem::createPipeline(VkRenderPass renderPass, bool gBuffer)
 	{
 		// Initialize the pipeline 
 		assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
@@ -76,17 +82,98 @@ namespace aveng {
 		gfxPipeline = std::make_unique<GFXPipeline>(
 			engineDevice,
 			"shaders/simple_shader.vert.spv",
-			"shaders/simple_shader.frag.spv",
+			gBuffer ? "shaders/gbuffer.frag.spv" : "shaders/simple_shader.frag.spv",
 			pipelineConfig
 		);
 
-		// Another GFXPipeline
+		// Another GFXPipeline. simple_shader2 has no G-buffer variant, deferred it draws as the first
 		gfxPipeline2 = std::make_unique<GFXPipeline>(
 			engineDevice,
-			"shaders/simple_shader2.vert.spv",
-			"shaders/simple_shader2.frag.spv",
+			gBuffer ? "shaders/simple_shader.vert.spv" : "shaders/simple_shader2.vert.spv",
+			gBuffer ? "shaders/gbuffer.frag.spv" : "shaders/simple_shader2.frag.spv",
+			pipelineConfig
+		);
+
+		// Behind the depth pre-pass, shading only what matches the depth it laid down
+		pipelineConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+		pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+		gfxPipelineEqual = std::make_unique<GFXPipeline>(
+			engineDevice,
+			"shaders/simple_shader.vert.spv",
+			gBuffer ? "shaders/gbuffer.frag.spv" : "shaders/simple_shader.frag.spv",
 			pipelineConfig
 		);
+
+		// Instanced GFXPipeline - binding 1 advances once per instance instead of once per vertex
+		PipelineConfig instancedConfig{};
+		GFXPipeline::defaultPipelineConfig(instancedConfig);
+		instancedConfig.renderPass = renderPass;
+		instancedConfig.pipelineLayout = pipelineLayout;
+		instancedConfig.bindingDescriptions.push_back({ 1, sizeof(InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE });
+
+		// A mat4 attribute takes 4 consecutive locations, one per column
+		for (uint32_t column = 0; column < 4; column++)
+		{
+			instancedConfig.attributeDescriptions.push_back({ 4 + column, 1, VK_FORMAT_R32G32B32A32_SFLOAT,
+				static_cast<uint32_t>(offsetof(InstanceData, modelMatrix) + column * sizeof(glm::vec4)) });
+		}
+		for (uint32_t column = 0; column < 3; column++)
+		{
+			instancedConfig.attributeDescriptions.push_back({ 8 + column, 1, VK_FORMAT_R32G32B32_SFLOAT,
+				static_cast<uint32_t>(offsetof(InstanceData, normalMatrix) + column * sizeof(glm::vec4)) });
+		}
+		instancedConfig.attributeDescriptions.push_back({ 11, 1, VK_FORMAT_R32_UINT, static_cast<uint32_t>(offsetof(InstanceData, texIndex)) });
+
+		instancedPipeline = std::make_unique<GFXPipeline>(
+			engineDevice,
+			"shaders/instanced_shader.vert.spv",
+			gBuffer ? "shaders/gbuffer_instanced.frag.spv" : "shaders/instanced_shader.frag.spv",
+			instancedConfig
+		);
+
+		instancedConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+		instancedConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+		instancedPipelineEqual = std::make_unique<GFXPipeline>(
+			engineDevice,
+			"shaders/instanced_shader.vert.spv",
+			gBuffer ? "shaders/gbuffer_instanced.frag.spv" : "shaders/instanced_shader.frag.spv",
+			instancedConfig
+		);
+
+		// The depth pre-pass. Only the position is read from the interleaved vertex buffer, and no color is written
+		PipelineConfig depthConfig{};
+		GFXPipeline::defaultPipelineConfig(depthConfig);
+		depthConfig.renderPass = renderPass;
+		depthConfig.pipelineLayout = pipelineLayout;
+		depthConfig.colorBlendAttachment.colorWriteMask = 0;
+		depthConfig.attributeDescriptions = { { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(AvengModel::Vertex, position)) } };
+
+		depthPipeline = std::make_unique<GFXPipeline>(
+			engineDevice,
+			"shaders/depth_only.vert.spv",
+			"shaders/depth_only.frag.spv",
+			depthConfig
+		);
+
+		// and its instanced twin, with nothing but the model matrix from binding 1
+		depthConfig.bindingDescriptions.push_back({ 1, sizeof(InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE });
+		for (uint32_t column = 0; column < 4; column++)
+		{
+			depthConfig.attributeDescriptions.push_back({ 4 + column, 1, VK_FORMAT_R32G32B32A32_SFLOAT,
+				static_cast<uint32_t>(offsetof(InstanceData, modelMatrix) + column * sizeof(glm::vec4)) });
+		}
+
+		depthInstancedPipeline = std::make_unique<GFXPipeline>(
+			engineDevice,
+			"shaders/depth_only_instanced.vert.spv",
+			"shaders/depth_only.frag.spv",
+			depthConfig
+		);
+
+		instanceBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+		indirectBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+		countBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+		staticCaches.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
 	}
 
 	void ObjectRenderSystem::render(FrameContent& frame_content, Data& data, AvengBuffer& u_ObjBuffer)
@@ -98,17 +185,284 @@ namespace aveng {
 			std::cout << "Tick..." << std::endl;
 		}
 
-		// Bind our current pipeline configuration
-		switch (data.cur_pipe)
+		recordPass(frame_content, data, u_ObjBuffer, PASS_SHADING);
+	}
+
+	void ObjectRenderSystem::renderDepthPrepass(FrameContent& frame_content, Data& data, AvengBuffer& u_ObjBuffer)
+	{
+		recordPass(frame_content, data, u_ObjBuffer, PASS_DEPTH);
+	}
+
+	// Everything was gathered by prepare, so both passes record the same draws
+	void ObjectRenderSystem::recordPass(FrameContent& frame_content, Data& data, AvengBuffer& u_ObjBuffer, Pass pass)
+	{
+		switch (preparedMode)
+		{
+			case DRAW_PER_OBJECT: renderPerObject(frame_content, data, u_ObjBuffer, pass); break;
+			case DRAW_INSTANCED:  renderInstanced(frame_content, data, pass); break;
+			case DRAW_GPU_CULLED: renderGpuCulled(frame_content, data, pass); break;
+			default:
+				renderIndirect(frame_content, data, pass);
+		}
+	}
+
+	GFXPipeline& ObjectRenderSystem::pipelineFor(uint32_t id, Pass pass)
+	{
+		if (pass == PASS_DEPTH) return id == PIPELINE_INSTANCED ? *depthInstancedPipeline : *depthPipeline;
+
+		// prepare turns the pre-pass off for simple_shader2, see hasDepthPrepass
+		assert((!depthPrepass || id != PIPELINE_SIMPLE_2) && "simple_shader2 has no pipeline behind the depth pre-pass");
+		switch (id)
 		{
-			case 98: gfxPipeline->bind(frame_content.commandBuffer);  break;
-			case 99: gfxPipeline2->bind(frame_content.commandBuffer); break;
+			case PIPELINE_SIMPLE:   return depthPrepass ? *gfxPipelineEqual : *gfxPipeline;
+			case PIPELINE_SIMPLE_2: return *gfxPipeline2;
 			default:
-				gfxPipeline->bind(frame_content.commandBuffer); // 0
+				return depthPrepass ? *instancedPipelineEqual : *instancedPipeline;
+		}
+	}
+
+	/*
+	* The per object draws in sort key order, gathered by prepare. Decides how many chunks the
+	* pass is recorded in, one per participating thread once there are enough draws to go around.
+	*/
+	void ObjectRenderSystem::preparePerObject(FrameContent& frame_content, Data& data)
+	{
+		std::pmr::vector<DrawItem> items{ frame_content.frameArena };
+		std::pmr::vector<DrawItem> statics{ frame_content.frameArena };
+		gatherVisible(frame_content, data, items, true, data.cacheStatic ? &statics : nullptr);
+
+		// Selected in the GUI, the whole pass uses the one pipeline
+		uint32_t pipeline = perObjectPipeline;
+
+		RenderQueue queue{ frame_content.frameArena };
+		sortDraws(frame_content, items, pipeline, queue);
+
+		perObjectDraws.reserve(queue.size());
+		for (const RenderQueue::Entry& entry : queue)
+		{
+			perObjectDraws.push_back(items[entry.index]);
+		}
+
+		// Without depth, so the order (and the cached recording) doesn't change as the camera moves
+		RenderQueue staticQueue{ frame_content.frameArena };
+		staticQueue.reserve(statics.size());
+		for (size_t n = 0; n < statics.size(); n++)
+		{
+			staticQueue.push(RenderQueue::makeKey(pipeline, static_cast<uint32_t>(statics[n].texIndex), statics[n].model->getId(), 0.f), static_cast<uint32_t>(n));
+		}
+		staticQueue.sort();
+
+		staticDraws.reserve(staticQueue.size());
+		for (const RenderQueue::Entry& entry : staticQueue)
+		{
+			staticDraws.push_back(statics[entry.index]);
+		}
+		data.staticObjects = static_cast<int>(staticDraws.size());
+
+		size_t threadCount = frame_content.workers ? frame_content.workers->threads.size() : 0;
+		recordChunks = data.parallelRecording
+			? std::min(threadCount + 1, std::max<size_t>(1, perObjectDraws.size() / MIN_DRAWS_PER_CHUNK))
+			: 1;
+		if (recordChunks > 1) commandPools.reserveThreads(static_cast<uint32_t>(recordChunks));
+	}
+
+	/*
+	* One draw per object, in sort key order. Texture and mesh are only bound when they change from
+	* the previous draw: each run of one texture writes its index into the next slot of the dynamic
+	* uniform buffer, and every object pushes its own matrices.
+	* Past MIN_DRAWS_PER_CHUNK draws per thread the draws are split into contiguous chunks, each recorded
+	* into a secondary command buffer on its own thread, and the render pass executes them in order.
+	* Static draws are replayed from a cached secondary buffer ahead of the rest, see recordStatic.
+	* The depth pre-pass records the same draws without binding textures.
+	*/
+	void ObjectRenderSystem::renderPerObject(FrameContent& frame_content, Data& data, AvengBuffer& u_ObjBuffer, Pass pass)
+	{
+		size_t drawCount = perObjectDraws.size();
+
+		// Slots are handed out up front, so chunks don't depend on what the one before them bound.
+		// Static draws come first, so their slots only move when the static set does.
+		// The pre-pass, recorded first, has no use for them
+		int slot = 0;
+		auto assignSlots = [&](const std::vector<DrawItem>& draws, std::vector<uint32_t>& offsets)
+		{
+			offsets.resize(draws.size());
+			int boundTexture = -1;
+			uint32_t dynamicOffset = 0;
+			for (size_t n = 0; n < draws.size(); n++)
+			{
+				if (draws[n].texIndex != boundTexture)
+				{
+					boundTexture = draws[n].texIndex;
+					ObjectUniformData u_ObjData{ boundTexture };	// Contains texture index
+
+					dynamicOffset = engineDevice.properties.limits.minUniformBufferOffsetAlignment * ++slot;
+					if (dynamicOffset + sizeof(ObjectUniformData) > u_ObjBuffer.getBufferSize()) {
+					    // XOne grows the buffer with the scene, so this should never occur
+						// Remove this for any release builds
+						DEBUG("Object Uniform Buffer Exceeded.");
+						throw std::runtime_error("Attempting to write beyond the end of the object uniform buffer.");
+					}
+					u_ObjBuffer.writeToBuffer(&u_ObjData, sizeof(ObjectUniformData), dynamicOffset);
+				}
+				offsets[n] = dynamicOffset;
+			}
+		};
+		if (pass == PASS_SHADING)
+		{
+			assignSlots(staticDraws, staticOffsets);
+			assignSlots(perObjectDraws, perObjectOffsets);
+			if (slot > 0) u_ObjBuffer.flush();
+		}
+		const uint32_t* offsets = pass == PASS_SHADING ? perObjectOffsets.data() : nullptr;
+
+		GFXPipeline* pipeline = &pipelineFor(perObjectPipeline, pass);
+
+		if (subpassContents() == VK_SUBPASS_CONTENTS_INLINE)
+		{
+			BindCounts counts{};
+			recordPerObject(frame_content.commandBuffer, frame_content, *pipeline, perObjectDraws.data(), offsets, drawCount, counts);
+			data.pipelineBinds += counts.pipeline;
+			data.textureBinds += counts.texture;
+			data.meshBinds += counts.mesh;
+		}
+		else
+		{
+			size_t chunk = (drawCount + recordChunks - 1) / recordChunks;
+			std::pmr::vector<VkCommandBuffer> secondaries(recordChunks, VK_NULL_HANDLE, frame_content.frameArena);
+			std::pmr::vector<BindCounts> counts(recordChunks + 1, BindCounts{}, frame_content.frameArena);
+
+			auto recordChunk = [&](size_t t)
+			{
+				size_t begin = std::min(drawCount, t * chunk);
+				size_t end = std::min(drawCount, begin + chunk);
+
+				VkCommandBuffer commandBuffer = commandPools.beginSecondary(frame_content.frameIndex, static_cast<uint32_t>(t), passInheritance);
+				setPassViewport(commandBuffer);
+				recordPerObject(commandBuffer, frame_content, *pipeline, perObjectDraws.data() + begin, offsets ? offsets + begin : nullptr, end - begin, counts[t]);
+
+				if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to record secondary command buffer!");
+				}
+				secondaries[t] = commandBuffer;
+			};
+
+			if (drawCount > 0)
+			{
+				for (size_t t = 1; t < recordChunks; t++)
+				{
+					frame_content.workers->threads[t - 1]->addJob([&, t] { recordChunk(t); });
+				}
+				recordChunk(0);
+				frame_content.workers->wait();
+			}
+			else
+			{
+				secondaries.clear();
+			}
+
+			if (!staticDraws.empty())
+			{
+				secondaries.insert(secondaries.begin(), recordStatic(frame_content, data, *pipeline, u_ObjBuffer, pass, counts[recordChunks]));
+			}
+
+			vkCmdExecuteCommands(frame_content.commandBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+
+			for (const BindCounts& chunkCounts : counts)
+			{
+				data.pipelineBinds += chunkCounts.pipeline;
+				data.textureBinds += chunkCounts.texture;
+				data.meshBinds += chunkCounts.mesh;
+			}
 		}
 
+		data.recordThreads = static_cast<int>(recordChunks);
+		data.drawCalls = static_cast<int>(drawCount + staticDraws.size());
+		data.indirectCommands = 0;
+		updateData(drawCount + staticDraws.size(), frame_content.frameTime, data);
+	}
+
+	/*
+	* The static draws of this frame slot, recorded once into a secondary buffer that's replayed until
+	* something it depends on changes: the static set (and their transforms), the pipeline, the swap chain
+	* or the extent drawn to, the descriptor sets or uniform buffer it binds, or an invalidateStaticCache. Checking means hashing
+	* a few values per static object, far less than recording them.
+	* It isn't frustum culled, that would change it whenever the camera moves.
+	* The depth pre-pass keeps a buffer of its own, bound to no uniform offsets.
+	*/
+	VkCommandBuffer ObjectRenderSystem::recordStatic(FrameContent& frame_content, Data& data, GFXPipeline& pipeline, AvengBuffer& u_ObjBuffer, Pass pass, BindCounts& counts)
+	{
+		// FNV-1a
+		uint64_t signature = 14695981039346656037ull;
+		auto hash = [&signature](const void* bytes, size_t size)
+		{
+			for (size_t n = 0; n < size; n++)
+			{
+				signature = (signature ^ static_cast<const uint8_t*>(bytes)[n]) * 1099511628211ull;
+			}
+		};
+
+		VkBuffer uniformBuffer = u_ObjBuffer.getBuffer();
+		GFXPipeline* pipelinePointer = &pipeline;
+		hash(&staticEpoch, sizeof(staticEpoch));
+		hash(&passSwapChainId, sizeof(passSwapChainId));
+		hash(&passExtent, sizeof(passExtent));		// Baked into the viewport, and dynamic resolution changes it
+		hash(&pipelinePointer, sizeof(pipelinePointer));
+		hash(&frame_content.globalDescriptorSet, sizeof(VkDescriptorSet));
+		hash(&frame_content.objectDescriptorSet, sizeof(VkDescriptorSet));
+		hash(&uniformBuffer, sizeof(uniformBuffer));
+
+		const uint32_t* offsets = pass == PASS_SHADING ? staticOffsets.data() : nullptr;
+		for (size_t n = 0; n < staticDraws.size(); n++)
+		{
+			const DrawItem& item = staticDraws[n];
+			hash(&item.model, sizeof(item.model));
+			if (offsets) hash(&offsets[n], sizeof(uint32_t));
+			hash(&item.transform->_mat4(), sizeof(glm::mat4));		// World, so a parent moving counts too
+		}
+
+		StaticCache& cache = staticCaches[frame_content.frameIndex][pass];
+		if (cache.commandBuffer != VK_NULL_HANDLE && cache.signature == signature)
+		{
+			return cache.commandBuffer;
+		}
+
+		// No framebuffer, so it runs on whichever swap chain image the frame renders to
+		VkCommandBufferInheritanceInfo inheritance = passInheritance;
+		inheritance.framebuffer = VK_NULL_HANDLE;
+
+		VkCommandBuffer commandBuffer = commandPools.beginCached(frame_content.frameIndex, pass, inheritance);
+		setPassViewport(commandBuffer);
+		recordPerObject(commandBuffer, frame_content, pipeline, staticDraws.data(), offsets, staticDraws.size(), counts);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to record static command buffer!");
+		}
+
+		cache.commandBuffer = commandBuffer;
+		cache.signature = signature;
+		data.staticRecords++;
+		return commandBuffer;
+	}
+
+	// Secondary buffers don't inherit dynamic state from the primary
+	void ObjectRenderSystem::setPassViewport(VkCommandBuffer commandBuffer)
+	{
+		VkViewport viewport{ 0.0f, 0.0f, static_cast<float>(passExtent.width), static_cast<float>(passExtent.height), 0.0f, 1.0f };
+		VkRect2D scissor{ {0, 0}, passExtent };
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	}
+
+	// Draws count items and their uniform offsets. Safe to run on several threads at once, each into its own command buffer
+	void ObjectRenderSystem::recordPerObject(VkCommandBuffer commandBuffer, FrameContent& frame_content, GFXPipeline& pipeline, const DrawItem* draws, const uint32_t* offsets, size_t count, BindCounts& counts)
+	{
+		if (count == 0) return;
+
+		pipeline.bind(commandBuffer);
 		vkCmdBindDescriptorSets(
-			frame_content.commandBuffer,
+			commandBuffer,
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			pipelineLayout,
 			0,
@@ -116,57 +470,707 @@ namespace aveng {
 			&frame_content.globalDescriptorSet,
 			0,
 			nullptr);
+		counts.pipeline++;
 
-		updateData(frame_content.appObjects.size(), frame_content.frameTime, data);
+		uint32_t boundOffset = UINT32_MAX;
+		AvengModel* boundModel = nullptr;
 
-		/*
-		* Thread object bind/draw calls here
-		*/
-		int i = 0;
-		for (auto& kv : frame_content.appObjects)
+		for (size_t n = 0; n < count; n++)
 		{
-			i++;
-			ObjectUniformData u_ObjData{ kv.second.get_texture() };	// Contains texture index
-
-			// Push Constant Data
-			SimplePushConstantData push{};
-			push.modelMatrix  = kv.second.transform._mat4();
-			push.normalMatrix = kv.second.transform.normalMatrix();
-
-			uint32_t dynamicOffset = engineDevice.properties.limits.minUniformBufferOffsetAlignment * i;
-			if (dynamicOffset > engineDevice.properties.limits.maxUniformBufferRange) {
-			    //This will (should) never occur because we're taking measurments from the same source when instantiating the dynamic uniform buffer
-				// Remove this for any release builds
-				DEBUG("Max Uniform Buffer Range Exceeded.");
-				throw std::runtime_error("Attempting to allocate buffer beyond device uniform buffer memory limit.");
-			}
+			const DrawItem& item = draws[n];
 
 			// Bind the descriptor set for our pixel (fragment) shader
-			u_ObjBuffer.writeToBuffer(&u_ObjData, sizeof(ObjectUniformData), dynamicOffset);
-			u_ObjBuffer.flush();
+			if (offsets && offsets[n] != boundOffset)
+			{
+				boundOffset = offsets[n];
+				vkCmdBindDescriptorSets(
+					commandBuffer,
+					VK_PIPELINE_BIND_POINT_GRAPHICS,
+					pipelineLayout,
+					1,
+					1,
+					&frame_content.objectDescriptorSet,
+					1,
+					&boundOffset);
+				counts.texture++;
+			}
 
-			vkCmdBindDescriptorSets(
-				frame_content.commandBuffer,
-				VK_PIPELINE_BIND_POINT_GRAPHICS,
-				pipelineLayout,
-				1,
-				1,
-				&frame_content.objectDescriptorSet,
-				1,
-				&dynamicOffset);
+			// Push Constant Data
+			SimplePushConstantData push{};
+			push.modelMatrix  = item.transform->_mat4();
+			push.normalMatrix = item.transform->normalMatrix();
 
 			vkCmdPushConstants(
-				frame_content.commandBuffer,
+				commandBuffer,
 				pipelineLayout,
 				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
 				0,
 				sizeof(SimplePushConstantData),
 				&push);
 
-			kv.second.model->bind(frame_content.commandBuffer);
-			kv.second.model->draw(frame_content.commandBuffer);
+			if (item.model != boundModel)
+			{
+				boundModel = item.model;
+				boundModel->bind(commandBuffer);
+				counts.mesh++;
+			}
+			item.model->draw(commandBuffer);
+		}
+	}
+
+	/*
+	* A sort key per item, see RenderQueue. Depth is the clip space w of the item's bounds center,
+	* its distance along the view direction.
+	*/
+	void ObjectRenderSystem::sortDraws(FrameContent& frame_content, const std::pmr::vector<DrawItem>& items, uint32_t pipeline, RenderQueue& queue)
+	{
+		glm::mat4 projectionView = frame_content.camera.getProjection() * frame_content.camera.getView();
+		glm::vec4 depthRow{ projectionView[0][3], projectionView[1][3], projectionView[2][3], projectionView[3][3] };
+
+		queue.reserve(items.size());
+		for (size_t n = 0; n < items.size(); n++)
+		{
+			const DrawItem& item = items[n];
+			glm::vec4 center = item.transform->_mat4() * glm::vec4(item.model->getBounds().center, 1.f);
+			float depth = glm::dot(depthRow, center);
+
+			queue.push(RenderQueue::makeKey(pipeline, static_cast<uint32_t>(item.texIndex), item.model->getId(), depth), static_cast<uint32_t>(n));
+		}
+		queue.sort();
+	}
+
+	/*
+	* Every object with a mesh whose world space bounding sphere touches the camera's frustum.
+	* The spheres are gathered as a structure of arrays and tested 4 / 8 at a time,
+	* split across the worker threads once the scene is large enough.
+	*/
+	void ObjectRenderSystem::gatherVisible(FrameContent& frame_content, Data& data, std::pmr::vector<DrawItem>& items, bool cpuCulling, std::pmr::vector<DrawItem>* staticItems)
+	{
+		const bool frustumCulling = data.frustumCulling && cpuCulling;
+		auto view = frame_content.scene.view<TransformComponent, VisualComponent, ModelComponent>();
+
+		SphereBounds bounds{ frame_content.frameArena };
+		items.reserve(view.sizeHint());
+		if (frustumCulling) bounds.reserve(view.sizeHint());
+
+		view.each([&](Entity entity, TransformComponent& transform, VisualComponent& visual, ModelComponent& mesh)
+		{
+			DrawItem item{ mesh.model.get(), visual.tex_id, &transform, frame_content.scene.has<OccluderComponent>(entity) };
+
+			if (staticItems != nullptr && isStatic(frame_content.scene, entity))
+			{
+				staticItems->push_back(item);
+				return;
+			}
+			items.push_back(item);
+
+			if (frustumCulling)
+			{
+				const AvengModel::Bounds& local = mesh.model->getBounds();
+				glm::vec3 center = transform._mat4() * glm::vec4(local.center, 1.f);
+				glm::vec3 scale = glm::abs(transform.scale);
+				bounds.push(center, local.radius * glm::max(scale.x, glm::max(scale.y, scale.z)));
+			}
+		});
+
+		// What culling sees, the static items already set aside
+		size_t total = items.size();
+		if (frustumCulling && total > 0)
+		{
+			Frustum frustum = Frustum::fromMatrix(frame_content.camera.getProjection() * frame_content.camera.getView());
+
+			std::pmr::vector<uint8_t> visible(total, 0, frame_content.frameArena);
+			cullSpheresParallel(frustum, bounds, visible.data(), frame_content.workers);
+
+			// Compact in place, keeping scene order
+			size_t kept = 0;
+			for (size_t n = 0; n < total; n++)
+			{
+				if (visible[n]) items[kept++] = items[n];
+			}
+			items.resize(kept);
+		}
+
+		data.occludedObjects = 0;
+		if (data.softwareOcclusion && cpuCulling && !items.empty())
+		{
+			cullOccluded(frame_content, data, items);
+		}
+
+		// Static items skip culling and are always visible. Both counts come from everything gathered, so they add up to it
+		size_t staticCount = staticItems != nullptr ? staticItems->size() : 0;
+		size_t gathered = total + staticCount;
+		size_t visible = items.size() + staticCount;
+		data.visibleObjects = static_cast<int>(visible);
+		data.culledObjects = static_cast<int>(gathered - visible);
+	}
+
+	bool ObjectRenderSystem::isStatic(AvengRegistry& scene, Entity entity)
+	{
+		if (!scene.has<MetaComponent>(entity)) return false;
+
+		int type = scene.get<MetaComponent>(entity).type;
+		return type == STATIC || type == GROUND;
+	}
+
+	/*
+	* Software occlusion culling. Every OccluderComponent is rasterized into the low resolution
+	* OcclusionBuffer across the worker threads, then the world space box of each remaining
+	* object is tested against it. Occluders aren't tested, they would only hide behind themselves.
+	*/
+	void ObjectRenderSystem::cullOccluded(FrameContent& frame_content, Data& data, std::pmr::vector<DrawItem>& items)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		occlusionBuffer.begin(frame_content.camera.getProjection() * frame_content.camera.getView());
+		frame_content.scene.view<TransformComponent, OccluderComponent>().each(
+			[&](Entity entity, TransformComponent& transform, OccluderComponent& occluder)
+		{
+			occlusionBuffer.addOccluder(*occluder.mesh, transform._mat4());
+		});
+		occlusionBuffer.rasterize(frame_content.workers);
+
+		std::pmr::vector<glm::vec3> boxMin{ items.size(), frame_content.frameArena };
+		std::pmr::vector<glm::vec3> boxMax{ items.size(), frame_content.frameArena };
+		std::pmr::vector<uint8_t> visible(items.size(), 0, frame_content.frameArena);
+
+		// testBoxes skips entries already marked hidden, which is how occluders sit the test out
+		for (size_t n = 0; n < items.size(); n++)
+		{
+			if (items[n].occluder) continue;
+
+			// The object space box transformed and re-fitted around its rotated corners
+			const AvengModel::Bounds& local = items[n].model->getBounds();
+			glm::mat4 model = items[n].transform->_mat4();
+			glm::vec3 center = model * glm::vec4(local.center, 1.f);
+			glm::vec3 extents = glm::abs(glm::vec3(model[0])) * local.extents.x
+							  + glm::abs(glm::vec3(model[1])) * local.extents.y
+							  + glm::abs(glm::vec3(model[2])) * local.extents.z;
+			boxMin[n] = center - extents;
+			boxMax[n] = center + extents;
+			visible[n] = 1;
+		}
+
+		occlusionBuffer.testBoxes(boxMin.data(), boxMax.data(), visible.data(), items.size(), frame_content.workers);
 
+		size_t kept = 0;
+		for (size_t n = 0; n < items.size(); n++)
+		{
+			if (visible[n] || items[n].occluder) items[kept++] = items[n];
+		}
+		data.occludedObjects = static_cast<int>(items.size() - kept);
+		items.resize(kept);
+
+		data.occluderTriangles = static_cast<int>(occlusionBuffer.triangleCount());
+		data.softwareOcclusionMs = std::chrono::duration<float, std::chrono::milliseconds::period>(
+			std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	/*
+	* Pack the matrices of every visible object into this frame's instance buffer, sorted so objects
+	* sharing a mesh and a texture are contiguous, and return one group per contiguous run.
+	* Returns the number of objects packed. Without cpuCulling every object is packed unculled.
+	*/
+	size_t ObjectRenderSystem::buildDrawGroups(FrameContent& frame_content, Data& data, std::pmr::vector<DrawGroup>& groups, bool cpuCulling)
+	{
+		std::pmr::vector<DrawItem> items{ frame_content.frameArena };
+		gatherVisible(frame_content, data, items, cpuCulling);
+		return packDrawGroups(frame_content, items, groups);
+	}
+
+	size_t ObjectRenderSystem::packDrawGroups(FrameContent& frame_content, const std::pmr::vector<DrawItem>& items, std::pmr::vector<DrawGroup>& groups)
+	{
+		if (items.empty()) return 0;
+
+		// Instances within a group come out front to back as well
+		RenderQueue queue{ frame_content.frameArena };
+		sortDraws(frame_content, items, PIPELINE_INSTANCED, queue);
+
+		InstanceData* instances = static_cast<InstanceData*>(reserveHostBuffer(
+			instanceBuffers[frame_content.frameIndex], sizeof(InstanceData), items.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT));
+
+		const DrawItem* previous = nullptr;
+		for (size_t n = 0; n < queue.size(); n++)
+		{
+			const DrawItem& item = items[queue[n].index];
+			glm::mat3 normalMatrix = item.transform->normalMatrix();
+			instances[n].modelMatrix     = item.transform->_mat4();
+			instances[n].normalMatrix[0] = glm::vec4(normalMatrix[0], 0.f);
+			instances[n].normalMatrix[1] = glm::vec4(normalMatrix[1], 0.f);
+			instances[n].normalMatrix[2] = glm::vec4(normalMatrix[2], 0.f);
+			instances[n].texIndex        = static_cast<uint32_t>(item.texIndex);
+
+			// A texture change splits the group, the sampler index has to be uniform within a draw
+			if (previous == nullptr || item.model != previous->model || item.texIndex != previous->texIndex)
+				groups.push_back({ item.model, static_cast<uint32_t>(n), 0 });
+			groups.back().instanceCount++;
+			instances[n].drawGroup = static_cast<uint32_t>(groups.size() - 1);
+			previous = &item;
+		}
+		instanceBuffers[frame_content.frameIndex]->flush();
+
+		return items.size();
+	}
+
+	void ObjectRenderSystem::bindInstancedPipeline(FrameContent& frame_content, VkBuffer instanceBuffer, GFXPipeline& pipeline)
+	{
+		pipeline.bind(frame_content.commandBuffer);
+
+		vkCmdBindDescriptorSets(
+			frame_content.commandBuffer,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipelineLayout,
+			0,
+			1,
+			&frame_content.globalDescriptorSet,
+			0,
+			nullptr);
+
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(frame_content.commandBuffer, 1, 1, &instanceBuffer, &offset);
+	}
+
+	// directGroups, one vkCmdDrawIndexed each. The instanced pipeline is bound. Returns the draws recorded
+	int ObjectRenderSystem::drawDirectGroups(FrameContent& frame_content, Data& data)
+	{
+		AvengModel* boundModel = nullptr;
+		for (const DrawGroup& group : directGroups)
+		{
+			if (group.model != boundModel)
+			{
+				boundModel = group.model;
+				boundModel->bind(frame_content.commandBuffer);
+				data.meshBinds++;
+			}
+			boundModel->drawInstanced(frame_content.commandBuffer, group.instanceCount, group.firstInstance);
+		}
+		return static_cast<int>(directGroups.size());
+	}
+
+	void ObjectRenderSystem::prepareInstanced(FrameContent& frame_content, Data& data)
+	{
+		std::pmr::vector<DrawGroup> groups{ frame_content.frameArena };
+		preparedObjects = buildDrawGroups(frame_content, data, groups);
+		directGroups.assign(groups.begin(), groups.end());
+	}
+
+	/*
+	* Objects sharing a mesh and a texture are drawn with a single vkCmdDrawIndexed
+	* whose instances are that group's slice of the instance buffer.
+	*/
+	void ObjectRenderSystem::renderInstanced(FrameContent& frame_content, Data& data, Pass pass)
+	{
+		if (!directGroups.empty())
+		{
+			bindInstancedPipeline(frame_content, instanceBuffers[frame_content.frameIndex]->getBuffer(), pipelineFor(PIPELINE_INSTANCED, pass));
+			data.pipelineBinds++;
+			drawDirectGroups(frame_content, data);
+		}
+
+		data.drawCalls = static_cast<int>(directGroups.size());
+		data.indirectCommands = 0;
+		updateData(preparedObjects, frame_content.frameTime, data);
+	}
+
+	/*
+	* The instanced groups, written as VkDrawIndexedIndirectCommands instead of recorded one by one.
+	* Every mesh in the geometry arena shares the same vertex and index buffers, so all of their groups
+	* go out in a single vkCmdDrawIndexedIndirect (or one per maxDrawIndirectCount commands).
+	* When VK_KHR_draw_indirect_count is present the draw count is read from a buffer as well,
+	* which is where a GPU culling pass writes it. Each draw finds its per instance data through
+	* gl_InstanceIndex, which includes the command's firstInstance.
+	* Meshes outside the arena are drawn the instanced way.
+	*/
+	void ObjectRenderSystem::prepareIndirect(FrameContent& frame_content, Data& data)
+	{
+		std::pmr::vector<DrawGroup> groups{ frame_content.frameArena };
+		preparedObjects = buildDrawGroups(frame_content, data, groups);
+		if (groups.empty()) return;
+
+		VkDrawIndexedIndirectCommand* commands = static_cast<VkDrawIndexedIndirectCommand*>(reserveHostBuffer(
+			indirectBuffers[frame_content.frameIndex], sizeof(VkDrawIndexedIndirectCommand), groups.size(), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT));
+
+		// Arena groups become commands, the rest are drawn directly
+		for (const DrawGroup& group : groups)
+		{
+			if (!group.model->isInArena())
+			{
+				directGroups.push_back(group);
+				continue;
+			}
+
+			// One arena per scene
+			assert((indirectArena == nullptr || indirectArena == group.model->getArena()) && "Indirect draws span more than one geometry arena");
+			indirectArena = group.model->getArena();
+			commands[indirectCommandCount++] = group.model->indirectCommand(group.instanceCount, group.firstInstance);
+		}
+		if (indirectCommandCount == 0) return;
+
+		indirectBuffers[frame_content.frameIndex]->flush();
+		if (engineDevice.cmdDrawIndexedIndirectCount != nullptr)
+		{
+			uint32_t* count = static_cast<uint32_t*>(reserveHostBuffer(
+				countBuffers[frame_content.frameIndex], sizeof(uint32_t), 1, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT));
+			*count = indirectCommandCount;
+			countBuffers[frame_content.frameIndex]->flush();
+		}
+	}
+
+	void ObjectRenderSystem::renderIndirect(FrameContent& frame_content, Data& data, Pass pass)
+	{
+		int drawCalls = 0;
+
+		if (!directGroups.empty() || indirectCommandCount > 0)
+		{
+			bindInstancedPipeline(frame_content, instanceBuffers[frame_content.frameIndex]->getBuffer(), pipelineFor(PIPELINE_INSTANCED, pass));
+			data.pipelineBinds++;
+			drawCalls += drawDirectGroups(frame_content, data);
+		}
+
+		if (indirectCommandCount > 0)
+		{
+			indirectArena->bind(frame_content.commandBuffer);
+			data.meshBinds++;
+
+			VkBuffer indirectBuffer = indirectBuffers[frame_content.frameIndex]->getBuffer();
+			const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+			if (engineDevice.cmdDrawIndexedIndirectCount != nullptr)
+			{
+				engineDevice.cmdDrawIndexedIndirectCount(
+					frame_content.commandBuffer,
+					indirectBuffer, 0,
+					countBuffers[frame_content.frameIndex]->getBuffer(), 0,
+					indirectCommandCount, stride);
+				drawCalls++;
+			}
+			else
+			{
+				// Without multiDrawIndirect the device takes one command per call
+				uint32_t maxPerCall = engineDevice.enabledFeatures.multiDrawIndirect
+					? engineDevice.properties.limits.maxDrawIndirectCount : 1;
+
+				for (uint32_t first = 0; first < indirectCommandCount; first += maxPerCall)
+				{
+					uint32_t count = std::min(maxPerCall, indirectCommandCount - first);
+					vkCmdDrawIndexedIndirect(frame_content.commandBuffer, indirectBuffer, first * stride, count, stride);
+					drawCalls++;
+				}
+			}
+		}
+
+		data.drawCalls = drawCalls;
+		data.indirectCommands = static_cast<int>(indirectCommandCount);
+		updateData(preparedObjects, frame_content.frameTime, data);
+	}
+
+	/*
+	* Work that has to be recorded before the render pass begins, and the draws every path records,
+	* gathered once so the depth pre-pass and the object pass record the same.
+	*/
+	void ObjectRenderSystem::prepare(FrameContent& frame_content, Data& data, const SwapChain::DepthTarget& depth, const VkCommandBufferInheritanceInfo& inheritance)
+	{
+		gpuArena = nullptr;
+		indirectArena = nullptr;
+		indirectCommandCount = 0;
+		directGroups.clear();
+		preparedObjects = 0;
+		preparedGroups = 0;
+		perObjectDraws.clear();
+		staticDraws.clear();
+		recordChunks = 1;
+		data.staticObjects = 0;
+		data.recordThreads = 1;
+
+		// Counted across every pass the frame records
+		data.pipelineBinds = 0;
+		data.textureBinds = 0;
+		data.meshBinds = 0;
+
+		// This slot's fence has been waited on, its secondary buffers are free again
+		commandPools.beginFrame(frame_content.frameIndex);
+		passInheritance = inheritance;
+		passExtent = depth.extent;
+		passSwapChainId = depth.swapChainId;
+
+		// Without drawIndirectFirstInstance every command would have to start at instance 0, so those paths fall back to instancing
+		preparedMode = data.drawMode;
+		if (preparedMode != DRAW_PER_OBJECT && preparedMode != DRAW_INSTANCED && !engineDevice.enabledFeatures.drawIndirectFirstInstance)
+			preparedMode = DRAW_INSTANCED;
+
+		// Selected in the GUI. simple_shader2 places its vertices its own way, so depth laid down by the pre-pass wouldn't match it
+		perObjectPipeline = data.cur_pipe == 99 ? PIPELINE_SIMPLE_2 : PIPELINE_SIMPLE;
+		depthPrepass = data.depthPrepass && !(preparedMode == DRAW_PER_OBJECT && perObjectPipeline == PIPELINE_SIMPLE_2);
+
+		switch (preparedMode)
+		{
+			case DRAW_PER_OBJECT: preparePerObject(frame_content, data); break;
+			case DRAW_INSTANCED:  prepareInstanced(frame_content, data); break;
+			case DRAW_GPU_CULLED: prepareGpuCulled(frame_content, data, depth); break;
+			default:
+				prepareIndirect(frame_content, data);
+		}
+	}
+
+	/*
+	* DRAW_GPU_CULLED. The arena objects are culled straight out of residentInstances, with one
+	* GpuDrawGroup per resident group, and GpuCullingSystem records the culling pass that turns them
+	* into this frame's indirect draws. Anything outside the arena is packed unculled the instanced way.
+	*/
+	void ObjectRenderSystem::prepareGpuCulled(FrameContent& frame_content, Data& data, const SwapChain::DepthTarget& depth)
+	{
+		std::pmr::vector<DrawItem> outside{ frame_content.frameArena };
+		syncResident(frame_content, outside);
+		residentInstances.upload(frame_content.commandBuffer, frame_content.frameIndex);
+
+		std::pmr::vector<DrawGroup> groups{ frame_content.frameArena };
+		packDrawGroups(frame_content, outside, groups);
+		directGroups.assign(groups.begin(), groups.end());
+		preparedObjects = residentCount + outside.size();
+
+		// Each group's survivors are written from its firstInstance on, with room for all of its instances
+		std::pmr::vector<GpuCullingSystem::GpuDrawGroup> gpuGroups{ frame_content.frameArena };
+		gpuGroups.reserve(residentGroups.size());
+
+		uint32_t firstInstance = 0;
+		for (const ResidentGroup& group : residentGroups)
+		{
+			// An empty group is only waiting to be reused, and its mesh may be gone
+			GpuCullingSystem::GpuDrawGroup gpuGroup{};
+			if (group.instanceCount > 0)
+			{
+				assert((gpuArena == nullptr || gpuArena == group.model->getArena()) && "Indirect draws span more than one geometry arena");
+				gpuArena = group.model->getArena();
+
+				const AvengModel::Bounds& bounds = group.model->getBounds();
+				VkDrawIndexedIndirectCommand command = group.model->indirectCommand(0, firstInstance);
+				gpuGroup.sphere = glm::vec4(bounds.center, bounds.radius);
+				gpuGroup.indexCount = command.indexCount;
+				gpuGroup.firstIndex = command.firstIndex;
+				gpuGroup.vertexOffset = command.vertexOffset;
+				gpuGroup.firstInstance = command.firstInstance;
+			}
+			gpuGroups.push_back(gpuGroup);
+
+			firstInstance += group.instanceCount;
+		}
+		preparedGroups = static_cast<uint32_t>(gpuGroups.size() + directGroups.size());
+
+		glm::mat4 projView = frame_content.camera.getProjection() * frame_content.camera.getView();
+		Frustum frustum = Frustum::fromMatrix(projView);
+		GpuCullingSystem::Occlusion occlusion{ data.occlusionCulling && depth.sampleable, projView, depth.extent };
+
+		gpuCulling.cull(
+			frame_content.commandBuffer,
+			frame_content.frameIndex,
+			data.frustumCulling ? &frustum : nullptr,
+			occlusion,
+			residentInstances.buffer(),
+			residentCount > 0 ? residentInstances.slotCount() : 0,
+			gpuGroups.data(),
+			static_cast<uint32_t>(gpuGroups.size()),
+			frame_content.frameArena);
+
+		// Read back from this frame slot's previous submission, so these lag by MAX_FRAMES_IN_FLIGHT frames
+		uint32_t visibleInstances = gpuCulling.lastVisibleCount(frame_content.frameIndex);
+		data.visibleObjects = static_cast<int>(visibleInstances + outside.size());
+		data.culledObjects = static_cast<int>(residentCount > visibleInstances ? residentCount - visibleInstances : 0);
+		data.occludedObjects = 0;
+		data.lateObjects = static_cast<int>(gpuCulling.lastLateCount(frame_content.frameIndex));
+	}
+
+	/*
+	* Bring residentInstances up to date with the scene. Each entity is only compared against what
+	* was last uploaded for it: new ones take a slot, and those whose matrices, mesh or texture
+	* changed are staged again. Slots whose entity wasn't found are released.
+	*/
+	void ObjectRenderSystem::syncResident(FrameContent& frame_content, std::pmr::vector<DrawItem>& outside)
+	{
+		AvengRegistry& scene = frame_content.scene;
+		uint64_t sync = ++residentSync;
+		uint32_t found = 0;
+
+		scene.view<TransformComponent, VisualComponent, ModelComponent>().each(
+			[&](Entity entity, TransformComponent& transform, VisualComponent& visual, ModelComponent& mesh)
+		{
+			AvengModel* model = mesh.model.get();
+			if (!model->isInArena())
+			{
+				outside.push_back({ model, visual.tex_id, &transform, scene.has<OccluderComponent>(entity) });
+				return;
+			}
+
+			uint32_t index = entity.index();
+			if (index >= residentSlots.size()) residentSlots.resize(index + 1, GpuInstanceStore::NO_SLOT);
+
+			// The index may have been handed to a new entity since the slot was taken
+			uint32_t slot = residentSlots[index];
+			if (slot != GpuInstanceStore::NO_SLOT && residents[slot].entity != entity)
+			{
+				releaseResident(slot);
+				slot = GpuInstanceStore::NO_SLOT;
+			}
+
+			bool changed = transform.matricesStale();
+			if (slot == GpuInstanceStore::NO_SLOT)
+			{
+				slot = residentInstances.acquire();
+				if (slot >= residents.size()) residents.resize(slot + 1);
+				residents[slot] = ResidentInstance{ entity };
+				residentSlots[index] = slot;
+				residentCount++;
+				changed = true;
+			}
+
+			ResidentInstance& resident = residents[slot];
+			resident.seen = sync;
+			found++;
+
+			if (resident.model != model || resident.texIndex != visual.tex_id)
+			{
+				if (resident.group != NO_GROUP) residentGroups[resident.group].instanceCount--;
+				resident.model = model;
+				resident.texIndex = visual.tex_id;
+				resident.group = residentGroup(model, visual.tex_id);
+				residentGroups[resident.group].instanceCount++;
+				changed = true;
+			}
+
+			if (!changed && transform.matrices.version == resident.version) return;
+
+			glm::mat4 modelMatrix = transform._mat4();
+			glm::mat3 normalMatrix = transform.normalMatrix();
+			resident.version = transform.matrices.version;
+
+			InstanceData* instance = static_cast<InstanceData*>(residentInstances.write(slot));
+			instance->modelMatrix     = modelMatrix;
+			instance->normalMatrix[0] = glm::vec4(normalMatrix[0], 0.f);
+			instance->normalMatrix[1] = glm::vec4(normalMatrix[1], 0.f);
+			instance->normalMatrix[2] = glm::vec4(normalMatrix[2], 0.f);
+			instance->texIndex        = static_cast<uint32_t>(visual.tex_id);
+			instance->drawGroup       = resident.group;
+		});
+
+		// Only walk the slots when something resident has gone: destroyed, lost its mesh, or left the arena
+		if (found == residentCount) return;
+
+		for (uint32_t slot = 0; slot < residents.size(); slot++)
+		{
+			if (residents[slot].model != nullptr && residents[slot].seen != sync) releaseResident(slot);
+		}
+	}
+
+	void ObjectRenderSystem::releaseResident(uint32_t slot)
+	{
+		ResidentInstance& resident = residents[slot];
+		if (resident.group != NO_GROUP) residentGroups[resident.group].instanceCount--;
+
+		// The slot stays in the range cull.comp goes over, this makes it skip it
+		InstanceData* instance = static_cast<InstanceData*>(residentInstances.write(slot));
+		*instance = InstanceData{};
+		instance->drawGroup = NO_GROUP;
+
+		if (residentSlots[resident.entity.index()] == slot) residentSlots[resident.entity.index()] = GpuInstanceStore::NO_SLOT;
+		resident = ResidentInstance{};
+		residentInstances.release(slot);
+		residentCount--;
+	}
+
+	// The group of instances sharing this mesh and texture. A new pairing takes over an empty group before adding one
+	uint32_t ObjectRenderSystem::residentGroup(AvengModel* model, int texIndex)
+	{
+		uint32_t empty = NO_GROUP;
+		for (uint32_t group = 0; group < residentGroups.size(); group++)
+		{
+			const ResidentGroup& candidate = residentGroups[group];
+			if (candidate.instanceCount == 0 && empty == NO_GROUP) empty = group;
+			if (candidate.instanceCount > 0 && candidate.model == model && candidate.texIndex == texIndex) return group;
+		}
+
+		if (empty != NO_GROUP)
+		{
+			residentGroups[empty] = { model, texIndex, 0 };
+			return empty;
+		}
+		residentGroups.push_back({ model, texIndex, 0 });
+		return static_cast<uint32_t>(residentGroups.size() - 1);
+	}
+
+	bool ObjectRenderSystem::hasLatePass(const FrameContent& frame_content) const
+	{
+		return gpuArena != nullptr && gpuCulling.hasLatePhase(frame_content.frameIndex);
+	}
+
+	void ObjectRenderSystem::prepareLate(FrameContent& frame_content, const SwapChain::DepthTarget& depth)
+	{
+		gpuCulling.cullLate(frame_content.commandBuffer, frame_content.frameIndex, depth, frame_content.frameArena);
+	}
+
+	// What the early phase thought hidden and the late phase found in view. Always drawn after renderGpuCulled
+	void ObjectRenderSystem::renderLate(FrameContent& frame_content, Data& data)
+	{
+		auto draw = [&](Pass pass)
+		{
+			bindInstancedPipeline(frame_content, gpuCulling.visibleInstances(frame_content.frameIndex), pipelineFor(PIPELINE_INSTANCED, pass));
+			gpuArena->bind(frame_content.commandBuffer);
+			data.pipelineBinds++;
+			data.meshBinds++;
+			data.drawCalls += gpuCulling.draw(frame_content.commandBuffer, frame_content.frameIndex, GpuCullingSystem::LATE_PHASE);
+		};
+
+		// None of these were in the pre-pass, their depth goes down first here
+		if (depthPrepass) draw(PASS_DEPTH);
+		draw(PASS_SHADING);
+	}
+
+	/*
+	* Draws what prepare left behind: the arena groups straight from the culling pass's output,
+	* then anything outside the arena the instanced way from the unculled instance buffer.
+	*/
+	void ObjectRenderSystem::renderGpuCulled(FrameContent& frame_content, Data& data, Pass pass)
+	{
+		int drawCalls = 0;
+
+		if (gpuArena != nullptr)
+		{
+			bindInstancedPipeline(frame_content, gpuCulling.visibleInstances(frame_content.frameIndex), pipelineFor(PIPELINE_INSTANCED, pass));
+			gpuArena->bind(frame_content.commandBuffer);
+			data.pipelineBinds++;
+			data.meshBinds++;
+			drawCalls += gpuCulling.draw(frame_content.commandBuffer, frame_content.frameIndex);
+		}
+
+		if (!directGroups.empty())
+		{
+			bindInstancedPipeline(frame_content, instanceBuffers[frame_content.frameIndex]->getBuffer(), pipelineFor(PIPELINE_INSTANCED, pass));
+			data.pipelineBinds++;
+			drawCalls += drawDirectGroups(frame_content, data);
+		}
+
+		data.drawCalls = drawCalls;
+		data.indirectCommands = static_cast<int>(preparedGroups - directGroups.size());
+		updateData(preparedObjects, frame_content.frameTime, data);
+	}
+
+	/*
+	* Mapped space for count elements in one of this frame's host visible buffers. The buffer this
+	* frame slot used last is no longer read by the GPU, and a replaced buffer is retired through
+	* the deletion queue.
+	*/
+	void* ObjectRenderSystem::reserveHostBuffer(std::unique_ptr<AvengBuffer>& buffer, VkDeviceSize elementSize, size_t count, VkBufferUsageFlags usage)
+	{
+		if (!buffer || buffer->getInstanceCount() < count)
+		{
+			size_t capacity = std::max<size_t>(count, buffer ? buffer->getInstanceCount() * 2 : 1024);
+			buffer = std::make_unique<AvengBuffer>(
+				engineDevice,
+				elementSize,
+				static_cast<uint32_t>(capacity),
+				usage,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			buffer->map();
 		}
+		return buffer->getMappedMemory();
 	}
 
 	void ObjectRenderSystem::updateData(size_t size, float frameTime, Data& data)
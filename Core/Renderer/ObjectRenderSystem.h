@@ -5,10 +5,19 @@
 #include "../Peripheral/KeyboardController.h"
 #include "../../CoreVK/EngineDevice.h"
 #include "../../CoreVK/GFXPipeline.h"
+#include "../../CoreVK/aveng_buffer.h"
+#include "../../CoreVK/aveng_command_pools.h"
+#include "GpuCullingSystem.h"
+#include "GpuInstanceStore.h"
+#include "RenderQueue.h"
+#include "../Math/aveng_occlusion.h"
 #include "../data.h"
 
 #include "../../avpch.h"
 
+#include <array>
+#include <memory_resource>
+
 namespace aveng {
 
 	class ObjectRenderSystem {
@@ -20,20 +29,135 @@ namespace aveng {
 			alignas(16) int texIndex;
 		};
 
+		// Per instance vertex attributes, bound at binding 1 by the instanced pipeline
+		struct InstanceData {
+			glm::mat4 modelMatrix{ 1.f };
+			glm::vec4 normalMatrix[3]{};	// mat3 columns, padded to vec4
+			uint32_t texIndex = 0;
+			uint32_t drawGroup = 0;			// Read by cull.comp
+			uint32_t padding[2]{};
+		};
+		static_assert(sizeof(InstanceData) == 128, "InstanceData must match Instance in cull.comp");
+
 		ObjectRenderSystem(EngineDevice& device, AvengAppObject& viewer);
 		~ObjectRenderSystem();
 
 		ObjectRenderSystem(const ObjectRenderSystem&) = delete;
-		void initialize(VkRenderPass renderPass, VkDescriptorSetLayout globalDescriptorSetLayout, VkDescriptorSetLayout fragDescriptorSetLayouts);
+		// With gBuffer the pipelines write DeferredRenderer's G-buffer instead of shading, renderPass being its geometry pass
+		void initialize(VkRenderPass renderPass, VkDescriptorSetLayout globalDescriptorSetLayout, VkDescriptorSetLayout fragDescriptorSetLayouts, bool gBuffer = false);
 		ObjectRenderSystem& operator=(const ObjectRenderSystem&) = delete;
 		void render(FrameContent& frame_content, Data& data, AvengBuffer& fragBuffer);
+
+		// Per object draws recorded on several threads need at least this many each
+		static constexpr size_t MIN_DRAWS_PER_CHUNK = 256;
+
+		/*
+		* Work that has to be done before the render pass begins, i.e. GPU culling and gathering the draws.
+		* inheritance describes the render pass render will be recorded in.
+		*/
+		void prepare(FrameContent& frame_content, Data& data, const SwapChain::DepthTarget& depth, const VkCommandBufferInheritanceInfo& inheritance);
+
+		/*
+		* Data::depthPrepass. The draws render records are recorded first by renderDepthPrepass, positions only
+		* and writing nothing but depth, and render's pipelines then test EQUAL against that depth without
+		* writing it, so each pixel is shaded once however much overdraw there is.
+		* When hasDepthPrepass, the caller records renderDepthPrepass in a render pass instance of its own,
+		* begun like render's, then begins render's loading the depth instead of clearing it.
+		*/
+		bool hasDepthPrepass() const { return depthPrepass; }
+		void renderDepthPrepass(FrameContent& frame_content, Data& data, AvengBuffer& fragBuffer);
+
+		// How the render pass has to be begun for render. Secondary when the per object draws are recorded in parallel or cached
+		VkSubpassContents subpassContents() const
+		{
+			return recordChunks > 1 || !staticDraws.empty() ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+		}
+
+		// Re-record the cached static draws, for changes they can't detect themselves (e.g. descriptors rewritten in place)
+		void invalidateStaticCache() { staticEpoch++; }
+
+		/*
+		* Occlusion culling's second phase. When hasLatePass, the caller ends the render pass after render,
+		* records prepareLate, resumes the render pass and records renderLate. Behind the depth pre-pass,
+		* renderLate lays down the depth of its draws itself before shading them.
+		*/
+		bool hasLatePass(const FrameContent& frame_content) const;
+		void prepareLate(FrameContent& frame_content, const SwapChain::DepthTarget& depth);
+		void renderLate(FrameContent& frame_content, Data& data);
 		VkPipelineLayout getPipelineLayout() { return pipelineLayout; }
 
 	private:
 
 		void createPipelineLayout(VkDescriptorSetLayout* descriptorSetLayouts);
 		void updateData(size_t size, float frameTime, Data& data);
-		void createPipeline(VkRenderPass renderPass);
+		void createPipeline(VkRenderPass renderPass, bool gBuffer);
+		void preparePerObject(FrameContent& frame_content, Data& data);
+		void prepareInstanced(FrameContent& frame_content, Data& data);
+		void prepareIndirect(FrameContent& frame_content, Data& data);
+		void prepareGpuCulled(FrameContent& frame_content, Data& data, const SwapChain::DepthTarget& depth);
+
+		// What a recording is for: the depth pre-pass, or shading
+		enum Pass : uint32_t {
+			PASS_SHADING = 0,
+			PASS_DEPTH
+		};
+
+		void recordPass(FrameContent& frame_content, Data& data, AvengBuffer& u_ObjBuffer, Pass pass);
+		void renderPerObject(FrameContent& frame_content, Data& data, AvengBuffer& u_ObjBuffer, Pass pass);
+		void renderInstanced(FrameContent& frame_content, Data& data, Pass pass);
+		void renderIndirect(FrameContent& frame_content, Data& data, Pass pass);
+		void renderGpuCulled(FrameContent& frame_content, Data& data, Pass pass);
+
+		// An object that passed culling this frame
+		struct DrawItem {
+			AvengModel* model;
+			int texIndex;
+			TransformComponent* transform;
+			bool occluder;
+		};
+
+		// A run of the instance buffer sharing one mesh and one texture
+		struct DrawGroup {
+			AvengModel* model;
+			uint32_t firstInstance;
+			uint32_t instanceCount;
+		};
+
+		// The pipeline field of a RenderQueue key
+		enum PipelineId : uint32_t {
+			PIPELINE_SIMPLE = 0,
+			PIPELINE_SIMPLE_2,
+			PIPELINE_INSTANCED
+		};
+
+		void sortDraws(FrameContent& frame_content, const std::pmr::vector<DrawItem>& items, uint32_t pipeline, RenderQueue& queue);
+		// With staticItems, objects that never move are set aside there unculled, see isStatic
+		void gatherVisible(FrameContent& frame_content, Data& data, std::pmr::vector<DrawItem>& items, bool cpuCulling = true, std::pmr::vector<DrawItem>* staticItems = nullptr);
+		static bool isStatic(AvengRegistry& scene, Entity entity);		// MetaComponent STATIC or GROUND
+		void cullOccluded(FrameContent& frame_content, Data& data, std::pmr::vector<DrawItem>& items);
+		size_t buildDrawGroups(FrameContent& frame_content, Data& data, std::pmr::vector<DrawGroup>& groups, bool cpuCulling = true);
+		size_t packDrawGroups(FrameContent& frame_content, const std::pmr::vector<DrawItem>& items, std::pmr::vector<DrawGroup>& groups);
+
+		// DRAW_GPU_CULLED's resident instances. Objects whose mesh is outside the geometry arena are left in outside
+		void syncResident(FrameContent& frame_content, std::pmr::vector<DrawItem>& outside);
+		void releaseResident(uint32_t slot);
+		uint32_t residentGroup(AvengModel* model, int texIndex);
+		struct BindCounts {
+			int pipeline = 0;
+			int texture = 0;
+			int mesh = 0;
+		};
+
+		// The pipeline drawing id's draws in pass
+		GFXPipeline& pipelineFor(uint32_t id, Pass pass);
+
+		// Without offsets nothing is bound at set 1, for the depth pre-pass
+		void recordPerObject(VkCommandBuffer commandBuffer, FrameContent& frame_content, GFXPipeline& pipeline, const DrawItem* draws, const uint32_t* offsets, size_t count, BindCounts& counts);
+		VkCommandBuffer recordStatic(FrameContent& frame_content, Data& data, GFXPipeline& pipeline, AvengBuffer& u_ObjBuffer, Pass pass, BindCounts& counts);
+		void setPassViewport(VkCommandBuffer commandBuffer);
+		void bindInstancedPipeline(FrameContent& frame_content, VkBuffer instanceBuffer, GFXPipeline& pipeline);
+		int drawDirectGroups(FrameContent& frame_content, Data& data);
+		void* reserveHostBuffer(std::unique_ptr<AvengBuffer>& buffer, VkDeviceSize elementSize, size_t count, VkBufferUsageFlags usage);
 
 		int last_sec;
 		EngineDevice &engineDevice;
@@ -44,8 +168,87 @@ namespace aveng {
 		// Rendering Pipelines - Heap Allocated
 		std::unique_ptr<GFXPipeline> gfxPipeline;
 		std::unique_ptr<GFXPipeline> gfxPipeline2;
+		std::unique_ptr<GFXPipeline> instancedPipeline;
 		VkPipelineLayout pipelineLayout;
 
+		// The depth pre-pass's, and gfxPipeline and instancedPipeline testing EQUAL behind it
+		std::unique_ptr<GFXPipeline> depthPipeline;
+		std::unique_ptr<GFXPipeline> depthInstancedPipeline;
+		std::unique_ptr<GFXPipeline> gfxPipelineEqual;
+		std::unique_ptr<GFXPipeline> instancedPipelineEqual;
+
+		// Host visible, one per frame in flight. Grown on demand, never shrunk
+		std::vector<std::unique_ptr<AvengBuffer>> instanceBuffers;
+		std::vector<std::unique_ptr<AvengBuffer>> indirectBuffers;
+		std::vector<std::unique_ptr<AvengBuffer>> countBuffers;
+
+		// Carried from prepare to render, so render only records and may record twice
+		int preparedMode = DRAW_INDIRECT;		// data.drawMode, after falling back for missing features
+		bool depthPrepass = false;
+		size_t preparedObjects = 0;
+		std::vector<DrawGroup> directGroups;		// Drawn the instanced way. DRAW_INDIRECT and DRAW_GPU_CULLED, the meshes outside the arena
+
+		// DRAW_INDIRECT
+		AvengGeometryArena* indirectArena = nullptr;
+		uint32_t indirectCommandCount = 0;
+
+		// DRAW_GPU_CULLED
+		GpuCullingSystem gpuCulling{ engineDevice };
+		AvengGeometryArena* gpuArena = nullptr;
+		uint32_t preparedGroups = 0;
+
+		/*
+		* Every arena object's InstanceData stays in residentInstances between frames, one slot per entity,
+		* and only what was added, moved, re-textured or removed since the last frame is uploaded.
+		* drawGroup indexes residentGroups, whose empty entries are reused, and a released slot holds NO_GROUP.
+		*/
+		static constexpr uint32_t NO_GROUP = UINT32_MAX;
+
+		struct ResidentInstance {
+			Entity entity{};
+			AvengModel* model = nullptr;	// nullptr while the slot is free
+			int texIndex = 0;
+			uint32_t version = 0;			// Of the matrices last uploaded
+			uint32_t group = NO_GROUP;
+			uint64_t seen = 0;				// The last syncResident that found the entity
+		};
+
+		struct ResidentGroup {
+			AvengModel* model;
+			int texIndex;
+			uint32_t instanceCount;
+		};
+
+		GpuInstanceStore residentInstances{ engineDevice, sizeof(InstanceData) };
+		std::vector<ResidentInstance> residents;		// By slot
+		std::vector<uint32_t> residentSlots;			// By entity index, GpuInstanceStore::NO_SLOT when not resident
+		std::vector<ResidentGroup> residentGroups;
+		uint32_t residentCount = 0;
+		uint64_t residentSync = 0;
+
+		// DRAW_PER_OBJECT, carried from prepare to render
+		AvengCommandPools commandPools{ engineDevice };
+		std::vector<DrawItem> perObjectDraws;			// Sort key order
+		std::vector<uint32_t> perObjectOffsets;			// Dynamic uniform offset of each draw's texture
+		uint32_t perObjectPipeline = PIPELINE_SIMPLE;
+		size_t recordChunks = 1;
+		VkCommandBufferInheritanceInfo passInheritance{};
+		VkExtent2D passExtent{};
+		uint64_t passSwapChainId = 0;
+
+		// Static per object draws, replayed from one secondary buffer per frame in flight and pass, see recordStatic
+		struct StaticCache {
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			uint64_t signature = 0;
+		};
+		std::vector<DrawItem> staticDraws;
+		std::vector<uint32_t> staticOffsets;
+		std::vector<std::array<StaticCache, 2>> staticCaches;
+		uint64_t staticEpoch = 0;
+
+		// Data::softwareOcclusion, the CPU paths' occlusion culling
+		OcclusionBuffer occlusionBuffer;
+
 	};
 
 }
\ No newline at end of file
@@ -1,13 +1,17 @@
 #include "PointLightSystem.h"
 #include "../Math/aveng_math.h"
+#include "../Math/aveng_culling.h"
 #include "../Events/window_callbacks.h"
 #include "../Player/GameplayFunctions.h"
+#include "../../CoreVK/swapchain.h"
 
 #define exe GameplayFunctions
 
 #define LOG(x, y) std::cout << x << "\t" << y << std::endl
 #define BYPASS_FBO 0
 
+#include <algorithm>
+
 namespace aveng {
 
 	PointLightSystem::PointLightSystem(EngineDevice& device) : engineDevice{ device } 
@@ -18,6 +22,8 @@ namespace aveng {
 		VkDescriptorSetLayout descriptorSetLayouts[1] = { globalDescriptorSetLayouts };
 		createPipelineLayout(descriptorSetLayouts);
 		createPipeline(renderPass);
+
+		billboardBuffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
 	}
 
 	PointLightSystem::~PointLightSystem()
@@ -67,6 +73,20 @@ namespace aveng {
 		GFXPipeline::defaultPipelineConfig(pipelineConfig);
 		pipelineConfig.attributeDescriptions.clear();
 		pipelineConfig.bindingDescriptions.clear();
+
+		// One Billboard per instance, the quad's corners come from gl_VertexIndex
+		pipelineConfig.bindingDescriptions.push_back({ 0, sizeof(Billboard), VK_VERTEX_INPUT_RATE_INSTANCE });
+		pipelineConfig.attributeDescriptions.push_back({ 0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(Billboard, position)) });
+		pipelineConfig.attributeDescriptions.push_back({ 1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(Billboard, color)) });
+
+		// Soft edges blended over the scene, tested against its depth but not written to it
+		pipelineConfig.colorBlendAttachment.blendEnable = VK_TRUE;
+		pipelineConfig.colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		pipelineConfig.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		pipelineConfig.colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		pipelineConfig.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+
 		pipelineConfig.renderPass = renderPass;
 		pipelineConfig.pipelineLayout = pipelineLayout;
 
@@ -87,8 +107,72 @@ namespace aveng {
 		//	);
 	}
 
-	void PointLightSystem::render(FrameContent& frame_content)
+	void PointLightSystem::render(FrameContent& frame_content, Data& data, const glm::vec3& keyLightPosition, const glm::vec4& keyLightColor)
 	{
+		std::pmr::memory_resource* arena = frame_content.frameArena;
+		ComponentPool<PointLightComponent>& pointLights = frame_content.scene.pool<PointLightComponent>();
+		ComponentPool<TransformComponent>& transforms = frame_content.scene.pool<TransformComponent>();
+
+		// The UBO's light, then the scene's
+		std::pmr::vector<Billboard> billboards{ arena };
+		billboards.reserve(pointLights.size() + 1);
+		billboards.push_back({ glm::vec4(keyLightPosition, KEY_LIGHT_RADIUS), keyLightColor });
+		for (size_t n = 0; n < pointLights.size(); n++)
+		{
+			Entity entity = pointLights.owners()[n];
+			if (!transforms.has(entity)) continue;
+
+			const PointLightComponent& light = pointLights.data()[n];
+			const glm::mat4& world = transforms.get(entity)._mat4();
+			billboards.push_back({ glm::vec4(glm::vec3(world[3]), light.billboardRadius), glm::vec4(light.color, light.intensity) });
+		}
+
+		// A billboard always faces the camera, so a sphere of its radius bounds it
+		SphereBounds bounds{ arena };
+		bounds.reserve(billboards.size());
+		for (const Billboard& billboard : billboards) bounds.push(glm::vec3(billboard.position), billboard.position.w);
+
+		const AvengCamera& camera = frame_content.camera;
+		std::pmr::vector<uint8_t> visible(billboards.size(), 0, arena);
+		cullSpheresParallel(Frustum::fromMatrix(camera.getProjection() * camera.getView()), bounds, visible.data(), frame_content.workers);
+
+		// Farthest first, by view depth
+		struct SortKey {
+			float depth;
+			uint32_t index;
+		};
+		std::pmr::vector<SortKey> order{ arena };
+		order.reserve(billboards.size());
+		const glm::mat4& view = camera.getView();
+		for (uint32_t n = 0; n < billboards.size(); n++)
+		{
+			if (!visible[n]) continue;
+			const glm::vec4& position = billboards[n].position;
+			order.push_back({ view[0][2] * position.x + view[1][2] * position.y + view[2][2] * position.z + view[3][2], n });
+		}
+		std::sort(order.begin(), order.end(), [](const SortKey& a, const SortKey& b) { return a.depth > b.depth; });
+
+		data.lightBillboards = static_cast<int>(order.size());
+		data.culledBillboards = static_cast<int>(billboards.size() - order.size());
+		if (order.empty()) return;
+
+		// This frame slot's last submission has retired, so its buffer can be rewritten or replaced
+		std::unique_ptr<AvengBuffer>& buffer = billboardBuffers[frame_content.frameIndex];
+		if (!buffer || buffer->getInstanceCount() < order.size())
+		{
+			size_t capacity = std::max<size_t>(order.size(), buffer ? buffer->getInstanceCount() * 2 : 256);
+			buffer = std::make_unique<AvengBuffer>(
+				engineDevice,
+				sizeof(Billboard),
+				static_cast<uint32_t>(capacity),
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			buffer->map();
+		}
+
+		Billboard* instances = static_cast<Billboard*>(buffer->getMappedMemory());
+		for (size_t n = 0; n < order.size(); n++) instances[n] = billboards[order[n].index];
+		buffer->flush();
 
 		gfxPipeline->bind(frame_content.commandBuffer); // 0
 	
@@ -102,7 +186,11 @@ namespace aveng {
 			0,
 			nullptr);
 
-		vkCmdDraw(frame_content.commandBuffer, 6, 1, 0, 0);
+		VkBuffer instanceBuffer = buffer->getBuffer();
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(frame_content.commandBuffer, 0, 1, &instanceBuffer, &offset);
+
+		vkCmdDraw(frame_content.commandBuffer, 6, static_cast<uint32_t>(order.size()), 0, 0);
 
 	}
 
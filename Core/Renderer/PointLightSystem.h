@@ -7,12 +7,19 @@
 #include "../Peripheral/KeyboardController.h"
 #include "../../CoreVK/EngineDevice.h"
 #include "../../CoreVK/GFXPipeline.h"
+#include "../../CoreVK/aveng_buffer.h"
 #include "../data.h"
 
 #include "../../avpch.h"
 
 namespace aveng {
 
+	/*
+	* @class PointLightSystem
+	* Draws a billboard for the UBO's light and every PointLightComponent in the scene, all in one
+	* instanced draw. Each frame the lights are frustum culled, sorted back to front so their soft
+	* edges blend correctly, and written to a per frame instance buffer, one Billboard each.
+	*/
 	class PointLightSystem {
 
 	public:
@@ -21,12 +28,21 @@ namespace aveng {
 			alignas(sizeof(int)) int imDex;
 		};
 
+		// Mirrors the per instance inputs of point_light.vert
+		struct Billboard {
+			glm::vec4 position;		// World space, w is the billboard's radius
+			glm::vec4 color;		// w is intensity
+		};
+
+		// Billboard radius of the UBO's light
+		static constexpr float KEY_LIGHT_RADIUS = 0.561f;
+
 		PointLightSystem(EngineDevice& device);
 		~PointLightSystem();
 		void initialize(VkRenderPass renderPass, VkDescriptorSetLayout globalDescriptorSetLayout);
 		PointLightSystem(const PointLightSystem&) = delete;
 		PointLightSystem& operator=(const PointLightSystem&) = delete;
-		void render(FrameContent& frame_content);
+		void render(FrameContent& frame_content, Data& data, const glm::vec3& keyLightPosition, const glm::vec4& keyLightColor);
 		VkPipelineLayout getPipelineLayout() { return pipelineLayout; }
 
 	private:
@@ -43,6 +59,8 @@ namespace aveng {
 		std::unique_ptr<GFXPipeline> gfxPipeline2;
 		VkPipelineLayout pipelineLayout;
 
+		std::vector<std::unique_ptr<AvengBuffer>> billboardBuffers;	// Per frame in flight, grown as needed
+
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace aveng {
+
+	uint64_t RenderQueue::makeKey(uint32_t pipeline, uint32_t texture, uint32_t mesh, float depth)
+	{
+		// A positive float's bits order the same way as its value, the top 24 keep the exponent and most of the mantissa
+		uint32_t depthBits = 0;
+		if (depth > 0.f)
+		{
+			std::memcpy(&depthBits, &depth, sizeof(float));
+			depthBits >>= 32 - DEPTH_BITS;
+		}
+
+		return uint64_t(pipeline & ((1u << PIPELINE_BITS) - 1)) << (TEXTURE_BITS + MESH_BITS + DEPTH_BITS)
+			 | uint64_t(texture & ((1u << TEXTURE_BITS) - 1)) << (MESH_BITS + DEPTH_BITS)
+			 | uint64_t(mesh & ((1u << MESH_BITS) - 1)) << DEPTH_BITS
+			 | uint64_t(depthBits);
+	}
+
+	void RenderQueue::sort()
+	{
+		size_t count = entries.size();
+		if (count < 2) return;
+
+		// Every pass's histogram in one read of the keys
+		uint32_t histograms[8][256] = {};
+		for (const Entry& entry : entries)
+		{
+			for (int pass = 0; pass < 8; pass++)
+			{
+				histograms[pass][(entry.key >> (pass * 8)) & 0xFF]++;
+			}
+		}
+
+		scratch.resize(count);
+		Entry* source = entries.data();
+		Entry* destination = scratch.data();
+
+		for (int pass = 0; pass < 8; pass++)
+		{
+			uint32_t* histogram = histograms[pass];
+			int shift = pass * 8;
+
+			// Nothing to do when every key shares this byte
+			if (histogram[(source[0].key >> shift) & 0xFF] == count) continue;
+
+			uint32_t offset = 0;
+			for (int bucket = 0; bucket < 256; bucket++)
+			{
+				uint32_t bucketCount = histogram[bucket];
+				histogram[bucket] = offset;
+				offset += bucketCount;
+			}
+
+			for (size_t n = 0; n < count; n++)
+			{
+				destination[histogram[(source[n].key >> shift) & 0xFF]++] = source[n];
+			}
+			std::swap(source, destination);
+		}
+
+		if (source != entries.data())
+		{
+			std::copy(source, source + count, entries.data());
+		}
+	}
+
+}
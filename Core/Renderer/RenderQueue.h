@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace aveng {
+
+	/*
+	* @class RenderQueue
+	* The draws of a pass, each reduced to a 64 bit sort key and the index of the draw it stands for.
+	* From the most significant bits down a key holds
+	*
+	*	pipeline (4) | texture (16) | mesh (20) | depth (24)
+	*
+	* so sorting by key groups draws by the state they need, most expensive change first, and orders
+	* every run of identical state front to back to give early depth testing the most to reject.
+	* Keys are radix sorted, 8 bits per pass, and passes where every key has the same byte are skipped.
+	*/
+	class RenderQueue {
+
+	public:
+
+		struct Entry {
+			uint64_t key;
+			uint32_t index;		// Into the caller's list of draws
+		};
+
+		static constexpr uint32_t PIPELINE_BITS = 4;
+		static constexpr uint32_t TEXTURE_BITS = 16;
+		static constexpr uint32_t MESH_BITS = 20;
+		static constexpr uint32_t DEPTH_BITS = 24;
+		static_assert(PIPELINE_BITS + TEXTURE_BITS + MESH_BITS + DEPTH_BITS == 64, "Sort key fields must fill 64 bits");
+
+		/*
+		* depth is the view space distance to the draw, larger is farther. Only positive depths are
+		* ordered, anything at or behind the camera sorts first. Ids wider than their field wrap, which
+		* only costs an extra state change.
+		*/
+		static uint64_t makeKey(uint32_t pipeline, uint32_t texture, uint32_t mesh, float depth);
+
+		static uint32_t pipelineOf(uint64_t key)	{ return static_cast<uint32_t>(key >> (TEXTURE_BITS + MESH_BITS + DEPTH_BITS)); }
+		static uint32_t textureOf(uint64_t key)		{ return static_cast<uint32_t>(key >> (MESH_BITS + DEPTH_BITS)) & ((1u << TEXTURE_BITS) - 1); }
+		static uint32_t meshOf(uint64_t key)		{ return static_cast<uint32_t>(key >> DEPTH_BITS) & ((1u << MESH_BITS) - 1); }
+
+		explicit RenderQueue(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: entries{ resource }, scratch{ resource } {}
+
+		void reserve(size_t count) { entries.reserve(count); }
+		void push(uint64_t key, uint32_t index) { entries.push_back({ key, index }); }
+
+		// Stable, so draws with equal keys keep the order they were pushed in
+		void sort();
+
+		size_t size() const { return entries.size(); }
+		bool empty() const { return entries.empty(); }
+		const Entry& operator[](size_t n) const { return entries[n]; }
+		std::pmr::vector<Entry>::const_iterator begin() const { return entries.begin(); }
+		std::pmr::vector<Entry>::const_iterator end() const { return entries.end(); }
+
+	private:
+
+		std::pmr::vector<Entry> entries;
+		std::pmr::vector<Entry> scratch;
+
+	};
+
+}
@@ -41,6 +41,9 @@ namespace aveng {
 
 		// Wait until the current swap chain isn't being used before we attempt to construct the next one.
 		vkDeviceWaitIdle(engineDevice.device());
+
+		// Nothing is in flight anymore, so everything waiting on a frame to retire can go now
+		engineDevice.deletionQueue().flush();
 	
 		aveng_swapchain = nullptr;
 
@@ -120,6 +123,9 @@ namespace aveng {
 
 		isFrameStarted = true;
 
+		// acquireNextImage waited on this frame slot's fence, releasing whatever the last frame to use it held on to
+		engineDevice.deletionQueue().collect();
+
 		auto commandBuffer = getCurrentCommandBuffer();
 
 		VkCommandBufferBeginInfo beginInfo{};
@@ -145,6 +151,7 @@ namespace aveng {
 		}
 		// Submit to graphics queue while handling cpu and gpu sync, executing the command buffers
 		auto result = aveng_swapchain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+		engineDevice.deletionQueue().frameSubmitted();
 
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || aveng_window.wasWindowResized())
 		{
@@ -167,7 +174,17 @@ namespace aveng {
 	}
 
 
-	void  Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
+	void  Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
+	{
+		beginRenderPass(commandBuffer, aveng_swapchain->getRenderPass(), true, contents);
+	}
+
+	void  Renderer::resumeSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
+	{
+		beginRenderPass(commandBuffer, aveng_swapchain->getLoadRenderPass(), false, contents);
+	}
+
+	void  Renderer::beginRenderPass(VkCommandBuffer commandBuffer, VkRenderPass renderPass, bool clear, VkSubpassContents contents)
 	{
 	
 		assert(isFrameStarted && "Can't call beginSwapChain if frame is not in progress.");
@@ -183,7 +200,7 @@ namespace aveng {
 		// 1. Begin a render pass
 		VkRenderPassBeginInfo renderPassInfo{};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = aveng_swapchain->getRenderPass();
+		renderPassInfo.renderPass = renderPass;
 		renderPassInfo.framebuffer = aveng_swapchain->getFrameBuffer(currentImageIndex);
 
 		// The area where shader loading and storing takes place.
@@ -193,15 +210,18 @@ namespace aveng {
 		std::array<VkClearValue, 2> clearValues{};
 		clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
 		clearValues[1].depthStencil = { 1.0f, 0 };
-		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues = clearValues.data();
+		renderPassInfo.clearValueCount = clear ? static_cast<uint32_t>(clearValues.size()) : 0;
+		renderPassInfo.pClearValues = clear ? clearValues.data() : nullptr;
 
 		// 2. Submit to command buffers to begin the render pass
 
 		// VK_SUBPASS_CONTENTS_INLINE signals that subsequent renderpass commands come directly from the primary command buffer.
-		// No secondary buffers are currently being utilized.
-		// For this reason we cannot Mix both Inline command buffers AND secondary command buffers in our render pass execution.
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		// With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS they all come from secondary buffers instead.
+		// We cannot Mix both Inline command buffers AND secondary command buffers in one subpass.
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+
+		// Secondary buffers don't inherit dynamic state, they set their own
+		if (contents != VK_SUBPASS_CONTENTS_INLINE) return;
 
 		// Configure the viewport and scissor
 		VkViewport viewport{};
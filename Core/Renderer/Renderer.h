@@ -47,14 +47,40 @@ namespace aveng {
 		uint32_t getImageCount() const { return aveng_swapchain->imageCount(); }
 		VkImage& getImage(int index) { return aveng_swapchain->getImage(index); }
 		VkFormat getSwapChainImageFormat() { return aveng_swapchain->getSwapChainImageFormat(); }
+		VkExtent2D getSwapChainExtent() const { return aveng_swapchain->getSwapChainExtent(); }
+
+		SwapChain::DepthTarget getDepthTarget() const
+		{
+			assert(isFrameStarted && "Cannot get the depth target when frame is not in progress.");
+			return aveng_swapchain->getDepthTarget(currentImageIndex);
+		}
 
 		VkCommandBuffer beginFrame();
 		void endFrame();
-		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		// With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS the pass may only vkCmdExecuteCommands until it ends
+		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 		void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+		// Begin the swap chain render pass again after ending it mid frame, keeping what was drawn so far
+		void resumeSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+
+		// What a secondary command buffer executed in this frame's swap chain render pass inherits
+		VkCommandBufferInheritanceInfo getRenderPassInheritance() const
+		{
+			assert(isFrameStarted && "Cannot get the render pass inheritance when frame is not in progress.");
+
+			VkCommandBufferInheritanceInfo inheritance{};
+			inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+			inheritance.renderPass = aveng_swapchain->getRenderPass();
+			inheritance.subpass = 0;
+			inheritance.framebuffer = aveng_swapchain->getFrameBuffer(currentImageIndex);
+			return inheritance;
+		}
+
 	private:
 
+		void beginRenderPass(VkCommandBuffer commandBuffer, VkRenderPass renderPass, bool clear, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+
 		VkResult err;
 
 		void createCommandBuffers();
@@ -2,24 +2,80 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/quaternion.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "aveng_slot_map.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
 
 namespace aveng {
 
+	class AvengModel;
+	struct OccluderMesh;
+
 	// All kinds of matrix
 	struct TransformComponent
 	{
 		glm::vec3 translation = { 0.0f, 0.0f, 0.0f };
-		glm::vec3 rotation = { 0.0f, 0.0f, 0.0f };
+		glm::quat orientation = { 1.0f, 0.0f, 0.0f, 0.0f };	// Unit length, w first
 		glm::vec3 scale = { 1.f, 1.f, 1.f };
 		float modPI = 3.14159;
 
-		// Matrix corresponds to Translate * Ry * Rx * Rz * Scale
-		// Rotations correspond to Tait-Bryan angles of Y(1), X(2), Z(3)
-		// https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
-		glm::mat4 _mat4();
-		glm::mat3 normalMatrix();
+		/*
+		* Euler view of orientation, for code that thinks in angles (KeyboardController, GameplayFunctions).
+		* Tait-Bryan angles of Y(1), X(2), Z(3), see quatFromEulerYXZ. Each call converts, so keep the
+		* result around rather than reading it per component.
+		*/
+		glm::vec3 getRotation() const;
+		void setRotation(const glm::vec3& angles);
+
+		// Apply delta after the current orientation, in world space
+		void rotate(const glm::quat& delta) { orientation = glm::normalize(delta * orientation); }
+
+		// Between two simulation states, t in [0, 1]. The matrix cache is left to rebuild on first use
+		static TransformComponent interpolate(const TransformComponent& from, const TransformComponent& to, float t);
+
+		// Matrix corresponds to Translate * R * Scale, R from orientation without any trig
+		// https://en.wikipedia.org/wiki/Quaternions_and_spatial_rotation#Quaternion-derived_rotation_matrix
+		// Both are cached, see MatrixCache. Not safe to call on the same component from two threads at once
+		// With a ParentComponent these are the world matrices, see AvengTransformHierarchy
+		const glm::mat4& _mat4();
+		const glm::mat3& normalMatrix();
+
+		// Uncached, for const callers
+		glm::mat4 GetTransform() const;
+
+		/*
+		* The matrices as of the last rebuild and the translation, orientation and scale they were built from.
+		* The fields above are written directly all over, so instead of a dirty flag a rebuild happens when
+		* they no longer match.
+		*/
+		struct MatrixCache {
+			glm::vec3 translation{ 0.f };
+			glm::quat orientation{ 0.f, 0.f, 0.f, 0.f };	// Never a valid orientation, so the first call builds
+			glm::vec3 scale{ 0.f };
+			glm::mat4 model{ 1.f };
+			glm::mat3 normal{ 1.f };
+			uint32_t version = 0;			// Bumped by every store, so a copy of the matrices can tell it's out of date
+		};
+		MatrixCache matrices{};
+
+		bool matricesStale() const
+		{
+			return translation != matrices.translation || orientation != matrices.orientation || scale != matrices.scale;
+		}
+
+		// Install matrices built elsewhere for the current fields, see refreshTransforms
+		void storeMatrices(const glm::mat4& model, const glm::mat3& normal);
+
+		// The next _mat4 / normalMatrix rebuilds whatever is cached
+		void invalidateMatrices() { matrices.scale = glm::vec3{ 0.f }; }
+
+		// Rebuilds across every TransformComponent since the last call
+		static uint32_t takeRebuildCount() { return rebuilds.exchange(0, std::memory_order_relaxed); }
+		static void countRebuilds(uint32_t count) { rebuilds.fetch_add(count, std::memory_order_relaxed); }
 
 		glm::vec3 deltas = { 0.0f, 0.0f, 0.0f };
 		glm::vec3 velocity = { 0.0f, 0.0f, 0.0f };
@@ -29,14 +85,11 @@ namespace aveng {
 		TransformComponent(const glm::vec3& _translation)
 			: translation(_translation) {}
 
-		glm::mat4 GetTransform() const
-		{
-			glm::mat4 rotation = glm::toMat4(glm::quat(rotation));
+	private:
 
-			return glm::translate(glm::mat4(1.0f), translation)
-				* rotation
-				* glm::scale(glm::mat4(1.0f), scale);
-		}
+		void rebuildMatrices();
+
+		static inline std::atomic<uint32_t> rebuilds{ 0 };
 
 	};
 
@@ -62,4 +115,27 @@ namespace aveng {
 		float density;
 	};
 
+	// Shared, so any number of entities can draw the same mesh
+	struct ModelComponent {
+		std::shared_ptr<AvengModel> model;
+	};
+
+	// Makes an entity's TransformComponent relative to parent, see AvengTransformHierarchy
+	struct ParentComponent {
+		SlotHandle parent;
+	};
+
+	// Lights everything within radius of the entity's world position, see ClusteredLighting
+	struct PointLightComponent {
+		glm::vec3 color{ 1.f, 1.f, 1.f };
+		float intensity = 1.f;
+		float radius = 4.f;
+		float billboardRadius = .15f;	// Size of the sprite PointLightSystem draws for it
+	};
+
+	// Marks an entity as hiding what's behind it from the CPU occlusion pass, see OcclusionBuffer
+	struct OccluderComponent {
+		std::shared_ptr<const OccluderMesh> mesh;
+	};
+
 }
\ No newline at end of file
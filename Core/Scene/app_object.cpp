@@ -1,65 +1,85 @@
 #include "app_object.h"
+#include "../Math/aveng_math.h"
+#include "../Math/aveng_transform_batch.h"
 
 namespace aveng {
 
-    glm::mat4 TransformComponent::_mat4() 
+    Entity spawnAppObject(AvengRegistry& scene, AvengAppObject&& object)
     {
-        const float c3 = glm::cos(rotation.z);
-        const float s3 = glm::sin(rotation.z);
-        const float c2 = glm::cos(rotation.x);
-        const float s2 = glm::sin(rotation.x);
-        const float c1 = glm::cos(rotation.y);
-        const float s1 = glm::sin(rotation.y);
-        return glm::mat4{
-            {
-                scale.x * (c1 * c3 + s1 * s2 * s3),
-                scale.x * (c2 * s3),
-                scale.x * (c1 * s2 * s3 - c3 * s1),
-                0.0f,
-            },
-            {
-                scale.y * (c3 * s1 * s2 - c1 * s3),
-                scale.y * (c2 * c3),
-                scale.y * (c1 * c3 * s2 + s1 * s3),
-                0.0f,
-            },
-            {
-                scale.z * (c2 * s1),
-                scale.z * (-s2),
-                scale.z * (c1 * c2),
-                0.0f,
-            },
-            {translation.x, translation.y, translation.z, 1.0f} };
+        Entity entity = scene.create();
+
+        VisualComponent visual = object.visual;
+        visual.tex_id = object.get_texture();
+
+        scene.add<TransformComponent>(entity, object.transform);
+        scene.add<VisualComponent>(entity, visual);
+        scene.add<MetaComponent>(entity, object.meta);
+        if (object.model) {
+            scene.add<ModelComponent>(entity, { std::move(object.model) });
+        }
+        if (object.occluder) {
+            scene.add<OccluderComponent>(entity, { std::move(object.occluder) });
+        }
+
+        return entity;
+    }
+
+    glm::vec3 TransformComponent::getRotation() const
+    {
+        return eulerYXZFromQuat(orientation);
+    }
+
+    void TransformComponent::setRotation(const glm::vec3& angles)
+    {
+        orientation = quatFromEulerYXZ(angles);
+    }
+
+    TransformComponent TransformComponent::interpolate(const TransformComponent& from, const TransformComponent& to, float t)
+    {
+        TransformComponent result = to;
+        result.translation = glm::mix(from.translation, to.translation, t);
+        result.orientation = quatSlerp(from.orientation, to.orientation, t);
+        result.scale = glm::mix(from.scale, to.scale, t);
+        return result;
     }
 
-    glm::mat3 TransformComponent::normalMatrix() 
+    const glm::mat4& TransformComponent::_mat4()
     {
-        const float c3 = glm::cos(rotation.z);
-        const float s3 = glm::sin(rotation.z);
-        const float c2 = glm::cos(rotation.x);
-        const float s2 = glm::sin(rotation.x);
-        const float c1 = glm::cos(rotation.y);
-        const float s1 = glm::sin(rotation.y);
-        const glm::vec3 invScale = 1.0f / scale;
+        if (matricesStale()) rebuildMatrices();
+        return matrices.model;
+    }
 
-        return glm::mat3{
-            {
-                invScale.x * (c1 * c3 + s1 * s2 * s3),
-                invScale.x * (c2 * s3),
-                invScale.x * (c1 * s2 * s3 - c3 * s1),
-            },
-            {
-                invScale.y * (c3 * s1 * s2 - c1 * s3),
-                invScale.y * (c2 * c3),
-                invScale.y * (c1 * c3 * s2 + s1 * s3),
-            },
-            {
-                invScale.z * (c2 * s1),
-                invScale.z * (-s2),
-                invScale.z * (c1 * c2),
-            },
-        };
+    const glm::mat3& TransformComponent::normalMatrix()
+    {
+        if (matricesStale()) rebuildMatrices();
+        return matrices.normal;
+    }
 
+    glm::mat4 TransformComponent::GetTransform() const
+    {
+        glm::mat4 model;
+        glm::mat3 normal;
+        buildTransform(translation, orientation, scale, model, normal);
+        return model;
+    }
+
+    void TransformComponent::storeMatrices(const glm::mat4& model, const glm::mat3& normal)
+    {
+        matrices.model = model;
+        matrices.normal = normal;
+        matrices.translation = translation;
+        matrices.orientation = orientation;
+        matrices.scale = scale;
+        matrices.version++;
+    }
+
+    void TransformComponent::rebuildMatrices()
+    {
+        glm::mat4 model;
+        glm::mat3 normal;
+        buildTransform(translation, orientation, scale, model, normal);
+        storeMatrices(model, normal);
+        countRebuilds(1);
     }
 
 } 
\ No newline at end of file
@@ -2,9 +2,10 @@
 
 #include "../aveng_model.h"
 #include "AvengComponent.h"
+#include "aveng_registry.h"
+#include <atomic>
 #include <iostream>
 #include <memory>
-#include <unordered_map>
 
 namespace aveng {
 
@@ -13,12 +14,12 @@ namespace aveng {
 
 	public:
 		using id_t = unsigned int;
-		using Map = std::unordered_map<id_t, AvengAppObject>;
 
+		// Safe to call from worker threads
 		static AvengAppObject createAppObject(int texture_id)
 		{
-			static id_t currentId = 0;
-			return AvengAppObject{ currentId++, texture_id };
+			static std::atomic<id_t> currentId{ 0 };
+			return AvengAppObject{ currentId.fetch_add(1, std::memory_order_relaxed), texture_id };
 		}
 
 		AvengAppObject(id_t objId, int texture_id) : id{ objId }, texture_id{ texture_id } {}
@@ -29,6 +30,7 @@ namespace aveng {
 
 		const id_t getId() { return id; }
 		std::unique_ptr<AvengModel> model{};
+		std::shared_ptr<const OccluderMesh> occluder{};
 
 		inline int get_texture() { return texture_id; }
 		inline void set_texture(int texture) { texture_id = texture; }
@@ -45,4 +47,10 @@ namespace aveng {
 		id_t id;
 		
 	};
+
+	/*
+	* Move an object's components into the scene's packed storage. AvengAppObject stays the
+	* convenient way to author an object; once spawned the registry is the only copy.
+	*/
+	Entity spawnAppObject(AvengRegistry& scene, AvengAppObject&& object);
 }
\ No newline at end of file
@@ -0,0 +1,235 @@
+#pragma once
+
+#include "aveng_slot_map.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace aveng {
+
+	using Entity = SlotHandle;
+
+	// A small dense id per component type, handed out on first use
+	inline uint32_t nextComponentTypeId()
+	{
+		static std::atomic<uint32_t> next{ 0 };
+		return next.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	template <typename T>
+	uint32_t componentTypeId()
+	{
+		static const uint32_t id = nextComponentTypeId();
+		return id;
+	}
+
+	class ComponentPoolBase {
+	public:
+		virtual ~ComponentPoolBase() = default;
+		virtual void remove(Entity entity) = 0;
+		virtual bool has(Entity entity) const = 0;
+		virtual size_t size() const = 0;
+	};
+
+	/*
+	* @class ComponentPool
+	* Sparse set holding every component of one type in a single packed array.
+	* sparse maps an entity's slot index to its position in components / entities,
+	* which are kept parallel and gap free (removal swaps the last element in).
+	*
+	* This is structure of arrays at the component level: each type is its own array, so a system
+	* reading transforms touches nothing but transforms. Fields within a component stay together,
+	* since every system so far reads whole components. A SIMD kernel that wants single fields
+	* gathers them itself (TransformBatch, see refreshTransforms). Splitting TransformComponent
+	* field by field here would cost those systems one stream per field for no gain.
+	*/
+	template <typename T>
+	class ComponentPool : public ComponentPoolBase {
+
+		static constexpr uint32_t NONE = UINT32_MAX;
+
+	public:
+
+		T& emplace(Entity entity, T&& component)
+		{
+			assert(!has(entity) && "Entity already has this component");
+
+			uint32_t index = entity.index();
+			if (index >= sparse.size()) sparse.resize(index + 1, NONE);
+
+			sparse[index] = static_cast<uint32_t>(components.size());
+			entities.push_back(entity);
+			components.push_back(std::move(component));
+			return components.back();
+		}
+
+		void remove(Entity entity) override
+		{
+			if (!has(entity)) return;
+
+			uint32_t hole = sparse[entity.index()];
+			uint32_t last = static_cast<uint32_t>(components.size()) - 1;
+			if (hole != last)
+			{
+				components[hole] = std::move(components[last]);
+				entities[hole] = entities[last];
+				sparse[entities[hole].index()] = hole;
+			}
+			components.pop_back();
+			entities.pop_back();
+			sparse[entity.index()] = NONE;
+		}
+
+		bool has(Entity entity) const override
+		{
+			uint32_t index = entity.index();
+			return index < sparse.size() && sparse[index] != NONE && entities[sparse[index]] == entity;
+		}
+
+		T& get(Entity entity)
+		{
+			assert(has(entity) && "Entity does not have this component");
+			return components[sparse[entity.index()]];
+		}
+
+		size_t size() const override			{ return components.size(); }
+		T* data()								{ return components.data(); }
+		const std::vector<Entity>& owners() const	{ return entities; }
+
+	private:
+
+		std::vector<uint32_t> sparse;
+		std::vector<Entity> entities;		// Owner of components[i]
+		std::vector<T> components;
+
+	};
+
+	/*
+	* Every entity that has all of Ts. Iteration is driven by the smallest pool,
+	* so a rare component keeps a query over common ones cheap.
+	* Adding or removing components of these types while iterating is not allowed.
+	*/
+	template <typename... Ts>
+	class AvengView {
+	public:
+
+		explicit AvengView(ComponentPool<Ts>&... componentPools) : pools{ &componentPools... } {}
+
+		// fn(Entity, Ts&...)
+		template <typename Fn>
+		void each(Fn&& fn)
+		{
+			for (Entity entity : driver())
+			{
+				if ((std::get<ComponentPool<Ts>*>(pools)->has(entity) && ...))
+				{
+					fn(entity, std::get<ComponentPool<Ts>*>(pools)->get(entity)...);
+				}
+			}
+		}
+
+		// Upper bound on the number of matches
+		size_t sizeHint() const { return driver().size(); }
+
+	private:
+
+		const std::vector<Entity>& driver() const
+		{
+			const std::vector<Entity>* smallest = nullptr;
+			((smallest == nullptr || std::get<ComponentPool<Ts>*>(pools)->size() < smallest->size()
+				? (smallest = &std::get<ComponentPool<Ts>*>(pools)->owners(), 0) : 0), ...);
+			return *smallest;
+		}
+
+		std::tuple<ComponentPool<Ts>*...> pools;
+
+	};
+
+	/*
+	* @class AvengRegistry
+	* Owns the scene's entities and their components. Each component type lives in its own
+	* packed array, so a system touching only transforms streams through transforms and nothing else.
+	* Entities come from a SlotMap, which makes their handles generational and lets worker
+	* threads reserve() new ones without locking.
+	*/
+	class AvengRegistry {
+	public:
+
+		using ComponentMask = uint64_t;		// Bit per componentTypeId
+
+		AvengRegistry() = default;
+		AvengRegistry(const AvengRegistry&) = delete;
+		AvengRegistry& operator=(const AvengRegistry&) = delete;
+
+		Entity create()						{ return entities.insert(0); }
+		Entity reserve()					{ return entities.reserve(); }		// Any thread, see SlotMap::reserve
+		void create(Entity reserved)		{ entities.insert(reserved, 0); }
+
+		void destroy(Entity entity)
+		{
+			ComponentMask* mask = entities.get(entity);
+			if (mask == nullptr) return;
+
+			for (uint32_t type = 0; type < pools.size(); type++)
+			{
+				if (*mask & (ComponentMask{ 1 } << type)) pools[type]->remove(entity);
+			}
+			entities.erase(entity);
+		}
+
+		bool valid(Entity entity) const { return entities.contains(entity); }
+		size_t size() const { return entities.size(); }
+
+		template <typename T>
+		T& add(Entity entity, T component = {})
+		{
+			assert(valid(entity) && "Adding a component to a dead entity");
+			entities[entity] |= ComponentMask{ 1 } << componentTypeId<T>();
+			return pool<T>().emplace(entity, std::move(component));
+		}
+
+		template <typename T>
+		void remove(Entity entity)
+		{
+			if (!valid(entity)) return;
+			entities[entity] &= ~(ComponentMask{ 1 } << componentTypeId<T>());
+			pool<T>().remove(entity);
+		}
+
+		template <typename T>
+		bool has(Entity entity) const
+		{
+			const ComponentMask* mask = entities.get(entity);
+			return mask != nullptr && (*mask & (ComponentMask{ 1 } << componentTypeId<T>()));
+		}
+
+		template <typename T>
+		T& get(Entity entity) { return pool<T>().get(entity); }
+
+		template <typename... Ts>
+		AvengView<Ts...> view() { return AvengView<Ts...>{ pool<Ts>()... }; }
+
+		// Direct access to the packed array of one component type
+		template <typename T>
+		ComponentPool<T>& pool()
+		{
+			uint32_t type = componentTypeId<T>();
+			assert(type < 64 && "ComponentMask holds 64 component types");
+
+			if (type >= pools.size()) pools.resize(type + 1);
+			if (!pools[type]) pools[type] = std::make_unique<ComponentPool<T>>();
+			return static_cast<ComponentPool<T>&>(*pools[type]);
+		}
+
+	private:
+
+		SlotMap<ComponentMask> entities;
+		std::vector<std::unique_ptr<ComponentPoolBase>> pools;		// Indexed by componentTypeId
+
+	};
+
+}
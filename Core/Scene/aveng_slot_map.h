@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace aveng {
+
+	/*
+	* 32 bit handle into a SlotMap. The low INDEX_BITS address a slot, the rest hold the slot's
+	* generation at the time the handle was issued, so a handle to an erased (and possibly reused)
+	* slot is detected instead of silently aliasing the new occupant.
+	*/
+	struct SlotHandle {
+
+		static constexpr uint32_t INDEX_BITS = 20;
+		static constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+		static constexpr uint32_t GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+		static constexpr uint32_t INVALID = UINT32_MAX;
+
+		uint32_t value = INVALID;
+
+		SlotHandle() = default;
+		explicit SlotHandle(uint32_t raw) : value{ raw } {}
+		SlotHandle(uint32_t index, uint32_t generation) : value{ (generation & GENERATION_MASK) << INDEX_BITS | (index & INDEX_MASK) } {}
+
+		uint32_t index() const		{ return value & INDEX_MASK; }
+		uint32_t generation() const	{ return value >> INDEX_BITS; }
+		bool isValid() const		{ return value != INVALID; }
+
+		bool operator==(const SlotHandle& other) const { return value == other.value; }
+		bool operator!=(const SlotHandle& other) const { return value != other.value; }
+	};
+
+	/*
+	* @class SlotMap
+	* Values live packed in one contiguous array, so iteration is linear in memory regardless of
+	* how objects were added and removed. A sparse slot array maps stable handles onto dense
+	* positions; erase swaps the last value into the hole, so insert and erase are both O(1).
+	*
+	* Threading: reserve() may be called from any number of threads at once and never locks.
+	* Everything else (insert, erase, release, iteration) belongs to the owning thread and
+	* must not overlap with reserve().
+	*
+	* AvengRegistry keeps its entities in one, so an Entity is a SlotHandle and scene objects
+	* are created and destroyed through it rather than stored here whole.
+	*/
+	template <typename T>
+	class SlotMap {
+
+		static constexpr uint32_t NO_VALUE = UINT32_MAX;
+
+		struct Slot {
+			uint32_t dense = NO_VALUE;		// Position in values, NO_VALUE when vacant
+			uint32_t generation = 0;
+		};
+
+	public:
+
+		using Handle = SlotHandle;
+		using iterator = typename std::vector<T>::iterator;
+		using const_iterator = typename std::vector<T>::const_iterator;
+
+		SlotMap() = default;
+		SlotMap(const SlotMap&) = delete;
+		SlotMap& operator=(const SlotMap&) = delete;
+
+		/*
+		* Hand out a handle without touching the storage. Recycled slots are popped off the
+		* free list with a single atomic increment, fresh ones with another.
+		* The handle must later be passed to insert() or release().
+		*/
+		Handle reserve()
+		{
+			uint32_t taken = freeTaken.fetch_add(1, std::memory_order_relaxed);
+			if (taken < freeList.size())
+			{
+				uint32_t index = freeList[freeList.size() - 1 - taken];
+				return Handle{ index, slots[index].generation };
+			}
+
+			uint32_t index = nextFresh.fetch_add(1, std::memory_order_relaxed);
+			assert(index <= SlotHandle::INDEX_MASK && "SlotMap is out of slots");
+			return Handle{ index, 0 };
+		}
+
+		Handle insert(T&& value)
+		{
+			Handle handle = reserve();
+			insert(handle, std::move(value));
+			return handle;
+		}
+
+		// Fill a slot handed out by reserve()
+		void insert(Handle handle, T&& value)
+		{
+			reclaimReserved();
+
+			uint32_t index = handle.index();
+			if (index >= slots.size()) slots.resize(index + 1);
+
+			Slot& slot = slots[index];
+			assert(slot.dense == NO_VALUE && slot.generation == handle.generation() && "Slot was not reserved");
+
+			slot.dense = static_cast<uint32_t>(values.size());
+			values.push_back(std::move(value));
+			denseToSlot.push_back(index);
+		}
+
+		// Give back a reserved handle that will never be inserted
+		void release(Handle handle)
+		{
+			reclaimReserved();
+
+			uint32_t index = handle.index();
+			if (index >= slots.size()) slots.resize(index + 1);
+			freeList.push_back(index);
+		}
+
+		bool erase(Handle handle)
+		{
+			if (!contains(handle)) return false;
+			reclaimReserved();
+
+			Slot& slot = slots[handle.index()];
+			uint32_t hole = slot.dense;
+			uint32_t last = static_cast<uint32_t>(values.size()) - 1;
+
+			// Swap the last value into the hole to keep the array packed
+			if (hole != last)
+			{
+				values[hole] = std::move(values[last]);
+				denseToSlot[hole] = denseToSlot[last];
+				slots[denseToSlot[hole]].dense = hole;
+			}
+			values.pop_back();
+			denseToSlot.pop_back();
+
+			slot.dense = NO_VALUE;
+			slot.generation = (slot.generation + 1) & SlotHandle::GENERATION_MASK;
+			freeList.push_back(handle.index());
+			return true;
+		}
+
+		bool contains(Handle handle) const
+		{
+			if (!handle.isValid() || handle.index() >= slots.size()) return false;
+			const Slot& slot = slots[handle.index()];
+			return slot.dense != NO_VALUE && slot.generation == handle.generation();
+		}
+
+		// nullptr for stale handles
+		T* get(Handle handle)				{ return contains(handle) ? &values[slots[handle.index()].dense] : nullptr; }
+		const T* get(Handle handle) const	{ return contains(handle) ? &values[slots[handle.index()].dense] : nullptr; }
+
+		T& operator[](Handle handle)
+		{
+			assert(contains(handle) && "Stale or invalid SlotMap handle");
+			return values[slots[handle.index()].dense];
+		}
+
+		// The handle of the value at a position of the dense array
+		Handle handleAt(size_t denseIndex) const
+		{
+			uint32_t index = denseToSlot[denseIndex];
+			return Handle{ index, slots[index].generation };
+		}
+
+		void reserveCapacity(size_t capacity)
+		{
+			values.reserve(capacity);
+			denseToSlot.reserve(capacity);
+			slots.reserve(capacity);
+		}
+
+		size_t size() const		{ return values.size(); }
+		bool empty() const		{ return values.empty(); }
+		T* data()				{ return values.data(); }
+
+		iterator begin()				{ return values.begin(); }
+		iterator end()					{ return values.end(); }
+		const_iterator begin() const	{ return values.begin(); }
+		const_iterator end() const		{ return values.end(); }
+
+	private:
+
+		// Drop the free list entries reserve() has handed out since the last structural change
+		void reclaimReserved()
+		{
+			uint32_t taken = freeTaken.exchange(0, std::memory_order_relaxed);
+			freeList.resize(freeList.size() - std::min<size_t>(taken, freeList.size()));
+
+			// Fresh slots handed out by reserve() must exist before the next handle is checked against them
+			uint32_t fresh = nextFresh.load(std::memory_order_relaxed);
+			if (fresh > slots.size()) slots.resize(fresh);
+		}
+
+		std::vector<T> values;
+		std::vector<uint32_t> denseToSlot;
+		std::vector<Slot> slots;
+		std::vector<uint32_t> freeList;
+
+		std::atomic<uint32_t> freeTaken{ 0 };		// Entries popped off the back of freeList by reserve()
+		std::atomic<uint32_t> nextFresh{ 0 };		// Next never used slot index
+
+	};
+
+}
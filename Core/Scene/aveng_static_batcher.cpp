@@ -0,0 +1,99 @@
+#include "aveng_static_batcher.h"
+#include "../data.h"
+#include "../Math/aveng_occlusion.h"
+
+#include <cmath>
+#include <map>
+#include <tuple>
+
+namespace aveng {
+
+	AvengStaticBatcher::AvengStaticBatcher(EngineDevice& device, AvengGeometryArena* arena, float chunkSize)
+		: engineDevice{ device }, geometryArena{ arena }, chunkSize{ chunkSize }
+	{
+
+	}
+
+	void AvengStaticBatcher::add(std::shared_ptr<const AvengModel::Builder> geometry, const TransformComponent& transform, int texture)
+	{
+		pieces.push_back({ std::move(geometry), transform, texture });
+	}
+
+	size_t AvengStaticBatcher::build(AvengRegistry& scene, bool boxOccluders)
+	{
+		// Ordered, so the same pieces always build the same batches in the same order
+		using BatchKey = std::tuple<int, int, int, int>;		// Texture, chunk x, y, z
+		std::map<BatchKey, std::vector<size_t>> batches;
+
+		for (size_t n = 0; n < pieces.size(); n++)
+		{
+			Piece& piece = pieces[n];
+			const std::vector<AvengModel::Vertex>& vertices = piece.geometry->vertices;
+			if (vertices.empty()) continue;
+
+			glm::vec3 minimum = vertices[0].position;
+			glm::vec3 maximum = vertices[0].position;
+			for (const AvengModel::Vertex& vertex : vertices)
+			{
+				minimum = glm::min(minimum, vertex.position);
+				maximum = glm::max(maximum, vertex.position);
+			}
+
+			glm::vec3 center = piece.transform._mat4() * glm::vec4((minimum + maximum) * 0.5f, 1.f);
+			glm::vec3 chunk = glm::floor(center / chunkSize);
+			batches[{ piece.texture, static_cast<int>(chunk.x), static_cast<int>(chunk.y), static_cast<int>(chunk.z) }].push_back(n);
+		}
+
+		for (const auto& [key, members] : batches)
+		{
+			std::vector<AvengModel::Vertex> vertices;
+			std::vector<uint32_t> indices;
+
+			for (size_t n : members)
+			{
+				Piece& piece = pieces[n];
+				glm::mat4 model = piece.transform._mat4();
+				glm::mat3 normalMatrix = piece.transform.normalMatrix();
+
+				uint32_t base = static_cast<uint32_t>(vertices.size());
+				for (const AvengModel::Vertex& source : piece.geometry->vertices)
+				{
+					AvengModel::Vertex vertex = source;
+					vertex.position = model * glm::vec4(source.position, 1.f);
+					vertex.normal = glm::normalize(normalMatrix * source.normal);
+					vertices.push_back(vertex);
+				}
+
+				// Unindexed geometry gets the indices it would have had
+				if (piece.geometry->indices.empty())
+				{
+					for (uint32_t v = 0; v < piece.geometry->vertices.size(); v++) indices.push_back(base + v);
+				}
+				else
+				{
+					for (uint32_t index : piece.geometry->indices) indices.push_back(base + index);
+				}
+			}
+
+			Entity entity = scene.create();
+			VisualComponent visual{};
+			visual.tex_id = std::get<0>(key);
+
+			scene.add<TransformComponent>(entity, TransformComponent{});
+			scene.add<VisualComponent>(entity, visual);
+			scene.add<MetaComponent>(entity, { STATIC });
+
+			auto model = std::make_shared<AvengModel>(engineDevice, std::move(vertices), std::move(indices), geometryArena);
+			if (boxOccluders)
+			{
+				const AvengModel::Bounds& bounds = model->getBounds();
+				scene.add<OccluderComponent>(entity, { OccluderMesh::box(bounds.center, bounds.extents) });
+			}
+			scene.add<ModelComponent>(entity, { std::move(model) });
+		}
+
+		pieces.clear();
+		return batches.size();
+	}
+
+}
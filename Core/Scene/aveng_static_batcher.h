@@ -0,0 +1,58 @@
+#pragma once
+
+#include "../aveng_model.h"
+#include "AvengComponent.h"
+#include "aveng_registry.h"
+
+#include <memory>
+#include <vector>
+
+namespace aveng {
+
+	/*
+	* @class AvengStaticBatcher
+	* Merges scene pieces that never move into a few large meshes at load time. Every piece queued with
+	* add is transformed into world space, and pieces sharing a texture whose centers fall in the same
+	* cubic chunk of the world are concatenated into one vertex / index buffer. Each merged mesh becomes
+	* one STATIC entity with an identity transform, so it goes through every draw path like any other
+	* object, and its bounds (computed from the merged vertices) still let culling reject it chunk by chunk.
+	*
+	* All of the object pipelines draw every piece the same way, so texture is the only state to split on.
+	*/
+	class AvengStaticBatcher {
+
+	public:
+
+		AvengStaticBatcher(EngineDevice& device, AvengGeometryArena* arena = nullptr, float chunkSize = 64.f);
+
+		AvengStaticBatcher(const AvengStaticBatcher&) = delete;
+		AvengStaticBatcher& operator=(const AvengStaticBatcher&) = delete;
+
+		// Queue one piece. Geometry is shared, so any number of pieces can place the same mesh
+		void add(std::shared_ptr<const AvengModel::Builder> geometry, const TransformComponent& transform, int texture);
+
+		/*
+		* Build a mesh per texture and chunk and spawn an entity for each. Returns how many were spawned, and empties the queue.
+		* With boxOccluders each batch also hides what's behind its bounding box from the software occlusion pass,
+		* which is only right for pieces that fill their chunk's box, e.g. flat tiles laid edge to edge.
+		*/
+		size_t build(AvengRegistry& scene, bool boxOccluders = false);
+
+		size_t pieceCount() const { return pieces.size(); }
+
+	private:
+
+		struct Piece {
+			std::shared_ptr<const AvengModel::Builder> geometry;
+			TransformComponent transform;
+			int texture;
+		};
+
+		EngineDevice& engineDevice;
+		AvengGeometryArena* geometryArena;
+		float chunkSize;
+		std::vector<Piece> pieces;
+
+	};
+
+}
@@ -0,0 +1,217 @@
+#include "aveng_transform_hierarchy.h"
+#include "../Math/aveng_transform_batch.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace aveng {
+
+	void AvengTransformHierarchy::attach(AvengRegistry& scene, Entity child, Entity parent)
+	{
+		if (!scene.has<TransformComponent>(child) || !scene.has<TransformComponent>(parent)) {
+			throw std::runtime_error("failed to attach, both entities need a TransformComponent!");
+		}
+
+		// Walking up from parent must not reach child
+		for (Entity ancestor = parent; ; ancestor = scene.get<ParentComponent>(ancestor).parent)
+		{
+			if (ancestor == child) {
+				throw std::runtime_error("failed to attach, the hierarchy would have a cycle!");
+			}
+			if (!scene.has<ParentComponent>(ancestor)) break;
+		}
+
+		if (scene.has<ParentComponent>(child)) scene.get<ParentComponent>(child).parent = parent;
+		else scene.add<ParentComponent>(child, { parent });
+		layoutDirty = true;
+	}
+
+	void AvengTransformHierarchy::detach(AvengRegistry& scene, Entity child)
+	{
+		if (!scene.has<ParentComponent>(child)) return;
+
+		scene.remove<ParentComponent>(child);
+		scene.get<TransformComponent>(child).invalidateMatrices();	// Still holds the world matrix
+		layoutDirty = true;
+	}
+
+	size_t AvengTransformHierarchy::update(AvengRegistry& scene, ThreadPool* workers, size_t minPerThread)
+	{
+		ComponentPool<TransformComponent>& transforms = scene.pool<TransformComponent>();
+
+		// Destroying a root takes none of its children's links with it, so only the nodes themselves show it
+		bool stale = layoutDirty || scene.pool<ParentComponent>().size() != linkCount;
+		for (size_t node = 0; !stale && node < entities.size(); node++) stale = !transforms.has(entities[node]);
+		if (stale) rebuildLayout(scene);
+		size_t threadCount = workers ? workers->threads.size() : 0;
+		size_t updated = 0;
+		size_t rootsUpdated = 0;
+
+		// Each depth waits on the one above it, the nodes within a depth are independent
+		for (size_t level = 0; level + 1 < levels.size(); level++)
+		{
+			size_t begin = levels[level];
+			size_t end = levels[level + 1];
+			size_t count = end - begin;
+
+			size_t participants = std::min(threadCount + 1, std::max<size_t>(1, count / minPerThread));
+			size_t levelUpdated = 0;
+			if (participants <= 1)
+			{
+				levelUpdated = updateRange(transforms, begin, end);
+			}
+			else
+			{
+				size_t chunk = (count + participants - 1) / participants;
+				levelCounts.assign(participants, 0);
+				for (size_t t = 1; t < participants; t++)
+				{
+					size_t first = std::min(end, begin + t * chunk);
+					size_t last = std::min(end, first + chunk);
+					workers->threads[t - 1]->addJob([&, t, first, last] {
+						levelCounts[t] = updateRange(transforms, first, last);
+					});
+				}
+				levelCounts[0] = updateRange(transforms, begin, std::min(end, begin + chunk));
+				workers->wait();
+				for (size_t c : levelCounts) levelUpdated += c;
+			}
+
+			if (level == 0) rootsUpdated = levelUpdated;
+			updated += levelUpdated;
+		}
+
+		// Roots went through _mat4, which counts its own rebuilds
+		TransformComponent::countRebuilds(static_cast<uint32_t>(updated - rootsUpdated));
+		forceUpdate = false;
+		return updated;
+	}
+
+	size_t AvengTransformHierarchy::updateRange(ComponentPool<TransformComponent>& transforms, size_t begin, size_t end)
+	{
+		size_t updated = 0;
+		for (size_t node = begin; node < end; node++)
+		{
+			assert(transforms.has(entities[node]) && "Hierarchy node outlived its entity, the layout should have been rebuilt");
+			TransformComponent& transform = transforms.get(entities[node]);
+			uint32_t parent = parents[node];
+
+			// A root's own matrix is its world matrix. It may have been rebuilt since the last update, so check the version rather than ask
+			if (parent == NO_PARENT)
+			{
+				const glm::mat4& model = transform._mat4();
+				bool moved = forceUpdate || transform.matrices.version != versions[node];
+				dirty[node] = moved;
+				if (moved)
+				{
+					world[node] = model;
+					normals[node] = transform.normalMatrix();
+					versions[node] = transform.matrices.version;
+					updated++;
+				}
+				continue;
+			}
+
+			// Anything that rebuilt the cache from the local fields alone has bumped its version
+			bool moved = forceUpdate || dirty[parent] || transform.matricesStale() || transform.matrices.version != versions[node];
+			dirty[node] = moved;
+			if (!moved) continue;
+
+			glm::mat4 local;
+			glm::mat3 localNormal;
+			buildTransform(transform.translation, transform.orientation, transform.scale, local, localNormal);
+
+			// Inverse transposes compose like the matrices do
+			world[node] = world[parent] * local;
+			normals[node] = normals[parent] * localNormal;
+			transform.storeMatrices(world[node], normals[node]);
+			versions[node] = transform.matrices.version;
+			updated++;
+		}
+		return updated;
+	}
+
+	/*
+	* Lay the nodes out breadth first from the ParentComponents in the scene. Children of a parent are
+	* gathered into one array indexed by the parent's slot (counting sort), then each depth is produced
+	* from the one before it, so siblings end up next to each other and right after the depth above.
+	*/
+	void AvengTransformHierarchy::rebuildLayout(AvengRegistry& scene)
+	{
+		ComponentPool<ParentComponent>& links = scene.pool<ParentComponent>();
+
+		// Children of destroyed parents leave the hierarchy
+		std::vector<Entity> orphans;
+		for (size_t n = 0; n < links.size(); n++)
+		{
+			if (!scene.valid(links.data()[n].parent)) orphans.push_back(links.owners()[n]);
+		}
+		for (Entity orphan : orphans)
+		{
+			scene.remove<ParentComponent>(orphan);
+			scene.get<TransformComponent>(orphan).invalidateMatrices();
+		}
+
+		const std::vector<Entity>& children = links.owners();
+		const ParentComponent* link = links.data();
+		size_t linkTotal = links.size();
+
+		uint32_t slots = 0;
+		for (size_t n = 0; n < linkTotal; n++)
+		{
+			slots = std::max({ slots, link[n].parent.index() + 1, children[n].index() + 1 });
+		}
+
+		// firstChild[slot] .. firstChild[slot + 1] is the range of childList under the entity in that slot
+		std::vector<uint32_t> firstChild(slots + 1, 0);
+		for (size_t n = 0; n < linkTotal; n++) firstChild[link[n].parent.index() + 1]++;
+		for (uint32_t slot = 0; slot < slots; slot++) firstChild[slot + 1] += firstChild[slot];
+
+		std::vector<Entity> childList(linkTotal);
+		std::vector<uint32_t> fill(firstChild.begin(), firstChild.end() - 1);
+		for (size_t n = 0; n < linkTotal; n++) childList[fill[link[n].parent.index()]++] = children[n];
+
+		// Roots are parents without a parent of their own
+		entities.clear();
+		parents.clear();
+		levels.clear();
+		std::vector<uint8_t> seen(slots, 0);
+		for (size_t n = 0; n < linkTotal; n++)
+		{
+			Entity parent = link[n].parent;
+			if (seen[parent.index()] || scene.has<ParentComponent>(parent)) continue;
+			seen[parent.index()] = 1;
+			entities.push_back(parent);
+			parents.push_back(NO_PARENT);
+		}
+
+		size_t levelBegin = 0;
+		while (levelBegin < entities.size())
+		{
+			levels.push_back(static_cast<uint32_t>(levelBegin));
+			size_t levelEnd = entities.size();
+			for (size_t node = levelBegin; node < levelEnd; node++)
+			{
+				uint32_t slot = entities[node].index();
+				for (uint32_t c = firstChild[slot]; c < firstChild[slot + 1]; c++)
+				{
+					entities.push_back(childList[c]);
+					parents.push_back(static_cast<uint32_t>(node));
+				}
+			}
+			levelBegin = levelEnd;
+		}
+		levels.push_back(static_cast<uint32_t>(entities.size()));
+
+		world.resize(entities.size());
+		normals.resize(entities.size());
+		dirty.assign(entities.size(), 0);
+		versions.assign(entities.size(), 0);
+
+		linkCount = links.size();
+		layoutDirty = false;
+		forceUpdate = true;
+	}
+
+}
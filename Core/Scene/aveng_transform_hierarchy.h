@@ -0,0 +1,72 @@
+#pragma once
+
+#include "AvengComponent.h"
+#include "aveng_registry.h"
+#include "../Utils/threadpool.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace aveng {
+
+	/*
+	* @class AvengTransformHierarchy
+	* Parent / child links between entities, so a turret or a light attached to a ship follows it without
+	* gameplay code moving both. Links live in the registry as ParentComponents; a child's TransformComponent
+	* holds its transform relative to its parent, and after update() its cached matrices (_mat4, normalMatrix)
+	* are the world ones, so every render path draws children without knowing about the hierarchy.
+	*
+	* Nodes are stored breadth first, one contiguous range per depth, so a parent is always finished before
+	* its children. update() walks the ranges in order and splits each across the pool's threads. A node's
+	* world matrix is only recomputed when its own transform changed or its parent's was recomputed, so a
+	* still subtree costs a couple of compares per node.
+	*
+	* Destroy children before their parents, or detach them first; a child left pointing at a destroyed
+	* parent is detached by the next update(), and becomes a root if it has children of its own.
+	*/
+	class AvengTransformHierarchy {
+
+	public:
+
+		AvengTransformHierarchy() = default;
+		AvengTransformHierarchy(const AvengTransformHierarchy&) = delete;
+		AvengTransformHierarchy& operator=(const AvengTransformHierarchy&) = delete;
+
+		// child's TransformComponent becomes relative to parent. Throws if that would make a cycle
+		void attach(AvengRegistry& scene, Entity child, Entity parent);
+		void detach(AvengRegistry& scene, Entity child);
+
+		/*
+		* Bring every world matrix up to date. Call once gameplay is done moving things for the frame and
+		* before anything reads matrices. Returns the number of nodes whose world matrix was recomputed.
+		*/
+		size_t update(AvengRegistry& scene, ThreadPool* workers, size_t minPerThread = 1024);
+
+		size_t nodeCount() const	{ return entities.size(); }
+		size_t levelCount() const	{ return levels.empty() ? 0 : levels.size() - 1; }
+
+	private:
+
+		static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+		void rebuildLayout(AvengRegistry& scene);
+		size_t updateRange(ComponentPool<TransformComponent>& transforms, size_t begin, size_t end);
+
+		// Per node, breadth first
+		std::vector<Entity> entities;
+		std::vector<uint32_t> parents;		// Node index of the parent, NO_PARENT for roots
+		std::vector<glm::mat4> world;
+		std::vector<glm::mat3> normals;
+		std::vector<uint8_t> dirty;			// Recomputed this update
+		std::vector<uint32_t> versions;		// MatrixCache::version after this hierarchy last wrote or read it
+
+		std::vector<uint32_t> levels;		// First node of each depth, then the node count
+		std::vector<size_t> levelCounts;	// Nodes updated by each participant of a level, kept so update doesn't allocate
+
+		bool layoutDirty = true;
+		bool forceUpdate = false;			// Everything is recomputed after a layout rebuild
+		size_t linkCount = 0;				// ParentComponents at the last rebuild, a change means one was destroyed
+
+	};
+
+}
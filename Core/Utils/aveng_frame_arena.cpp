@@ -0,0 +1,153 @@
+#include "aveng_frame_arena.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(_MSC_VER)
+	#include <malloc.h>
+#endif
+
+namespace aveng {
+
+	static std::atomic<uint64_t> heapAllocations{ 0 };
+
+	uint64_t heapAllocationCount()
+	{
+		return heapAllocations.load(std::memory_order_relaxed);
+	}
+
+	FrameArena::FrameArena(size_t capacity) 
+		: buffer{ std::make_unique<std::byte[]>(capacity) }, bufferSize{ capacity }
+	{}
+
+	FrameArena::~FrameArena()
+	{
+		reset();
+	}
+
+	void FrameArena::reset()
+	{
+		for (auto& block : overflow)
+		{
+			std::pmr::new_delete_resource()->deallocate(block.ptr, block.bytes, block.alignment);
+		}
+		overflow.clear();
+		offset = 0;
+	}
+
+	void* FrameArena::do_allocate(size_t bytes, size_t alignment)
+	{
+		uintptr_t base = reinterpret_cast<uintptr_t>(buffer.get());
+		uintptr_t aligned = (base + offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+		size_t end = static_cast<size_t>(aligned - base) + bytes;
+
+		if (end <= bufferSize)
+		{
+			offset = end;
+			if (offset > peakUsed) peakUsed = offset;
+			return reinterpret_cast<void*>(aligned);
+		}
+
+		// Out of room this frame. Grow the capacity if this shows up regularly.
+		void* ptr = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+		overflow.push_back({ ptr, bytes, alignment });
+		overflowTotal++;
+		return ptr;
+	}
+
+	void FrameArena::do_deallocate(void* p, size_t bytes, size_t alignment)
+	{
+		// Everything goes at once in reset()
+	}
+
+}
+
+/*
+* Replacing the global allocation functions lets us count heap allocations per frame.
+* The std::align_val_t overloads are replaced too, over-aligned types (SIMD batches) allocate through them.
+*/
+void* operator new(std::size_t size)
+{
+	aveng::heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	aveng::heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+	return ::operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept								{ std::free(ptr); }
+void operator delete[](void* ptr) noexcept								{ std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept					{ std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept					{ std::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept			{ std::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept		{ std::free(ptr); }
+
+namespace {
+
+	// MSVC has no std::aligned_alloc, and memory from _aligned_malloc must go back through _aligned_free
+	void* alignedAllocate(std::size_t size, std::align_val_t alignment) noexcept
+	{
+		std::size_t align = static_cast<std::size_t>(alignment);
+		size = size ? (size + align - 1) & ~(align - 1) : align;	// aligned_alloc wants a multiple of the alignment
+#if defined(_MSC_VER)
+		return _aligned_malloc(size, align);
+#else
+		return std::aligned_alloc(align, size);
+#endif
+	}
+
+	void alignedFree(void* ptr) noexcept
+	{
+#if defined(_MSC_VER)
+		_aligned_free(ptr);
+#else
+		std::free(ptr);
+#endif
+	}
+
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	aveng::heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = alignedAllocate(size, alignment)) return ptr;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return ::operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	aveng::heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	return alignedAllocate(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t& tag) noexcept
+{
+	return ::operator new(size, alignment, tag);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept								{ alignedFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept							{ alignedFree(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept				{ alignedFree(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept				{ alignedFree(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept		{ alignedFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept	{ alignedFree(ptr); }
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace aveng {
+
+	// Number of calls to the global operator new since startup. See aveng_frame_arena.cpp
+	uint64_t heapAllocationCount();
+
+	/*
+	* @class FrameArena
+	* A linear allocator for anything that only has to live until the end of the frame.
+	* Hand it to std::pmr containers; deallocation is a no-op and everything is released
+	* at once by reset() at the top of the render loop. Requests that don't fit are
+	* forwarded to the heap and released on the next reset.
+	*/
+	class FrameArena : public std::pmr::memory_resource {
+
+	public:
+
+		static constexpr size_t DEFAULT_CAPACITY = 1024 * 1024;
+
+		explicit FrameArena(size_t capacity = DEFAULT_CAPACITY);
+		~FrameArena();
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+
+		void reset();
+
+		size_t used() const			{ return offset; }		// Since the last reset, read it before resetting for a frame's usage
+		size_t peak() const			{ return peakUsed; }	// The most used() has ever been, across every frame
+		size_t capacity() const		{ return bufferSize; }
+		size_t overflowCount() const	{ return overflowTotal; }
+
+	private:
+
+		struct Overflow {
+			void* ptr;
+			size_t bytes;
+			size_t alignment;
+		};
+
+		void* do_allocate(size_t bytes, size_t alignment) override;
+		void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+		std::unique_ptr<std::byte[]> buffer;
+		size_t bufferSize;
+		size_t offset{ 0 };
+		size_t peakUsed{ 0 };
+		size_t overflowTotal{ 0 };
+		std::vector<Overflow> overflow;
+
+	};
+
+}
@@ -2,6 +2,10 @@
 
 #include "Camera/aveng_camera.h"
 #include "Scene/app_object.h"
+#include "Scene/aveng_registry.h"
+#include "Utils/threadpool.h"
+
+#include <memory_resource>
 
 namespace aveng {
 	struct FrameContent {
@@ -12,7 +16,9 @@ namespace aveng {
 		AvengCamera& camera;
 		VkDescriptorSet globalDescriptorSet;
 		VkDescriptorSet objectDescriptorSet;
-		AvengAppObject::Map& appObjects;
+		AvengRegistry& scene;
+		std::pmr::memory_resource* frameArena;	// Transient allocations, released at the top of the next frame
+		ThreadPool* workers;					// Idle between frames, systems may split their work across it
 
 	};
 }
\ No newline at end of file
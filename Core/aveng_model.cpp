@@ -1,3 +1,4 @@
+#include <atomic>
 #include <cassert>
 #include <cstring>
 #include <iostream>
@@ -41,10 +42,26 @@ namespace aveng {
 	//	createIndexBuffers(builder.indices);
 	//}
 
-	AvengModel::AvengModel(EngineDevice& device, std::vector<AvengModel::Vertex> vertices, std::vector<uint32_t> indices)
+	AvengModel::AvengModel(EngineDevice& device, std::vector<AvengModel::Vertex> vertices, std::vector<uint32_t> indices, AvengGeometryArena* arena)
 		: engineDevice{ device }
 	{
+		static std::atomic<uint32_t> nextId{ 0 };
+		id = nextId.fetch_add(1, std::memory_order_relaxed);
+
 		std::cout << "Instantiating Model..." << std::endl;
+		vertexCount = static_cast<uint32_t>(vertices.size());
+		indexCount = static_cast<uint32_t>(indices.size());
+		hasIndexBuffer = indexCount > 0;
+		computeBounds(vertices);
+
+		// Only indexed meshes go in the arena, it draws everything with vkCmdDrawIndexed*
+		if (arena != nullptr && hasIndexBuffer
+			&& arena->upload(vertices.data(), vertexCount, indices.data(), indexCount, arenaRange))
+		{
+			geometryArena = arena;
+			return;
+		}
+
 		createVertexBuffers(vertices); // The vertex shader takes input from a vertex buffer from `layout(location = n) in vec3 vertexAttribute`. The vertexAttribute is defined by the vertex Buffer
 		createIndexBuffers(indices);
 	}
@@ -53,11 +70,11 @@ namespace aveng {
 	{
 	}
 
-	std::unique_ptr<AvengModel> AvengModel::createModelFromFile(EngineDevice& device, const std::string& filepath)
+	std::unique_ptr<AvengModel> AvengModel::createModelFromFile(EngineDevice& device, const std::string& filepath, AvengGeometryArena* arena)
 	{
 		Builder builder{};
 		builder.loadModel(filepath);
-		return std::make_unique<AvengModel>(device, builder.vertices, builder.indices);
+		return std::make_unique<AvengModel>(device, builder.vertices, builder.indices, arena);
 	}
 
 	std::unique_ptr<AvengModel> AvengModel::drawTriangle(EngineDevice& device, glm::vec3 pos)
@@ -72,6 +89,31 @@ namespace aveng {
 		return std::make_unique<AvengModel>(device, vertices, indices);
 	}
 
+	void AvengModel::computeBounds(const std::vector<Vertex>& vertices)
+	{
+		if (vertices.empty()) return;
+
+		glm::vec3 minimum = vertices[0].position;
+		glm::vec3 maximum = vertices[0].position;
+		for (const Vertex& vertex : vertices)
+		{
+			minimum = glm::min(minimum, vertex.position);
+			maximum = glm::max(maximum, vertex.position);
+		}
+
+		bounds.center = (minimum + maximum) * 0.5f;
+		bounds.extents = (maximum - minimum) * 0.5f;
+
+		// Tighter than the box's corner for most meshes
+		float radiusSquared = 0.f;
+		for (const Vertex& vertex : vertices)
+		{
+			glm::vec3 offset = vertex.position - bounds.center;
+			radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
+		}
+		bounds.radius = glm::sqrt(radiusSquared);
+	}
+
 	/*
 		@function createVertexBuffers
 		Create a vertex buffer in our device memory
@@ -163,15 +205,49 @@ namespace aveng {
 	{
 		if (hasIndexBuffer) 
 		{
-			vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+			vkCmdDrawIndexed(commandBuffer, indexCount, 1, arenaRange.firstIndex, arenaRange.vertexOffset, 0);
 		}
 		else {
 			vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
 		}
 	}
 
+	/*
+	* Draw instanceCount copies of the mesh. Per instance attributes are read from whatever is bound
+	* at binding 1, starting at element firstInstance.
+	*/
+	void AvengModel::drawInstanced(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance)
+	{
+		if (hasIndexBuffer)
+		{
+			vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, arenaRange.firstIndex, arenaRange.vertexOffset, firstInstance);
+		}
+		else {
+			vkCmdDraw(commandBuffer, vertexCount, instanceCount, 0, firstInstance);
+		}
+	}
+
+	VkDrawIndexedIndirectCommand AvengModel::indirectCommand(uint32_t instanceCount, uint32_t firstInstance) const
+	{
+		assert(geometryArena != nullptr && "Only arena meshes can be drawn indirectly");
+
+		VkDrawIndexedIndirectCommand command{};
+		command.indexCount = indexCount;
+		command.instanceCount = instanceCount;
+		command.firstIndex = arenaRange.firstIndex;
+		command.vertexOffset = arenaRange.vertexOffset;
+		command.firstInstance = firstInstance;
+		return command;
+	}
+
 	void AvengModel::bind(VkCommandBuffer commandBuffer)
 	{
+		if (geometryArena != nullptr)
+		{
+			geometryArena->bind(commandBuffer);
+			return;
+		}
+
 		VkBuffer buffers[] = { vertexBuffer->getBuffer() };
 		VkDeviceSize offsets[] = { 0 };
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
@@ -188,7 +264,7 @@ namespace aveng {
 	* 1 of 2 requirements for describing how Vulkan
 	* should pass data into the vertex shader
 	*/
-	std::vector<VkVertexInputBindingDescription> AvengModel::Vertex::getBindingDescriptions()
+	const std::vector<VkVertexInputBindingDescription>& AvengModel::Vertex::getBindingDescriptions()
 	{
 		// This VkVertexInputBindingDescription corresponds to a single vertex buffer
 		// it will occupy the binding at index 0.
@@ -199,10 +275,10 @@ namespace aveng {
 			uint32_t             stride;
 			VkVertexInputRate    inputRate;
 		*/
-		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
-		bindingDescriptions[0].binding = 0;
-		bindingDescriptions[0].stride = sizeof(Vertex);
-		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;		// Can be per vertex or per instance
+		// Built once, every pipeline shares the same vertex layout
+		static const std::vector<VkVertexInputBindingDescription> bindingDescriptions{
+			{ 0, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX }		// Can be per vertex or per instance
+		};
 		return bindingDescriptions;
 	}
 
@@ -211,7 +287,7 @@ namespace aveng {
 	* 2 of 2 required functions for describing how Vulkan
 	* should pass data into the vertex shader
 	*/
-	std::vector<VkVertexInputAttributeDescription> AvengModel::Vertex::getAttributeDescriptions()
+	const std::vector<VkVertexInputAttributeDescription>& AvengModel::Vertex::getAttributeDescriptions()
 	{
 		 /*
 			uint32_t    location;	-- This specifies the location as assigned in the vertex shader i.e. layout( location = 0 ) 
@@ -220,12 +296,12 @@ namespace aveng {
 			uint32_t    offset;		-- type, membername. Calculates the byte offset of the position member from the Vertex struct
 		 */
 		// return { {0, 0, VK_FORMAT_R32G32_SFLOAT, 0} };
-		std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
-
-		attributeDescriptions.push_back({ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position) });		// Vertex Positions
-		attributeDescriptions.push_back({ 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color) });			// Vertex colors
-		attributeDescriptions.push_back({ 2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal) });		// Defines a surface's normal (the non-culled side)
-		attributeDescriptions.push_back({ 3, 0, VK_FORMAT_R32G32_SFLOAT,	offsetof(Vertex, texCoord) });		// Texture coordinates
+		static const std::vector<VkVertexInputAttributeDescription> attributeDescriptions{
+			{ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position) },		// Vertex Positions
+			{ 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color) },			// Vertex colors
+			{ 2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal) },		// Defines a surface's normal (the non-culled side)
+			{ 3, 0, VK_FORMAT_R32G32_SFLOAT,	offsetof(Vertex, texCoord) }		// Texture coordinates
+		};
 
 		return attributeDescriptions;
 
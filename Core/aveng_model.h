@@ -2,6 +2,7 @@
 
 #include "../CoreVK/EngineDevice.h"
 #include "../CoreVK/aveng_buffer.h"
+#include "../CoreVK/aveng_geometry_arena.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -29,8 +30,8 @@ namespace aveng {
 			* Required to communicate with the vertex shader.
 			* Descriptions of our vertex buffers and how they are to be bound.
 			*/
-			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
-			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+			static const std::vector<VkVertexInputBindingDescription>& getBindingDescriptions();
+			static const std::vector<VkVertexInputAttributeDescription>& getAttributeDescriptions();
 
 			// This is used with our hashing function to generate keys in our ordered map of vertices
 			bool operator==(const Vertex& other) const 
@@ -40,6 +41,13 @@ namespace aveng {
 
 		};
 
+		// Object space bounds, computed from the vertices at import
+		struct Bounds {
+			glm::vec3 center{};			// Center of the axis aligned box, also the sphere's center
+			glm::vec3 extents{};		// Half size of the box
+			float radius = 0.f;			// Smallest sphere around center holding every vertex
+		};
+
 		// Vertex and index information to be sent to the model's vertex and index buffer memory
 		struct Builder {
 			std::vector<Vertex> vertices{};
@@ -49,27 +57,42 @@ namespace aveng {
 		};
 
 		//AvengModel(EngineDevice& device, const AvengModel::Builder& builder);
-		AvengModel(EngineDevice& device, std::vector<AvengModel::Vertex> vertices, std::vector<uint32_t> indices);
+		// With an arena, indexed geometry is stored there instead of in buffers of the model's own
+		AvengModel(EngineDevice& device, std::vector<AvengModel::Vertex> vertices, std::vector<uint32_t> indices, AvengGeometryArena* arena = nullptr);
 		~AvengModel();
 
 		AvengModel(const AvengModel&) = delete;
 		AvengModel& operator=(const AvengModel&) = delete;
 
-		static std::unique_ptr<AvengModel> createModelFromFile(EngineDevice& device, const std::string& filepath);
+		static std::unique_ptr<AvengModel> createModelFromFile(EngineDevice& device, const std::string& filepath, AvengGeometryArena* arena = nullptr);
 		static std::unique_ptr<AvengModel> drawTriangle(EngineDevice& device, glm::vec3 pos);
 		
 		void bind(VkCommandBuffer commandBuffer);
 		void draw(VkCommandBuffer commandBuffer);
+		void drawInstanced(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance);
+
+		// Arena meshes can be drawn indirectly, all of them with the arena's buffers bound
+		const Bounds& getBounds() const { return bounds; }
+
+		// Small and dense, unique per model. The mesh field of a RenderQueue sort key
+		uint32_t getId() const { return id; }
+
+		bool isInArena() const { return geometryArena != nullptr; }
+		AvengGeometryArena* getArena() const { return geometryArena; }
+		VkDrawIndexedIndirectCommand indirectCommand(uint32_t instanceCount, uint32_t firstInstance) const;
 	
 	private:
 
 		void createVertexBuffers(const std::vector<Vertex>& vertices);
 		void createIndexBuffers(const std::vector<uint32_t>& indices);
+		void computeBounds(const std::vector<Vertex>& vertices);
 
 		EngineDevice& engineDevice;
+		uint32_t id;
 		uint32_t vertexCount;
 		bool hasIndexBuffer = false;
 		uint32_t indexCount;
+		Bounds bounds{};
 
 		/*VkBuffer vertexBuffer;		OLD
 		VkDeviceMemory vertexBufferMemory;*/
@@ -81,6 +104,9 @@ namespace aveng {
 		// NEW
 		std::unique_ptr<AvengBuffer> indexBuffer;
 
+		AvengGeometryArena* geometryArena = nullptr;
+		AvengGeometryArena::Range arenaRange{};
+
 	};
 
 } //
\ No newline at end of file
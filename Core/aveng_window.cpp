@@ -4,13 +4,15 @@
 
 namespace aveng {
 
-	AvengWindow::AvengWindow(int w, int h, std::string name) : width{ w }, height{ h }, windowName{ name }
+	AvengWindow::AvengWindow(int w, int h, std::string name, bool headless) : width{ w }, height{ h }, windowName{ name }, headless{ headless }
 	{
-		initWindow();
+		// glfwInit fails without a display, so headless it's never called
+		if (!headless) initWindow();
 	}
 
 	AvengWindow::~AvengWindow()
 	{
+		if (headless) return;
 		glfwDestroyWindow(window);
 		glfwTerminate();
 	}
@@ -44,6 +46,11 @@ namespace aveng {
 
 	void AvengWindow::createWindowSurface(VkInstance instance, VkSurfaceKHR* surface)
 	{
+		if (headless)
+		{
+			throw std::runtime_error("A headless window has no surface.");
+		}
+
 		if (glfwCreateWindowSurface(instance, window, nullptr, surface) != VK_SUCCESS)
 		{
 			// TODO - More concise debugging. For example one might check for VK_ERROR_EXTENSION_NOT_PRESENT or first perform vkDestroySurfaceKHR
@@ -51,7 +58,8 @@ namespace aveng {
 		}
 	}
 
-	bool AvengWindow::shouldClose() { return glfwWindowShouldClose(window); }
+	// Headless, whoever runs the frame loop decides when it's done
+	bool AvengWindow::shouldClose() { return !headless && glfwWindowShouldClose(window); }
 
 	void AvengWindow::framebufferResizedCallback(GLFWwindow* window, int width, int height)
 	{
@@ -7,15 +7,17 @@ namespace aveng {
 
 	class AvengWindow {
 		std::string windowName;
-		GLFWwindow* window;
+		GLFWwindow* window = nullptr;
 
 		bool framebufferResized = false;
 		int width;
 		int height;
+		bool headless;
 
 	public:
 
-		AvengWindow(int w, int h, std::string name);
+		// Headless, there's no GLFW and no window, only the extent offscreen images are made at. See SwapChain
+		AvengWindow(int w, int h, std::string name, bool headless = false);
 		~AvengWindow();
 
 		// Removal of copy construction
@@ -24,6 +26,8 @@ namespace aveng {
 
 		bool shouldClose();
 
+		bool isHeadless() const { return headless; }
+
 		VkExtent2D getExtent() { return { static_cast<uint32_t>(width), static_cast<uint32_t>(height) }; }
 
 		bool wasWindowResized() { return framebufferResized; }
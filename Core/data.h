@@ -20,6 +20,14 @@ namespace aveng {
 		NO_TEXTURE
 	};
 
+	// ObjectRenderSystem submission paths
+	enum drawModes {
+		DRAW_PER_OBJECT = 0,
+		DRAW_INSTANCED,
+		DRAW_INDIRECT,
+		DRAW_GPU_CULLED		// Frustum culled by a compute pass, see GpuCullingSystem
+	};
+
 	// Used by Components System
 	enum types {
 		GROUND = 0,
@@ -58,6 +66,95 @@ namespace aveng {
 		float		speed;
 		glm::vec3	velocity;
 
+		// GPU memory, from the AvengAllocator and AvengDefragmenter
+		int			gpuBlocks;
+		float		gpuUsedMB;
+		float		gpuReservedMB;
+		float		gpuFragmentation;
+		float		defragBefore;
+		float		defragAfter;
+		int			defragMoves;
+		bool		defragRunning = false;
+		bool		requestDefrag = false;	// Set by the GUI, consumed by XOne
+
+		// Per frame CPU allocations
+		int			heapAllocs;
+		float		arenaKB;
+
+		// Object pass, see the "Object Pass" GUI header
+		int			drawMode = DRAW_INDIRECT;
+		int			drawCalls;
+		int			indirectCommands;
+		int			pipelineBinds;			// State changes recorded by the object pass, see RenderQueue
+		int			textureBinds;
+		int			meshBinds;
+		bool		parallelRecording = true;	// Per object draws in secondary command buffers, one per thread
+		int			recordThreads;
+		bool		cacheStatic = true;			// STATIC / GROUND objects replayed from a cached secondary buffer
+		int			staticObjects;
+		int			staticRecords = 0;			// Times the cache was re-recorded, since startup
+		int			batchedObjects;				// Pieces merged by AvengStaticBatcher at load
+		int			staticBatches;				// and the meshes they became
+		float		cpuRecordMs;
+		float		gpuObjectMs;
+		bool		depthPrepass = false;		// Depth laid down first, then shaded testing EQUAL, see ObjectRenderSystem::hasDepthPrepass
+		float		gpuPrepassMs;
+		float		gpuCullMs;
+		float		gpuOcclusionMs;
+		bool		occlusionCulling = true;
+		int			lateObjects;
+		bool		gpuTimestamps = false;
+		bool		frustumCulling = true;
+		int			visibleObjects;
+		int			culledObjects;
+		int			matrixRebuilds;			// TransformComponents whose cached matrices were rebuilt last frame
+		bool		batchTransforms = true;		// Moved transforms rebuilt up front in one SIMD batch, see refreshTransforms
+		bool		requestTransformBenchmark = false;	// Set by the GUI, consumed by XOne
+		bool		transformBenchmarked = false;
+		float		transformScalarMs[2];		// 10k and 100k transforms
+		float		transformBatchMs[2];
+		float		transformParallelMs[2];
+		float		transformMaxError;
+		bool		softwareOcclusion = false;	// CPU paths, rasterizes OccluderComponents, see OcclusionBuffer
+		float		softwareOcclusionMs;
+		int			occludedObjects;
+		int			occluderTriangles;
+		int			stressObjects = 0;
+		int			requestStress = -1;		// Object count asked for by the GUI, consumed by XOne
+		bool		stressHierarchy = false;	// Stress objects spawn as one tree, see AvengTransformHierarchy
+		bool		spinHierarchy = true;		// Turn its root every frame, so every node is dirty
+		int			hierarchyNodes;
+		int			hierarchyLevels;
+		int			hierarchyUpdated;
+		float		hierarchyMs;
+
+		// Point lights, see the "Lighting" GUI header
+		bool		clusteredLighting = true;	// Lights assigned to view clusters every frame, see ClusteredLighting
+		bool		animateLights = true;
+		int			requestLights = -1;		// Light count asked for by the GUI, consumed by XOne
+		int			clusterLights = 0;
+		int			clusterIndices;			// Light references across every cluster
+		int			clusterMaxLights;		// In the busiest cluster
+		int			clusterActive;			// Clusters with at least one light
+		bool		clusterOverflowed = false;
+		float		clusterMs;
+		int			lightBillboards;		// Drawn by PointLightSystem, after frustum culling
+		int			culledBillboards;
+		bool		deferredShading = false;	// Chosen at startup with --deferred, see DeferredRenderer
+		float		gpuLightingMs;				// Its lighting pass. The G-buffer pass is gpuObjectMs
+
+		// Dynamic resolution, see the "Resolution" GUI header
+		bool		dynamicResolution = false;	// The forward scene drawn offscreen at a scale following GPU time, see DynamicResolution
+		float		targetFrameMs = 16.6f;
+		float		minResolutionScale = .5f;
+		float		maxResolutionScale = 1.f;
+		bool		sharpenUpscale = true;		// Or plain bilinear
+		float		sharpness = .5f;
+		float		resolutionScale = 1.f;
+		int			renderWidth;
+		int			renderHeight;
+		float		gpuFrameMs = 0.f;			// The whole frame, what the scale follows
+
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "ComputePipeline.h"
+#include "GFXPipeline.h"
+
+#include <cassert>
+#include <stdexcept>
+
+namespace aveng {
+
+	ComputePipeline::ComputePipeline(EngineDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout)
+		: engDevice{ device }
+	{
+		assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline: no pipelineLayout provided");
+
+		auto compCode = GFXPipeline::readFile(compFilepath);
+
+		VkShaderModuleCreateInfo moduleInfo{};
+		moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = compCode.size();
+		moduleInfo.pCode = reinterpret_cast<const uint32_t*>(compCode.data());
+
+		if (vkCreateShaderModule(engDevice.device(), &moduleInfo, nullptr, &compShaderModule) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create shader module.");
+		}
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = compShaderModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = pipelineLayout;
+
+		if (vkCreateComputePipelines(engDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create compute pipeline");
+		}
+	}
+
+	ComputePipeline::~ComputePipeline()
+	{
+		vkDestroyShaderModule(engDevice.device(), compShaderModule, nullptr);
+		vkDestroyPipeline(engDevice.device(), computePipeline, nullptr);
+	}
+
+	void ComputePipeline::bind(VkCommandBuffer commandBuffer)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+	}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "EngineDevice.h"
+
+#include <string>
+
+namespace aveng {
+
+	/**
+	* @class ComputePipeline
+	* A single precompiled compute shader. The layout is owned by the caller,
+	* the same way PipelineConfig::pipelineLayout is for GFXPipeline.
+	*/
+	class ComputePipeline {
+
+		EngineDevice& engDevice;
+		VkPipeline computePipeline;
+		VkShaderModule compShaderModule;
+
+	public:
+
+		ComputePipeline(EngineDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout);
+		~ComputePipeline();
+
+		ComputePipeline(const ComputePipeline&) = delete;
+		ComputePipeline& operator=(const ComputePipeline&) = delete;
+
+		void bind(VkCommandBuffer commandBuffer);
+
+	};
+
+}
@@ -1,4 +1,5 @@
 #include "EngineDevice.h"
+#include "aveng_allocator.h"
 
 #include <cstring>
 #include <iostream>
@@ -77,7 +78,8 @@ namespace aveng {
         // The surface is Vulkan's connection to our Window from GLFW.
         // This calls createWindowSurface from our _window class which is why
         // EnginDevice is constructed with a AvengWindow reference.
-        createSurface();
+        // Headless there's none, and SwapChain renders into images of its own.
+        if (!window.isHeadless()) createSurface();
 
         // Choose your weapon (GPU), or multiple of them (super advanced)
         pickPhysicalDevice();
@@ -87,11 +89,17 @@ namespace aveng {
 
         // For command buffer allocation
         createCommandPool();
+
+        // Device local buffers and images are sub-allocated from large blocks
+        _allocator = std::make_unique<AvengAllocator>(*this);
     }
 
     // Destructor
     EngineDevice::~EngineDevice() 
     {
+        // Deferred frees may still hand memory back to the allocator
+        _deletionQueue.flush();
+        _allocator = nullptr;
         vkDestroyCommandPool(_device, _commandPool, nullptr);
         vkDestroyDevice(_device, nullptr);
 
@@ -100,17 +108,22 @@ namespace aveng {
             DestroyDebugUtilsMessengerEXT(_instance, debugMessenger, nullptr);
         }
 
-          vkDestroySurfaceKHR(_instance, _surface, nullptr);
+          if (_surface != VK_NULL_HANDLE) vkDestroySurfaceKHR(_instance, _surface, nullptr);
           vkDestroyInstance(_instance, nullptr);
     }
 
     void EngineDevice::createInstance() 
     {
 
-        // It's on the tin
+        // It's on the tin. Headless runs are benchmarks on whatever box they land on, so they go without
         if (enableValidationLayers && !checkValidationLayerSupport()) 
         {
-            throw std::runtime_error("validation layers requested, but not available!");
+            if (!window.isHeadless())
+            {
+                throw std::runtime_error("validation layers requested, but not available!");
+            }
+            std::cout << "Headless - running without validation layers" << std::endl;
+            enableValidationLayers = false;
         }
 
         VkApplicationInfo appInfo = {};
@@ -239,8 +252,22 @@ namespace aveng {
         }
 
         // Config - Device features
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(_physicalDevice, &supportedFeatures);
+
         VkPhysicalDeviceFeatures deviceFeatures = {};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
+        // Optional - the indirect draw path uses them when present
+        deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+        deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+        enabledFeatures = deviceFeatures;
+
+        // Required extensions plus whichever optional ones this device has
+        std::vector<const char*> enabledExtensions = requiredDeviceExtensions();
+        bool drawIndirectCount = isDeviceExtensionAvailable(_physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        if (drawIndirectCount) {
+            enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        }
 
         // Config - Core
         VkDeviceCreateInfo createInfo = {};
@@ -250,8 +277,8 @@ namespace aveng {
 
         // Enable features and extensions
         createInfo.pEnabledFeatures = &deviceFeatures;
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
         // [!] This might not really be necessary anymore because
         // device specific validation layers have been deprecated
@@ -272,6 +299,12 @@ namespace aveng {
         // Get a queue handle for each queue family
         vkGetDeviceQueue(_device, indices.graphicsFamily, 0, &_graphicsQueue);
         vkGetDeviceQueue(_device, indices.presentFamily, 0, &_presentQueue);
+
+        // Extension entry points aren't exported by the loader
+        if (drawIndirectCount) {
+            cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+                vkGetDeviceProcAddr(_device, "vkCmdDrawIndexedIndirectCountKHR"));
+        }
     }
 
     void EngineDevice::createCommandPool() {
@@ -309,14 +342,8 @@ namespace aveng {
         // Ensure required extensions are available
         bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-        bool swapChainAdequate = false;
-
         // Query for swapchain support so we can draw to our surface accordingly
-        if (extensionsSupported) 
-        {
-            SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
-            swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
-        }
+        bool swapChainAdequate = extensionsSupported && isSwapChainAdequate(device);
 
         VkPhysicalDeviceFeatures supportedFeatures;
         vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
@@ -344,13 +371,8 @@ namespace aveng {
         // Ensure required extensions are available
         bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-        bool swapChainAdequate = false;
         // Query for swapchain support so we can draw to our surface accordingly
-        if (extensionsSupported)
-        {
-            SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
-            swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
-        }
+        bool swapChainAdequate = extensionsSupported && isSwapChainAdequate(device);
 
         VkPhysicalDeviceFeatures supportedFeatures;
         vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
@@ -443,10 +465,10 @@ namespace aveng {
     {
 
         uint32_t glfwExtensionCount = 0;
-        const char **glfwExtensions;
+        const char **glfwExtensions = nullptr;
 
-        // Collect a list of our required extensions
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        // Collect a list of our required extensions. Headless, GLFW isn't initialized and no surface extensions are needed
+        if (!window.isHeadless()) glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
         std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
 
@@ -514,7 +536,8 @@ namespace aveng {
             availableExtensions.data()
         );
 
-        std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+        std::vector<const char*> required = requiredDeviceExtensions();
+        std::set<std::string> requiredExtensions(required.begin(), required.end());
 
         // Remove names as we find them
         for (const auto &extension : availableExtensions) {
@@ -525,6 +548,20 @@ namespace aveng {
         return requiredExtensions.empty();
     }
 
+    bool EngineDevice::isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName)
+    {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+        for (const auto& extension : availableExtensions) {
+            if (strcmp(extension.extensionName, extensionName) == 0) return true;
+        }
+        return false;
+    }
+
     /**
     * Figure out the queue families supported by the device.
     * In this implementation we require Graphics and Presentation queues
@@ -553,9 +590,11 @@ namespace aveng {
                 indices.graphicsFamilyHasValue = true;
             }
 
-            //  Look for a queue family that has the capability of presenting to our window surface
+            //  Look for a queue family that has the capability of presenting to our window surface.
+            //  Headless nothing is presented, so the graphics queue stands in
             VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, _surface, &presentSupport);
+            if (window.isHeadless()) presentSupport = indices.graphicsFamilyHasValue && indices.graphicsFamily == static_cast<uint32_t>(i);
+            else vkGetPhysicalDeviceSurfaceSupportKHR(device, i, _surface, &presentSupport);
 
             // Find a presentation queue. This could very well be the same thing as the graphics queue
             if (queueFamily.queueCount > 0 && presentSupport) 
@@ -576,6 +615,21 @@ namespace aveng {
       return indices;
     }
 
+    // Something to present with. Headless SwapChain makes its own images, so any device will do
+    bool EngineDevice::isSwapChainAdequate(VkPhysicalDevice device)
+    {
+        if (window.isHeadless()) return true;
+
+        SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
+        return !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+    }
+
+    std::vector<const char*> EngineDevice::requiredDeviceExtensions()
+    {
+        if (window.isHeadless()) return {};
+        return deviceExtensions;
+    }
+
     /*
      * Validate the capabilities of our device for swapchain support.
      * Returns our swapchain details
@@ -694,6 +748,37 @@ namespace aveng {
         vkBindBufferMemory(_device, buffer, bufferMemory, 0);
     }
 
+    /*
+    * @function void EngineDevice::createBuffer
+    * Same as above, except the memory comes out of one of the allocator's
+    * blocks and the buffer is bound at the allocation's offset
+    */
+    void EngineDevice::createBuffer(
+        VkDeviceSize size,
+        VkBufferUsageFlags usage,
+        VkMemoryPropertyFlags properties,
+        VkBuffer &buffer,
+        AvengAllocation &allocation
+    ) {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(_device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) 
+        {
+            throw std::runtime_error("Device failed to create buffer!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(_device, buffer, &memRequirements);
+
+        allocation = _allocator->allocate(memRequirements, properties, true);
+
+        vkBindBufferMemory(_device, buffer, allocation.memory, allocation.offset);
+    }
+
     /*
     * @function beginSingleTimeCommands(void)
     * Allocate a command buffer in memory and return a pointer to it
@@ -739,13 +824,13 @@ namespace aveng {
         vkFreeCommandBuffers(_device, _commandPool, 1, &commandBuffer);
     }
 
-    void EngineDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) 
+    void EngineDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset) 
     {
         VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
         VkBufferCopy copyRegion{};
-        //copyRegion.srcOffset = 0;  // Optional
-        //copyRegion.dstOffset = 0;  // Optional
+        copyRegion.srcOffset = srcOffset;
+        copyRegion.dstOffset = dstOffset;
         copyRegion.size = size;
         vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
@@ -819,4 +904,26 @@ namespace aveng {
         }
     }
 
+    void EngineDevice::createImageWithInfo(
+        const VkImageCreateInfo &imageInfo,
+        VkMemoryPropertyFlags properties,
+        VkImage &image,
+        AvengAllocation &allocation
+    ) {
+        if (vkCreateImage(_device, &imageInfo, nullptr, &image) != VK_SUCCESS) 
+        {
+            throw std::runtime_error("failed to create image!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(_device, image, &memRequirements);
+
+        allocation = _allocator->allocate(memRequirements, properties, imageInfo.tiling == VK_IMAGE_TILING_LINEAR);
+
+        if (vkBindImageMemory(_device, image, allocation.memory, allocation.offset) != VK_SUCCESS) 
+        {
+            throw std::runtime_error("failed to bind image memory!");
+        }
+    }
+
 }  // namespace aveng
\ No newline at end of file
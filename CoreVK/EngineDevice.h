@@ -1,6 +1,8 @@
 #pragma once
 
 #include "../Core/aveng_window.h"
+#include "aveng_deletion_queue.h"
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -21,6 +23,9 @@ namespace aveng {
         bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
     };
 
+    class AvengAllocator;
+    struct AvengAllocation;
+
     class EngineDevice {
 
         VkInstance _instance;
@@ -31,14 +36,17 @@ namespace aveng {
         AvengWindow&    window;
         VkCommandPool   _commandPool;
         VkDevice        _device;
-        VkSurfaceKHR    _surface;
+        VkSurfaceKHR    _surface = VK_NULL_HANDLE;
         VkQueue         _graphicsQueue;
         VkQueue         _presentQueue;
+        std::unique_ptr<AvengAllocator> _allocator;
+        AvengDeletionQueue _deletionQueue;
 
     public:
 
 //#ifdef NDEBUG
-          const bool enableValidationLayers = true;
+          // Headless, dropped when the layers aren't installed rather than failing, see createInstance
+          bool enableValidationLayers = true;
 //#else
 //          const bool enableValidationLayers = true;
 //#endif
@@ -58,8 +66,11 @@ namespace aveng {
         VkCommandPool commandPool()             { return _commandPool; }
         VkDevice device()                       { return _device; }
         VkSurfaceKHR surface()                  { return _surface; }
+        bool isHeadless()                       { return window.isHeadless(); }
         VkQueue graphicsQueue()                 { return _graphicsQueue; }
         VkQueue presentQueue()                  { return _presentQueue; }
+        AvengAllocator& allocator()             { return *_allocator; }
+        AvengDeletionQueue& deletionQueue()     { return _deletionQueue; }
 
 
         SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(_physicalDevice); }
@@ -77,10 +88,19 @@ namespace aveng {
             VkDeviceMemory &bufferMemory
         );
 
+        // Sub-allocated variant for device local memory. See AvengAllocator
+        void createBuffer(
+            VkDeviceSize size,
+            VkBufferUsageFlags usage,
+            VkMemoryPropertyFlags properties,
+            VkBuffer &buffer,
+            AvengAllocation &allocation
+        );
+
         VkCommandBuffer beginSingleTimeCommands();
 
         void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-        void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+        void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
         void copyBufferToImage(
             VkBuffer buffer, 
             VkImage image, 
@@ -96,7 +116,18 @@ namespace aveng {
             VkDeviceMemory &imageMemory
         );
 
+        void createImageWithInfo(
+            const VkImageCreateInfo &imageInfo,
+            VkMemoryPropertyFlags properties,
+            VkImage &image,
+            AvengAllocation &allocation
+        );
+
         VkPhysicalDeviceProperties properties;
+        VkPhysicalDeviceFeatures enabledFeatures{};
+
+        // VK_KHR_draw_indirect_count, nullptr when the device doesn't have it
+        PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
 
     private:
         void createInstance();
@@ -115,7 +146,10 @@ namespace aveng {
         void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
         void hasGflwRequiredInstanceExtensions();
         bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+        bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName);
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
+        bool isSwapChainAdequate(VkPhysicalDevice device);
+        std::vector<const char*> requiredDeviceExtensions();
 
         /*
             Extensions
@@ -123,7 +157,7 @@ namespace aveng {
 
         // Validation layer to be enabled
         const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
-        // Extensions to be enabled
+        // Extensions to be enabled. Headless, there's nothing to present to and none are required
         const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
     };
 
@@ -61,10 +61,11 @@ namespace aveng {
 		void bind(VkCommandBuffer commandBuffer);
 		static void defaultPipelineConfig(PipelineConfig& configInfo);
 
+		// Shared with ComputePipeline
+		static std::vector<char> readFile(const std::string& filepath);
+
 	private:
 
-		// These are both public now...
-		static std::vector<char> readFile(const std::string& filepath);
 		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
 		void createGFXPipeline(const std::string& vertFilepath, const std::string& fragFilepath, const PipelineConfig& config);
 
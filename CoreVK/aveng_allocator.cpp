@@ -0,0 +1,229 @@
+/*
+ * Block based sub-allocator for device local memory.
+ *
+ * Every block keeps an offset-ordered map of free ranges. Allocation is first fit,
+ * and frees coalesce with their neighbours so that long sessions of spawning and
+ * destroying objects don't leave us with thousands of slivers. Whatever fragmentation
+ * remains is cleaned up incrementally by the AvengDefragmenter.
+ */
+
+#include "aveng_allocator.h"
+#include "EngineDevice.h"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+namespace aveng {
+
+    static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return alignment > 1 ? (value + alignment - 1) & ~(alignment - 1) : value;
+    }
+
+    AvengAllocator::AvengAllocator(EngineDevice& device, VkDeviceSize blockSize)
+        : engineDevice{ device }, blockSize{ blockSize }
+    {}
+
+    AvengAllocator::~AvengAllocator()
+    {
+        for (auto& block : blocks)
+        {
+            if (!block->allocations.empty())
+            {
+                std::cout << "[AvengAllocator] Block " << block->id << " destroyed with "
+                    << block->allocations.size() << " live allocations" << std::endl;
+            }
+            vkFreeMemory(engineDevice.device(), block->memory, nullptr);
+        }
+        blocks.clear();
+    }
+
+    AvengAllocator::Block* AvengAllocator::createBlock(VkDeviceSize size, uint32_t memoryTypeIndex, bool linear)
+    {
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+        VkDeviceMemory memory;
+        if (vkAllocateMemory(engineDevice.device(), &allocInfo, nullptr, &memory) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Allocator failed to allocate a memory block!");
+        }
+
+        auto block = std::make_unique<Block>();
+        block->id = nextBlockId++;
+        block->memory = memory;
+        block->size = size;
+        block->memoryTypeIndex = memoryTypeIndex;
+        block->linear = linear;
+        block->freeRanges.emplace(0, size);
+
+        blocks.push_back(std::move(block));
+        return blocks.back().get();
+    }
+
+    AvengAllocator::Block* AvengAllocator::findBlock(uint32_t id)
+    {
+        for (auto& block : blocks)
+        {
+            if (block->id == id) return block.get();
+        }
+        return nullptr;
+    }
+
+    /*
+    * First fit over the block's free ranges. The chosen range is split into
+    * [padding][allocation][remainder], and the padding and remainder go back on the free list.
+    */
+    bool AvengAllocator::allocateFromBlock(Block& block, const VkMemoryRequirements& requirements, AvengAllocation& out)
+    {
+        for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it)
+        {
+            VkDeviceSize rangeOffset = it->first;
+            VkDeviceSize rangeEnd = it->first + it->second;
+            VkDeviceSize offset = alignUp(rangeOffset, requirements.alignment);
+
+            if (offset + requirements.size > rangeEnd) continue;
+
+            block.freeRanges.erase(it);
+            if (offset > rangeOffset)
+            {
+                block.freeRanges.emplace(rangeOffset, offset - rangeOffset);
+            }
+            if (offset + requirements.size < rangeEnd)
+            {
+                block.freeRanges.emplace(offset + requirements.size, rangeEnd - (offset + requirements.size));
+            }
+
+            block.allocations.emplace(offset, Suballocation{ requirements.size, nullptr });
+            block.used += requirements.size;
+
+            out.memory = block.memory;
+            out.offset = offset;
+            out.size = requirements.size;
+            out.blockId = block.id;
+            return true;
+        }
+        return false;
+    }
+
+    /*
+    * Allocate only out of existing blocks, skipping excludedBlocks. Used by the defragmenter,
+    * which must never grow the heap while it is trying to shrink it.
+    */
+    bool AvengAllocator::tryAllocate(
+        const VkMemoryRequirements& requirements,
+        uint32_t memoryTypeIndex,
+        bool linear,
+        const std::unordered_set<uint32_t>& excludedBlocks,
+        AvengAllocation& out
+    ) {
+        for (auto& block : blocks)
+        {
+            if (block->memoryTypeIndex != memoryTypeIndex || block->linear != linear) continue;
+            if (excludedBlocks.count(block->id)) continue;
+            if (block->size - block->used < requirements.size) continue;
+
+            if (allocateFromBlock(*block, requirements, out)) return true;
+        }
+        return false;
+    }
+
+    AvengAllocation AvengAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear)
+    {
+        uint32_t memoryTypeIndex = engineDevice.findMemoryType(requirements.memoryTypeBits, properties);
+
+        AvengAllocation allocation{};
+        if (tryAllocate(requirements, memoryTypeIndex, linear, {}, allocation))
+        {
+            return allocation;
+        }
+
+        // Nothing fits, open a new block. Oversized resources get a block of their own.
+        Block* block = createBlock(std::max(blockSize, requirements.size), memoryTypeIndex, linear);
+        if (!allocateFromBlock(*block, requirements, allocation))
+        {
+            throw std::runtime_error("Allocator failed to sub-allocate from a fresh block!");
+        }
+        return allocation;
+    }
+
+    void AvengAllocator::free(const AvengAllocation& allocation)
+    {
+        if (!allocation.isValid()) return;
+
+        Block* block = findBlock(allocation.blockId);
+        assert(block && "Freeing an allocation from a block that no longer exists");
+
+        auto found = block->allocations.find(allocation.offset);
+        assert(found != block->allocations.end() && "Freeing an allocation twice");
+
+        VkDeviceSize offset = allocation.offset;
+        VkDeviceSize size = found->second.size;
+        block->allocations.erase(found);
+        block->used -= size;
+
+        // Coalesce with the free range that follows...
+        auto next = block->freeRanges.lower_bound(offset);
+        if (next != block->freeRanges.end() && next->first == offset + size)
+        {
+            size += next->second;
+            next = block->freeRanges.erase(next);
+        }
+        // ...and the one that precedes
+        if (next != block->freeRanges.begin())
+        {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == offset)
+            {
+                prev->second += size;
+                return;
+            }
+        }
+        block->freeRanges.emplace(offset, size);
+    }
+
+    void AvengAllocator::setMoveTarget(const AvengAllocation& allocation, AvengMoveTarget* target)
+    {
+        Block* block = findBlock(allocation.blockId);
+        assert(block && "Allocation does not belong to a live block");
+
+        auto found = block->allocations.find(allocation.offset);
+        assert(found != block->allocations.end() && "Allocation is not live");
+        found->second.target = target;
+    }
+
+    void AvengAllocator::freeEmptyBlocks()
+    {
+        blocks.erase(
+            std::remove_if(blocks.begin(), blocks.end(), [this](const std::unique_ptr<Block>& block) {
+                if (!block->allocations.empty()) return false;
+                vkFreeMemory(engineDevice.device(), block->memory, nullptr);
+                return true;
+            }),
+            blocks.end());
+    }
+
+    AvengAllocator::Stats AvengAllocator::getStats() const
+    {
+        Stats stats{};
+        for (auto& block : blocks)
+        {
+            stats.blockCount++;
+            stats.allocationCount += static_cast<uint32_t>(block->allocations.size());
+            stats.freeRangeCount += static_cast<uint32_t>(block->freeRanges.size());
+            stats.reservedBytes += block->size;
+            stats.usedBytes += block->used;
+            for (auto& range : block->freeRanges)
+            {
+                stats.largestFreeRange = std::max(stats.largestFreeRange, range.second);
+            }
+        }
+        return stats;
+    }
+
+}
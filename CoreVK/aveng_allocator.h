@@ -0,0 +1,132 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+namespace aveng {
+
+    class EngineDevice;
+    class AvengDefragmenter;
+
+    /*
+    * A region of a larger VkDeviceMemory block handed out by the AvengAllocator.
+    * Bind resources with (memory, offset), never with offset 0.
+    */
+    struct AvengAllocation {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        uint32_t blockId = UINT32_MAX;
+
+        bool isValid() const { return memory != VK_NULL_HANDLE; }
+    };
+
+    /*
+    * Registered by the owner of an allocation to allow the defragmenter to move it.
+    * Exactly one of buffer / image is set. The defragmenter creates the replacement from the
+    * create info, copies the contents on the GPU, then writes the new handle and allocation
+    * back through these pointers before calling onMoved.
+    */
+    struct AvengMoveTarget {
+        AvengAllocation* allocation = nullptr;
+
+        VkBuffer* buffer = nullptr;
+        VkBufferCreateInfo bufferInfo{};
+
+        VkImage* image = nullptr;
+        VkImageCreateInfo imageInfo{};
+        VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;   // The layout the image rests in between frames
+        VkImageAspectFlags imageAspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+        // Rebuild anything derived from the old handle (views, descriptors). The old handle itself is already queued for deletion.
+        std::function<void()> onMoved;
+    };
+
+    /*
+    * @class AvengAllocator
+    * Sub-allocates device local memory out of large blocks so that we aren't bound by
+    * maxMemoryAllocationCount and so that freed space can be reused and compacted.
+    * Host visible memory is NOT sub-allocated here: a VkDeviceMemory can only be mapped once.
+    */
+    class AvengAllocator {
+    public:
+
+        static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+        struct Stats {
+            uint32_t blockCount = 0;
+            uint32_t allocationCount = 0;
+            uint32_t freeRangeCount = 0;
+            VkDeviceSize reservedBytes = 0;     // Sum of all block sizes
+            VkDeviceSize usedBytes = 0;
+            VkDeviceSize largestFreeRange = 0;
+
+            // 0 when all free space is one contiguous range, approaching 1 as it splinters
+            float fragmentation() const
+            {
+                VkDeviceSize freeBytes = reservedBytes - usedBytes;
+                if (freeBytes == 0) return 0.0f;
+                return 1.0f - static_cast<float>(largestFreeRange) / static_cast<float>(freeBytes);
+            }
+        };
+
+        AvengAllocator(EngineDevice& device, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+        ~AvengAllocator();
+
+        AvengAllocator(const AvengAllocator&) = delete;
+        AvengAllocator& operator=(const AvengAllocator&) = delete;
+
+        // linear = buffers, !linear = optimally tiled images. They never share a block so we can ignore bufferImageGranularity.
+        AvengAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear);
+        void free(const AvengAllocation& allocation);
+
+        // nullptr unregisters
+        void setMoveTarget(const AvengAllocation& allocation, AvengMoveTarget* target);
+
+        void freeEmptyBlocks();
+        Stats getStats() const;
+
+    private:
+
+        struct Suballocation {
+            VkDeviceSize size;
+            AvengMoveTarget* target;
+        };
+
+        struct Block {
+            uint32_t id;
+            VkDeviceMemory memory;
+            VkDeviceSize size;
+            VkDeviceSize used = 0;
+            uint32_t memoryTypeIndex;
+            bool linear;
+            std::map<VkDeviceSize, VkDeviceSize> freeRanges;        // offset -> size, coalesced
+            std::map<VkDeviceSize, Suballocation> allocations;      // offset -> allocation
+        };
+
+        Block* createBlock(VkDeviceSize size, uint32_t memoryTypeIndex, bool linear);
+        Block* findBlock(uint32_t id);
+        bool allocateFromBlock(Block& block, const VkMemoryRequirements& requirements, AvengAllocation& out);
+        bool tryAllocate(
+            const VkMemoryRequirements& requirements,
+            uint32_t memoryTypeIndex,
+            bool linear,
+            const std::unordered_set<uint32_t>& excludedBlocks,
+            AvengAllocation& out
+        );
+
+        EngineDevice& engineDevice;
+        VkDeviceSize blockSize;
+        uint32_t nextBlockId = 0;
+        std::vector<std::unique_ptr<Block>> blocks;
+
+        friend class AvengDefragmenter;
+    };
+
+}
@@ -69,15 +69,53 @@ namespace aveng {
 
         }
 
-        // Call to engineDevice
-        device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+        // Host visible memory needs a VkDeviceMemory of its own so it can be mapped
+        if (memoryPropertyFlags != VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+            device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+            return;
+        }
+
+        // The defragmenter copies out of this buffer when it relocates it
+        this->usageFlags |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        device.createBuffer(bufferSize, this->usageFlags, memoryPropertyFlags, buffer, allocation);
+
+        moveTarget.allocation = &allocation;
+        moveTarget.buffer = &buffer;
+        moveTarget.bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        moveTarget.bufferInfo.size = bufferSize;
+        moveTarget.bufferInfo.usage = this->usageFlags;
+        moveTarget.bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        device.allocator().setMoveTarget(allocation, &moveTarget);
     }
 
+    /*
+    * The buffer may still be referenced by frames in flight, so the handle and
+    * its memory are released through the device's deletion queue instead of right away.
+    */
     AvengBuffer::~AvengBuffer() 
     {
         unmap();
-        vkDestroyBuffer(engineDevice.device(), buffer, nullptr);
-        vkFreeMemory(engineDevice.device(), memory, nullptr);
+
+        VkDevice device = engineDevice.device();
+        VkBuffer oldBuffer = buffer;
+        VkDeviceMemory oldMemory = memory;
+        AvengAllocation oldAllocation = allocation;
+        AvengAllocator* allocator = &engineDevice.allocator();
+
+        // moveTarget dies with us, so the defragmenter must stop seeing it now
+        if (allocation.isValid()) {
+            allocator->setMoveTarget(allocation, nullptr);
+        }
+
+        engineDevice.deletionQueue().push([device, oldBuffer, oldMemory, oldAllocation, allocator]() {
+            vkDestroyBuffer(device, oldBuffer, nullptr);
+            if (oldAllocation.isValid()) {
+                allocator->free(oldAllocation);
+            }
+            else {
+                vkFreeMemory(device, oldMemory, nullptr);
+            }
+        });
     }
 
     /**
@@ -90,6 +128,7 @@ namespace aveng {
      * @return VkResult of the buffer mapping call
      */
     VkResult AvengBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
+        assert(!allocation.isValid() && "Sub-allocated device local buffers cannot be mapped");
         assert(buffer && memory && "Called map on buffer before create");
         return vkMapMemory(engineDevice.device(), memory, offset, size, 0, &mapped);
     }
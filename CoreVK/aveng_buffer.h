@@ -1,12 +1,15 @@
 #pragma once
 
 #include "../CoreVK/EngineDevice.h"
+#include "aveng_allocator.h"
 
 namespace aveng {
 
     /*
     * @class AvengBuffer
     * This class can be used to generate staging, index, uniform and storage buffers.
+    * Purely device local buffers are sub-allocated through the AvengAllocator and may be
+    * relocated by the defragmenter, so always go through getBuffer() instead of caching the handle.
     */
     class AvengBuffer {
     public:
@@ -45,6 +48,7 @@ namespace aveng {
         VkBufferUsageFlags getUsageFlags() const { return usageFlags; }
         VkMemoryPropertyFlags getMemoryPropertyFlags() const { return memoryPropertyFlags; }
         VkDeviceSize getBufferSize() const { return bufferSize; }
+        bool isSuballocated() const { return allocation.isValid(); }
 
     private:
 
@@ -58,6 +62,8 @@ namespace aveng {
         void* mapped = nullptr;
         VkBuffer buffer = VK_NULL_HANDLE;
         VkDeviceMemory memory = VK_NULL_HANDLE;
+        AvengAllocation allocation{};       // Valid only when sub-allocated, in which case memory is unused
+        AvengMoveTarget moveTarget{};
 
         VkDeviceSize bufferSize;
         uint32_t instanceCount;
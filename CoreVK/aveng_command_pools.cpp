@@ -0,0 +1,144 @@
+#include "aveng_command_pools.h"
+#include "swapchain.h"
+
+// std
+#include <stdexcept>
+
+namespace aveng {
+
+    AvengCommandPools::AvengCommandPools(EngineDevice& device) : engineDevice{ device }
+    {
+        framePools.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        cachedPools.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+    }
+
+    AvengCommandPools::~AvengCommandPools()
+    {
+        // Destroying a pool frees its buffers
+        for (auto& pools : framePools)
+        {
+            for (auto& threadPool : pools)
+            {
+                vkDestroyCommandPool(engineDevice.device(), threadPool.pool, nullptr);
+            }
+        }
+        for (auto& cachedPool : cachedPools)
+        {
+            vkDestroyCommandPool(engineDevice.device(), cachedPool.pool, nullptr);
+        }
+    }
+
+    void AvengCommandPools::reserveThreads(uint32_t threadCount)
+    {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = engineDevice.getGraphicsQueueFamily();
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;    // Re-recorded every frame, reset as a whole
+
+        for (auto& pools : framePools)
+        {
+            while (pools.size() < threadCount)
+            {
+                PerThread threadPool{};
+                if (vkCreateCommandPool(engineDevice.device(), &poolInfo, nullptr, &threadPool.pool) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("failed to create secondary command pool!");
+                }
+                pools.push_back(std::move(threadPool));
+            }
+        }
+    }
+
+    void AvengCommandPools::beginFrame(int frameIndex)
+    {
+        for (auto& threadPool : framePools[frameIndex])
+        {
+            if (threadPool.used == 0) continue;
+
+            vkResetCommandPool(engineDevice.device(), threadPool.pool, 0);
+            threadPool.used = 0;
+        }
+    }
+
+    VkCommandBuffer AvengCommandPools::beginSecondary(int frameIndex, uint32_t thread, const VkCommandBufferInheritanceInfo& inheritance)
+    {
+        PerThread& threadPool = framePools[frameIndex][thread];
+
+        if (threadPool.used == threadPool.buffers.size())
+        {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandPool = threadPool.pool;
+            allocInfo.commandBufferCount = 1;
+
+            VkCommandBuffer buffer;
+            if (vkAllocateCommandBuffers(engineDevice.device(), &allocInfo, &buffer) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to allocate secondary command buffer!");
+            }
+            threadPool.buffers.push_back(buffer);
+        }
+
+        VkCommandBuffer commandBuffer = threadPool.buffers[threadPool.used++];
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &inheritance;
+
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to begin recording secondary command buffer!");
+        }
+        return commandBuffer;
+    }
+
+    VkCommandBuffer AvengCommandPools::beginCached(int frameIndex, uint32_t slot, const VkCommandBufferInheritanceInfo& inheritance)
+    {
+        PerThread& cachedPool = cachedPools[frameIndex];
+
+        if (cachedPool.pool == VK_NULL_HANDLE)
+        {
+            VkCommandPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.queueFamilyIndex = engineDevice.getGraphicsQueueFamily();
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;     // vkBeginCommandBuffer resets them one at a time
+
+            if (vkCreateCommandPool(engineDevice.device(), &poolInfo, nullptr, &cachedPool.pool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create cached command pool!");
+            }
+        }
+
+        while (cachedPool.buffers.size() <= slot)
+        {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandPool = cachedPool.pool;
+            allocInfo.commandBufferCount = 1;
+
+            VkCommandBuffer buffer;
+            if (vkAllocateCommandBuffers(engineDevice.device(), &allocInfo, &buffer) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to allocate cached command buffer!");
+            }
+            cachedPool.buffers.push_back(buffer);
+        }
+
+        VkCommandBuffer commandBuffer = cachedPool.buffers[slot];
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        beginInfo.pInheritanceInfo = &inheritance;
+
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to begin recording cached command buffer!");
+        }
+        return commandBuffer;
+    }
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "EngineDevice.h"
+
+// std
+#include <vector>
+
+namespace aveng {
+
+    /*
+    * @class AvengCommandPools
+    * Secondary command buffers for recording one pass from several threads. A command pool may
+    * only be used by one thread at a time, so every thread gets its own pool, and every frame in
+    * flight its own set of them so a frame's buffers can be reset while the other is still executing.
+    * Buffers are allocated on first use and reused every time the frame slot comes around.
+    * Cached buffers live in pools of their own and are only reset when begun again.
+    */
+    class AvengCommandPools {
+    public:
+
+        AvengCommandPools(EngineDevice& device);
+        ~AvengCommandPools();
+
+        AvengCommandPools(const AvengCommandPools&) = delete;
+        AvengCommandPools& operator=(const AvengCommandPools&) = delete;
+
+        // Make sure pools exist for threads [0, threadCount). Not while anything is recording
+        void reserveThreads(uint32_t threadCount);
+
+        // Reset every pool of a frame slot. The slot's fence must have been waited on
+        void beginFrame(int frameIndex);
+
+        /*
+        * The next unused secondary buffer of a thread, begun to continue the render pass described by inheritance.
+        * Only the thread owning the index may call this between beginFrame calls. End it with vkEndCommandBuffer.
+        */
+        VkCommandBuffer beginSecondary(int frameIndex, uint32_t thread, const VkCommandBufferInheritanceInfo& inheritance);
+
+        /*
+        * A secondary buffer that survives beginFrame, for recordings replayed over many frames. Each frame
+        * in flight has its own per slot, so one is never pending twice. Beginning it again discards what it held.
+        * Main thread only.
+        */
+        VkCommandBuffer beginCached(int frameIndex, uint32_t slot, const VkCommandBufferInheritanceInfo& inheritance);
+
+    private:
+
+        struct PerThread {
+            VkCommandPool pool = VK_NULL_HANDLE;
+            std::vector<VkCommandBuffer> buffers;
+            uint32_t used = 0;
+        };
+
+        EngineDevice& engineDevice;
+        std::vector<std::vector<PerThread>> framePools;    // [frame in flight][thread]
+        std::vector<PerThread> cachedPools;                 // [frame in flight], individually resettable buffers
+    };
+
+}
@@ -0,0 +1,371 @@
+/*
+ * Incremental GPU memory defragmentation.
+ *
+ * A pass picks the emptiest blocks of each memory type whose contents fit into the free
+ * space of the others, then every frame moves a few allocations out of them:
+ *
+ *   1. Create a replacement buffer/image from the owner's create info
+ *   2. Bind it to a range in a non-source block
+ *   3. Record the copy plus a barrier ahead of this frame's render pass
+ *   4. Swap the owner's handle and allocation, let the owner patch views and descriptors
+ *   5. Push the old handle and range onto the device's deletion queue
+ *
+ * Because the copy is ordered before the render pass in the same command buffer, the new
+ * handle is valid for everything recorded after step(). Earlier frames still in flight keep
+ * using the old handle, which is why it is deferred rather than destroyed.
+ */
+
+#include "aveng_defragmenter.h"
+
+// std
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+namespace aveng {
+
+    AvengDefragmenter::AvengDefragmenter(EngineDevice& device)
+        : engineDevice{ device }, allocator{ device.allocator() }
+    {}
+
+    /*
+    * Group blocks by memory type and resource kind, then take blocks from the emptiest
+    * upwards for as long as everything taken so far still fits in the rest of the group.
+    * Blocks holding allocations nobody registered as movable are left alone.
+    */
+    bool AvengDefragmenter::planPass()
+    {
+        sourceBlocks.clear();
+
+        std::map<std::pair<uint32_t, bool>, std::vector<AvengAllocator::Block*>> groups;
+        for (auto& block : allocator.blocks)
+        {
+            groups[{ block->memoryTypeIndex, block->linear }].push_back(block.get());
+        }
+
+        bool hasEmptyBlocks = false;
+        for (auto& group : groups)
+        {
+            auto& blocks = group.second;
+            std::sort(blocks.begin(), blocks.end(), [](auto* a, auto* b) { return a->used < b->used; });
+
+            VkDeviceSize groupFree = 0;
+            for (auto* block : blocks) groupFree += block->size - block->used;
+
+            VkDeviceSize planned = 0;
+            for (auto* block : blocks)
+            {
+                if (block->allocations.empty())
+                {
+                    hasEmptyBlocks = true;
+                    groupFree -= block->size;
+                    continue;
+                }
+
+                bool movable = std::all_of(block->allocations.begin(), block->allocations.end(),
+                    [](auto& kv) { return kv.second.target != nullptr; });
+                if (!movable) continue;
+
+                // Leave some slack, alignment padding means the destination free space is never fully usable
+                VkDeviceSize remainingFree = groupFree - (block->size - block->used);
+                if (planned + block->used > remainingFree - remainingFree / 8) break;
+
+                planned += block->used;
+                groupFree = remainingFree;
+                sourceBlocks.insert(block->id);
+            }
+        }
+
+        if (sourceBlocks.empty() && !hasEmptyBlocks) return false;
+
+        statsBefore = allocator.getStats();
+        moveCount = 0;
+        std::cout << "[AvengDefragmenter] Pass started: " << sourceBlocks.size() << " source block(s), fragmentation "
+            << statsBefore.fragmentation() << std::endl;
+        return true;
+    }
+
+    bool AvengDefragmenter::moveBuffer(VkCommandBuffer commandBuffer, AvengMoveTarget& target, uint32_t memoryTypeIndex)
+    {
+        VkDevice device = engineDevice.device();
+
+        VkBuffer newBuffer;
+        if (vkCreateBuffer(device, &target.bufferInfo, nullptr, &newBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Defragmenter failed to create buffer!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(device, newBuffer, &memRequirements);
+
+        AvengAllocation newAllocation{};
+        if (!allocator.tryAllocate(memRequirements, memoryTypeIndex, true, sourceBlocks, newAllocation))
+        {
+            vkDestroyBuffer(device, newBuffer, nullptr);
+            return false;
+        }
+        vkBindBufferMemory(device, newBuffer, newAllocation.memory, newAllocation.offset);
+
+        // Earlier frames may have written the old buffer from a compute shader or a copy (culling outputs, resident instances)
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = *target.buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            0, nullptr,
+            1, &barrier,
+            0, nullptr);
+
+        VkBufferCopy region{};
+        region.size = target.bufferInfo.size;
+        vkCmdCopyBuffer(commandBuffer, *target.buffer, newBuffer, 1, &region);
+
+        // Anything recorded after this may use the new buffer as geometry, shader storage, indirect commands or a copy's source / destination
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+            | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.buffer = newBuffer;
+
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+            | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            0, nullptr,
+            1, &barrier,
+            0, nullptr);
+
+        VkBuffer oldBuffer = *target.buffer;
+        AvengAllocation oldAllocation = *target.allocation;
+        allocator.setMoveTarget(oldAllocation, nullptr);
+
+        *target.buffer = newBuffer;
+        *target.allocation = newAllocation;
+        allocator.setMoveTarget(newAllocation, &target);
+
+        AvengAllocator* alloc = &allocator;
+        engineDevice.deletionQueue().push([device, oldBuffer, oldAllocation, alloc]() {
+            vkDestroyBuffer(device, oldBuffer, nullptr);
+            alloc->free(oldAllocation);
+        });
+
+        if (target.onMoved) target.onMoved();
+        return true;
+    }
+
+    bool AvengDefragmenter::moveImage(VkCommandBuffer commandBuffer, AvengMoveTarget& target, uint32_t memoryTypeIndex)
+    {
+        VkDevice device = engineDevice.device();
+        const VkImageCreateInfo& info = target.imageInfo;
+
+        VkImage newImage;
+        if (vkCreateImage(device, &info, nullptr, &newImage) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Defragmenter failed to create image!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, newImage, &memRequirements);
+
+        AvengAllocation newAllocation{};
+        if (!allocator.tryAllocate(memRequirements, memoryTypeIndex, info.tiling == VK_IMAGE_TILING_LINEAR, sourceBlocks, newAllocation))
+        {
+            vkDestroyImage(device, newImage, nullptr);
+            return false;
+        }
+        vkBindImageMemory(device, newImage, newAllocation.memory, newAllocation.offset);
+
+        VkImageSubresourceRange range{};
+        range.aspectMask = target.imageAspect;
+        range.baseMipLevel = 0;
+        range.levelCount = info.mipLevels;
+        range.baseArrayLayer = 0;
+        range.layerCount = info.arrayLayers;
+
+        // Old image: resting layout -> transfer source, after any sampling by earlier frames
+        // New image: undefined -> transfer destination
+        VkImageMemoryBarrier barriers[2]{};
+        barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barriers[0].oldLayout = target.imageLayout;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].image = *target.image;
+        barriers[0].subresourceRange = range;
+
+        barriers[1] = barriers[0];
+        barriers[1].srcAccessMask = 0;
+        barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[1].image = newImage;
+
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr,
+            0, nullptr,
+            2, barriers);
+
+        // One region per mip level
+        std::vector<VkImageCopy> regions(info.mipLevels);
+        for (uint32_t level = 0; level < info.mipLevels; level++)
+        {
+            VkImageCopy& region = regions[level];
+            region.srcSubresource.aspectMask = target.imageAspect;
+            region.srcSubresource.mipLevel = level;
+            region.srcSubresource.baseArrayLayer = 0;
+            region.srcSubresource.layerCount = info.arrayLayers;
+            region.dstSubresource = region.srcSubresource;
+            region.srcOffset = { 0, 0, 0 };
+            region.dstOffset = { 0, 0, 0 };
+            region.extent = {
+                std::max(1u, info.extent.width >> level),
+                std::max(1u, info.extent.height >> level),
+                std::max(1u, info.extent.depth >> level)
+            };
+        }
+
+        vkCmdCopyImage(commandBuffer,
+            *target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<uint32_t>(regions.size()), regions.data());
+
+        // New image back into the layout the owner expects
+        VkImageMemoryBarrier toResting = barriers[1];
+        toResting.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        toResting.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        toResting.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        toResting.newLayout = target.imageLayout;
+
+        vkCmdPipelineBarrier(commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+            0, nullptr,
+            0, nullptr,
+            1, &toResting);
+
+        VkImage oldImage = *target.image;
+        AvengAllocation oldAllocation = *target.allocation;
+        allocator.setMoveTarget(oldAllocation, nullptr);
+
+        *target.image = newImage;
+        *target.allocation = newAllocation;
+        allocator.setMoveTarget(newAllocation, &target);
+
+        AvengAllocator* alloc = &allocator;
+        engineDevice.deletionQueue().push([device, oldImage, oldAllocation, alloc]() {
+            vkDestroyImage(device, oldImage, nullptr);
+            alloc->free(oldAllocation);
+        });
+
+        if (target.onMoved) target.onMoved();
+        return true;
+    }
+
+    void AvengDefragmenter::step(VkCommandBuffer commandBuffer)
+    {
+        frameCounter++;
+
+        if (state == State::Idle)
+        {
+            bool autoCheck = autoThreshold > 0.0f
+                && frameCounter % autoCheckInterval == 0
+                && allocator.getStats().fragmentation() > autoThreshold;
+
+            if (!passRequested && !autoCheck) return;
+            passRequested = false;
+
+            if (!planPass()) return;
+            state = State::Moving;
+        }
+
+        if (state == State::Moving)
+        {
+            VkDeviceSize bytesMoved = 0;
+            uint32_t movesThisFrame = 0;
+            bool remaining = false;
+
+            // Copy, since failing blocks are dropped from the set as we go
+            std::vector<uint32_t> sources(sourceBlocks.begin(), sourceBlocks.end());
+            for (uint32_t blockId : sources)
+            {
+                AvengAllocator::Block* block = allocator.findBlock(blockId);
+                if (block == nullptr) continue;
+
+                // Moving only rewrites the target pointer of the entry, never the map itself
+                for (auto& kv : block->allocations)
+                {
+                    AvengMoveTarget* target = kv.second.target;
+                    if (target == nullptr) continue;
+
+                    if (movesThisFrame >= maxMovesPerFrame || bytesMoved >= maxBytesPerFrame)
+                    {
+                        remaining = true;
+                        break;
+                    }
+
+                    bool moved = target->buffer != nullptr
+                        ? moveBuffer(commandBuffer, *target, block->memoryTypeIndex)
+                        : moveImage(commandBuffer, *target, block->memoryTypeIndex);
+
+                    if (!moved)
+                    {
+                        // No room anywhere else, this block stays
+                        sourceBlocks.erase(blockId);
+                        break;
+                    }
+
+                    bytesMoved += kv.second.size;
+                    movesThisFrame++;
+                    moveCount++;
+                }
+            }
+
+            if (!remaining && !sourceBlocks.empty())
+            {
+                // Something may have been allocated into a source block mid pass; pick it up next frame
+                for (uint32_t blockId : sourceBlocks)
+                {
+                    AvengAllocator::Block* block = allocator.findBlock(blockId);
+                    if (block == nullptr) continue;
+                    for (auto& kv : block->allocations)
+                    {
+                        if (kv.second.target != nullptr) remaining = true;
+                    }
+                }
+            }
+
+            if (!remaining)
+            {
+                drainFrame = engineDevice.deletionQueue().currentFrame();
+                state = State::Draining;
+            }
+        }
+
+        // Renderer::beginFrame has already collected anything that retired
+        if (state == State::Draining && engineDevice.deletionQueue().hasRetired(drainFrame))
+        {
+            allocator.freeEmptyBlocks();
+            statsAfter = allocator.getStats();
+            sourceBlocks.clear();
+            state = State::Idle;
+
+            std::cout << "[AvengDefragmenter] Pass finished: " << moveCount << " move(s), blocks "
+                << statsBefore.blockCount << " -> " << statsAfter.blockCount << ", fragmentation "
+                << statsBefore.fragmentation() << " -> " << statsAfter.fragmentation() << std::endl;
+        }
+    }
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "EngineDevice.h"
+#include "aveng_allocator.h"
+
+// std
+#include <unordered_set>
+
+namespace aveng {
+
+    /*
+    * @class AvengDefragmenter
+    * Incrementally empties sparsely used allocator blocks by moving their buffers and images
+    * into the free space of fuller blocks. Each frame records at most a budgeted number of GPU
+    * copies into the frame's command buffer, ahead of the render pass, so a pass is spread over
+    * many frames instead of stalling one. Old resources go through the device's deletion queue,
+    * and once they have been released the emptied blocks are handed back to the driver.
+    */
+    class AvengDefragmenter {
+    public:
+
+        AvengDefragmenter(EngineDevice& device);
+
+        AvengDefragmenter(const AvengDefragmenter&) = delete;
+        AvengDefragmenter& operator=(const AvengDefragmenter&) = delete;
+
+        // Start a pass on the next step. No-op while one is already in progress.
+        void requestPass() { passRequested = true; }
+
+        // Must be called between Renderer::beginFrame and beginSwapChainRenderPass
+        void step(VkCommandBuffer commandBuffer);
+
+        bool isRunning() const { return state != State::Idle; }
+        uint32_t getMoveCount() const { return moveCount; }
+        const AvengAllocator::Stats& getStatsBefore() const { return statsBefore; }
+        const AvengAllocator::Stats& getStatsAfter() const { return statsAfter; }
+
+        // Per frame budget
+        VkDeviceSize maxBytesPerFrame = 8ull * 1024 * 1024;
+        uint32_t maxMovesPerFrame = 16;
+
+        // Kick off a pass by ourselves when fragmentation exceeds this. 0 disables.
+        float autoThreshold = 0.5f;
+        uint32_t autoCheckInterval = 600;   // frames
+
+    private:
+
+        enum class State {
+            Idle,
+            Moving,     // Recording copies out of the source blocks
+            Draining    // All moves recorded, waiting on the deletion queue to release the old resources
+        };
+
+        bool planPass();
+        bool moveBuffer(VkCommandBuffer commandBuffer, AvengMoveTarget& target, uint32_t memoryTypeIndex);
+        bool moveImage(VkCommandBuffer commandBuffer, AvengMoveTarget& target, uint32_t memoryTypeIndex);
+
+        EngineDevice& engineDevice;
+        AvengAllocator& allocator;
+
+        State state = State::Idle;
+        bool passRequested = false;
+        uint64_t frameCounter = 0;
+        uint64_t drainFrame = 0;                        // Deletion queue frame of the last move
+        uint32_t moveCount = 0;
+
+        std::unordered_set<uint32_t> sourceBlocks;     // Blocks being emptied by the current pass
+
+        AvengAllocator::Stats statsBefore{};
+        AvengAllocator::Stats statsAfter{};
+    };
+
+}
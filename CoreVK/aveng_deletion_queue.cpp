@@ -0,0 +1,47 @@
+#include "aveng_deletion_queue.h"
+#include "swapchain.h"
+
+namespace aveng {
+
+    AvengDeletionQueue::~AvengDeletionQueue()
+    {
+        flush();
+    }
+
+    void AvengDeletionQueue::push(std::function<void()> destroy)
+    {
+        queue.push_back({ submittedFrames, std::move(destroy) });
+    }
+
+    /*
+    * Frame N is the one being recorded while submittedFrames == N. Its fence is waited on when
+    * frame N + MAX_FRAMES_IN_FLIGHT acquires the same slot, so from then on nothing it recorded is in use.
+    */
+    bool AvengDeletionQueue::hasRetired(uint64_t frame) const
+    {
+        return frame + SwapChain::MAX_FRAMES_IN_FLIGHT <= submittedFrames;
+    }
+
+    void AvengDeletionQueue::collect()
+    {
+        // Entries are pushed in frame order
+        while (!queue.empty() && hasRetired(queue.front().frame))
+        {
+            auto destroy = std::move(queue.front().destroy);
+            queue.pop_front();
+            destroy();
+        }
+    }
+
+    void AvengDeletionQueue::flush()
+    {
+        // A destructor may push more entries (e.g. a model releasing its buffers)
+        while (!queue.empty())
+        {
+            auto destroy = std::move(queue.front().destroy);
+            queue.pop_front();
+            destroy();
+        }
+    }
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+namespace aveng {
+
+    /*
+    * @class AvengDeletionQueue
+    * Defers the destruction of GPU objects until every frame that may have recorded them has retired.
+    * Entries are tagged with the number of frames submitted so far; the Renderer releases them from
+    * beginFrame once it has waited on the fence of the frame MAX_FRAMES_IN_FLIGHT behind.
+    * This is what allows buffers, models and images to be dropped mid-session without a vkDeviceWaitIdle.
+    */
+    class AvengDeletionQueue {
+    public:
+
+        AvengDeletionQueue() = default;
+        ~AvengDeletionQueue();
+
+        AvengDeletionQueue(const AvengDeletionQueue&) = delete;
+        AvengDeletionQueue& operator=(const AvengDeletionQueue&) = delete;
+
+        // Destroy once the frame currently being recorded (and any before it) has retired
+        void push(std::function<void()> destroy);
+
+        // Renderer::endFrame, after the frame's command buffer has been submitted
+        void frameSubmitted() { submittedFrames++; }
+
+        // Renderer::beginFrame, once this frame's in-flight fence has been waited on
+        void collect();
+
+        // Only when the device is idle
+        void flush();
+
+        uint64_t currentFrame() const { return submittedFrames; }
+        bool hasRetired(uint64_t frame) const;
+        size_t pending() const { return queue.size(); }
+
+    private:
+
+        struct Entry {
+            uint64_t frame;
+            std::function<void()> destroy;
+        };
+
+        std::deque<Entry> queue;
+        uint64_t submittedFrames = 0;
+    };
+
+}
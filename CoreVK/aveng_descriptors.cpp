@@ -180,12 +180,15 @@ namespace aveng {
 
     // *************** Descriptor Writer *********************
 
-    AvengDescriptorSetWriter::AvengDescriptorSetWriter(AvengDescriptorSetLayout& setLayout, AvengDescriptorPool& pool)
-        : setLayout{ setLayout }, pool{ pool } {
+    AvengDescriptorSetWriter::AvengDescriptorSetWriter(
+        AvengDescriptorSetLayout& setLayout,
+        AvengDescriptorPool& pool,
+        std::pmr::memory_resource* resource
+    ) : setLayout{ setLayout }, pool{ pool }, writes{ resource } {
         //std::cout << "DescriptorSetWriter Constructing:\t" << setLayout.getDescriptorSetLayoutCount() << std::endl;
     }
 
-    AvengDescriptorSetWriter& AvengDescriptorSetWriter::writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo) 
+    AvengDescriptorSetWriter& AvengDescriptorSetWriter::writeBuffer(uint32_t binding, const VkDescriptorBufferInfo* bufferInfo) 
     {
 
         assert(setLayout.binding_assertions.count(binding) == 1 && "Layout does not contain specified binding");
@@ -207,7 +210,7 @@ namespace aveng {
         return *this;
     }
 
-    AvengDescriptorSetWriter& AvengDescriptorSetWriter::writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo, int nImages) 
+    AvengDescriptorSetWriter& AvengDescriptorSetWriter::writeImage(uint32_t binding, const VkDescriptorImageInfo* imageInfo, int nImages) 
     {
         assert(setLayout.binding_assertions.count(binding) == 1 && "Layout does not contain specified binding");
 
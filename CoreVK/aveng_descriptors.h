@@ -4,6 +4,7 @@
 
 // std
 #include <memory>
+#include <memory_resource>
 #include <unordered_map>
 #include <vector>
 
@@ -121,10 +122,14 @@ namespace aveng {
 
     class AvengDescriptorSetWriter {
     public:
-        AvengDescriptorSetWriter(AvengDescriptorSetLayout& setLayout, AvengDescriptorPool& pool);
+        // Pass the frame arena as resource when writing sets mid-frame
+        AvengDescriptorSetWriter(
+            AvengDescriptorSetLayout& setLayout,
+            AvengDescriptorPool& pool,
+            std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
-        AvengDescriptorSetWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
-        AvengDescriptorSetWriter& writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo, int nImages);
+        AvengDescriptorSetWriter& writeBuffer(uint32_t binding, const VkDescriptorBufferInfo* bufferInfo);
+        AvengDescriptorSetWriter& writeImage(uint32_t binding, const VkDescriptorImageInfo* imageInfo, int nImages);
 
         bool build(VkDescriptorSet& set);
         void overwrite(VkDescriptorSet& set);
@@ -132,7 +137,7 @@ namespace aveng {
     private:
         AvengDescriptorSetLayout& setLayout;
         AvengDescriptorPool& pool;
-        std::vector<VkWriteDescriptorSet> writes;
+        std::pmr::vector<VkWriteDescriptorSet> writes;
     };
 
 }  // namespace Aveng
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "aveng_geometry_arena.h"
+
+// std
+#include <iostream>
+
+namespace aveng {
+
+    AvengGeometryArena::AvengGeometryArena(EngineDevice& device, VkDeviceSize vertexStride, uint32_t maxVertices, uint32_t maxIndices)
+        : engineDevice{ device }, vertexStride{ vertexStride }, maxVertices{ maxVertices }, maxIndices{ maxIndices }
+    {
+        vertexBuffer = std::make_unique<AvengBuffer>(
+            engineDevice,
+            vertexStride,
+            maxVertices,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+        );
+
+        indexBuffer = std::make_unique<AvengBuffer>(
+            engineDevice,
+            sizeof(uint32_t),
+            maxIndices,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+        );
+    }
+
+    bool AvengGeometryArena::upload(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount, Range& range)
+    {
+        if (vertexCount > maxVertices - usedVertices || indexCount > maxIndices - usedIndices)
+        {
+            std::cout << "[AvengGeometryArena] Out of space, mesh keeps its own buffers" << std::endl;
+            return false;
+        }
+
+        VkDeviceSize vertexBytes = vertexStride * vertexCount;
+        VkDeviceSize indexBytes = sizeof(uint32_t) * indexCount;
+
+        // Vertices and indices share one staging buffer
+        AvengBuffer stagingBuffer{
+            engineDevice,
+            vertexBytes + indexBytes,
+            1,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+        };
+        stagingBuffer.map();
+        stagingBuffer.writeToBuffer(const_cast<void*>(vertices), vertexBytes, 0);
+        stagingBuffer.writeToBuffer(const_cast<uint32_t*>(indices), indexBytes, vertexBytes);
+
+        engineDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), vertexBytes, 0, vertexStride * usedVertices);
+        engineDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), indexBytes, vertexBytes, sizeof(uint32_t) * usedIndices);
+
+        range.vertexOffset = static_cast<int32_t>(usedVertices);
+        range.firstIndex = usedIndices;
+        range.indexCount = indexCount;
+
+        usedVertices += vertexCount;
+        usedIndices += indexCount;
+        return true;
+    }
+
+    void AvengGeometryArena::bind(VkCommandBuffer commandBuffer)
+    {
+        // Read every time, the defragmenter may have moved either buffer
+        VkBuffer buffers[] = { vertexBuffer->getBuffer() };
+        VkDeviceSize offsets[] = { 0 };
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+    }
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "EngineDevice.h"
+#include "aveng_buffer.h"
+
+// std
+#include <memory>
+
+namespace aveng {
+
+    /*
+    * @class AvengGeometryArena
+    * One device local vertex buffer and one index buffer shared by many meshes. Each mesh is
+    * uploaded into the next free range and addressed by vertexOffset / firstIndex, so every mesh
+    * in the arena draws with the same buffers bound. That is what lets a whole pass go out as a
+    * single vkCmdDrawIndexedIndirect.
+    * Ranges are never handed back; the arena is meant for meshes that live as long as the app.
+    */
+    class AvengGeometryArena {
+    public:
+
+        struct Range {
+            int32_t vertexOffset = 0;
+            uint32_t firstIndex = 0;
+            uint32_t indexCount = 0;
+        };
+
+        AvengGeometryArena(EngineDevice& device, VkDeviceSize vertexStride, uint32_t maxVertices, uint32_t maxIndices);
+
+        AvengGeometryArena(const AvengGeometryArena&) = delete;
+        AvengGeometryArena& operator=(const AvengGeometryArena&) = delete;
+
+        // false when the mesh does not fit, the caller keeps its own buffers in that case
+        bool upload(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount, Range& range);
+
+        void bind(VkCommandBuffer commandBuffer);
+
+        uint32_t getVertexCount() const { return usedVertices; }
+        uint32_t getIndexCount() const { return usedIndices; }
+
+    private:
+
+        EngineDevice& engineDevice;
+        VkDeviceSize vertexStride;
+        uint32_t maxVertices;
+        uint32_t maxIndices;
+        uint32_t usedVertices = 0;
+        uint32_t usedIndices = 0;
+
+        std::unique_ptr<AvengBuffer> vertexBuffer;
+        std::unique_ptr<AvengBuffer> indexBuffer;
+    };
+
+}
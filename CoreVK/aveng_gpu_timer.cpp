@@ -0,0 +1,98 @@
+#include "aveng_gpu_timer.h"
+#include "swapchain.h"
+
+// std
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+namespace aveng {
+
+    AvengGpuTimer::AvengGpuTimer(EngineDevice& device) : engineDevice{ device }
+    {
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(engineDevice.physicalDevice(), &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(engineDevice.physicalDevice(), &familyCount, families.data());
+
+        uint32_t validBits = families[engineDevice.getGraphicsQueueFamily()].timestampValidBits;
+        supported = validBits > 0 && engineDevice.properties.limits.timestampComputeAndGraphics;
+        if (!supported)
+        {
+            std::cout << "[AvengGpuTimer] Timestamps are not supported on the graphics queue, GPU timings will read 0" << std::endl;
+            return;
+        }
+
+        timestampPeriod = engineDevice.properties.limits.timestampPeriod;
+        validMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = MAX_SCOPES * 2;
+
+        queryPools.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        writtenScopes.resize(SwapChain::MAX_FRAMES_IN_FLIGHT, 0);
+        for (auto& pool : queryPools)
+        {
+            if (vkCreateQueryPool(engineDevice.device(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create timestamp query pool!");
+            }
+        }
+    }
+
+    AvengGpuTimer::~AvengGpuTimer()
+    {
+        for (auto pool : queryPools)
+        {
+            vkDestroyQueryPool(engineDevice.device(), pool, nullptr);
+        }
+    }
+
+    void AvengGpuTimer::beginFrame(VkCommandBuffer commandBuffer, int frameIndex)
+    {
+        if (!supported) return;
+        currentFrame = frameIndex;
+
+        // The last frame recorded into this slot has retired, its queries are available. A scope it
+        // didn't write (a pass skipped that frame) reads 0 rather than keeping an older frame's time
+        results.fill(0.0f);
+        uint32_t written = writtenScopes[frameIndex];
+        for (uint32_t scope = 0; written != 0 && scope < MAX_SCOPES; scope++)
+        {
+            if (!(written & (1u << scope))) continue;
+
+            uint64_t ticks[2];
+            VkResult result = vkGetQueryPoolResults(
+                engineDevice.device(), queryPools[frameIndex],
+                scope * 2, 2,
+                sizeof(ticks), ticks, sizeof(uint64_t),
+                VK_QUERY_RESULT_64_BIT);
+
+            if (result == VK_SUCCESS)
+            {
+                uint64_t elapsed = ((ticks[1] & validMask) - (ticks[0] & validMask)) & validMask;
+                results[scope] = static_cast<float>(elapsed) * timestampPeriod / 1000000.0f;
+            }
+        }
+
+        writtenScopes[frameIndex] = 0;
+        vkCmdResetQueryPool(commandBuffer, queryPools[frameIndex], 0, MAX_SCOPES * 2);
+    }
+
+    void AvengGpuTimer::begin(VkCommandBuffer commandBuffer, uint32_t scope)
+    {
+        if (!supported) return;
+        assert(scope < MAX_SCOPES && "GPU timer scope out of range");
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPools[currentFrame], scope * 2);
+    }
+
+    void AvengGpuTimer::end(VkCommandBuffer commandBuffer, uint32_t scope)
+    {
+        if (!supported) return;
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPools[currentFrame], scope * 2 + 1);
+        writtenScopes[currentFrame] |= 1u << scope;
+    }
+
+}
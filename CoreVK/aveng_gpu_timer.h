@@ -0,0 +1,51 @@
+#pragma once
+
+#include "EngineDevice.h"
+
+// std
+#include <array>
+#include <vector>
+
+namespace aveng {
+
+    /*
+    * @class AvengGpuTimer
+    * Timestamp queries around named scopes of the frame. Each frame in flight has its own
+    * query pool, read back when that frame slot comes around again (its fence has been waited on),
+    * so results lag MAX_FRAMES_IN_FLIGHT frames behind but never stall the CPU.
+    */
+    class AvengGpuTimer {
+    public:
+
+        static constexpr uint32_t MAX_SCOPES = 16;
+
+        AvengGpuTimer(EngineDevice& device);
+        ~AvengGpuTimer();
+
+        AvengGpuTimer(const AvengGpuTimer&) = delete;
+        AvengGpuTimer& operator=(const AvengGpuTimer&) = delete;
+
+        // Once per frame, before any scope is recorded and outside of a render pass
+        void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+
+        void begin(VkCommandBuffer commandBuffer, uint32_t scope);
+        void end(VkCommandBuffer commandBuffer, uint32_t scope);
+
+        // Duration of a scope in the latest resolved frame, 0 if that frame didn't record it
+        float milliseconds(uint32_t scope) const { return results[scope]; }
+        bool isSupported() const { return supported; }
+
+    private:
+
+        EngineDevice& engineDevice;
+        std::vector<VkQueryPool> queryPools;        // One per frame in flight
+        std::vector<uint32_t> writtenScopes;        // Bit per scope recorded in that frame slot
+        std::array<float, MAX_SCOPES> results{};
+
+        float timestampPeriod = 1.0f;               // Nanoseconds per tick
+        uint64_t validMask = ~0ull;
+        bool supported = false;
+        int currentFrame = 0;
+    };
+
+}
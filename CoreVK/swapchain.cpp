@@ -29,7 +29,12 @@ namespace aveng {
 
     void SwapChain::init()
     {
-        createSwapChain();
+        static uint64_t nextId = 0;
+        id = ++nextId;
+        headless = device.isHeadless();
+
+        if (headless) createOffscreenImages();
+        else createSwapChain();
         createImageViews();
         createRenderPass();
         createDepthResources();
@@ -50,6 +55,12 @@ namespace aveng {
             swapChain = nullptr;
         }
 
+        // Headless the images are ours, not the swap chain's
+        for (size_t i = 0; i < offscreenImageMemorys.size(); i++) {
+            vkDestroyImage(device.device(), swapChainImages[i], nullptr);
+            vkFreeMemory(device.device(), offscreenImageMemorys[i], nullptr);
+        }
+
         for (int i = 0; i < depthImages.size(); i++) {
             vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
             vkDestroyImage(device.device(), depthImages[i], nullptr);
@@ -61,6 +72,7 @@ namespace aveng {
         }
 
         vkDestroyRenderPass(device.device(), renderPass, nullptr);
+        vkDestroyRenderPass(device.device(), loadRenderPass, nullptr);
 
         // cleanup synchronization objects
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
@@ -81,6 +93,12 @@ namespace aveng {
             std::numeric_limits<uint64_t>::max()
         );
 
+        // Headless each frame slot has its own image, free now that the slot's fence has signaled
+        if (headless) {
+            *imageIndex = static_cast<uint32_t>(currentFrame);
+            return VK_SUCCESS;
+        }
+
         // Acquire an image from the swap chain
         VkResult result = vkAcquireNextImageKHR(
             device.device(),
@@ -107,9 +125,10 @@ namespace aveng {
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
+        // Headless nothing was acquired and nothing will be presented, the fence is all there is
         VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
         VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.waitSemaphoreCount = headless ? 0 : 1;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
 
@@ -117,7 +136,7 @@ namespace aveng {
         submitInfo.pCommandBuffers = buffers;
 
         VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.signalSemaphoreCount = headless ? 0 : 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
         vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
@@ -127,6 +146,11 @@ namespace aveng {
             throw std::runtime_error("failed to submit draw command buffer!");
         }
 
+        if (headless) {
+            currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+            return VK_SUCCESS;
+        }
+
         VkPresentInfoKHR presentInfo = {};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
@@ -208,6 +232,38 @@ namespace aveng {
         swapChainExtent = extent;
     }
 
+    /*
+    * Stand-ins for swap chain images, at the extent asked for. An sRGB format when the device can
+    * render to one, as chooseSwapSurfaceFormat prefers, so shaders write what they would on screen.
+    */
+    void SwapChain::createOffscreenImages()
+    {
+        swapChainImageFormat = device.findSupportedFormat(
+            { VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM },
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT);
+        swapChainExtent = windowExtent;
+
+        swapChainImages.resize(MAX_FRAMES_IN_FLIGHT);
+        offscreenImageMemorys.resize(MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < swapChainImages.size(); i++) {
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent = { swapChainExtent.width, swapChainExtent.height, 1 };
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = swapChainImageFormat;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;      // Copied out to check a frame
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, swapChainImages[i], offscreenImageMemorys[i]);
+        }
+    }
+
     VkImageView SwapChain::createImageView(VkImage image, VkFormat format)
     {
         VkImageViewCreateInfo viewInfo{};
@@ -243,7 +299,7 @@ namespace aveng {
         depthAttachment.format = findDepthFormat();
         depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
         depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;             // Read back by the Hi-Z pyramid and loadRenderPass
         depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -261,7 +317,7 @@ namespace aveng {
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;          // Required to display to the screen
+        colorAttachment.finalLayout = colorFinalLayout();                       // Required to display to the screen
 
         VkAttachmentReference colorAttachmentRef = {};
         colorAttachmentRef.attachment = 0;
@@ -297,6 +353,30 @@ namespace aveng {
         if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
             throw std::runtime_error("failed to create render pass!");
         }
+
+        /*
+        * Picks up where renderPass left off, so a frame can step out of the render pass (i.e. to run
+        * compute over its depth buffer) and come back in. Load ops and layouts don't take part in
+        * render pass compatibility, so pipelines and framebuffers made for renderPass work with it.
+        */
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        colorAttachment.initialLayout = colorFinalLayout();
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        attachments = { colorAttachment, depthAttachment };
+
+        dependency.srcStageMask =
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependency.dstStageMask =
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.dstAccessMask =
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &loadRenderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render pass!");
+        }
     }
 
     void SwapChain::createFramebuffers() 
@@ -331,6 +411,11 @@ namespace aveng {
         depthImageMemorys.resize(imageCount());
         depthImageViews.resize(imageCount());
 
+        // Sampling the depth buffer is optional, passes that need it check DepthTarget::sampleable
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(device.physicalDevice(), depthFormat, &formatProperties);
+        depthSampleable = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+
         for (int i = 0; i < depthImages.size(); i++) {
             VkImageCreateInfo imageInfo{};
             imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -343,7 +428,7 @@ namespace aveng {
             imageInfo.format = depthFormat;
             imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
             imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (depthSampleable ? VK_IMAGE_USAGE_SAMPLED_BIT : 0);
             imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
             imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
             imageInfo.flags = 0;
@@ -455,6 +540,11 @@ namespace aveng {
         }
     }
 
+    SwapChain::DepthTarget SwapChain::getDepthTarget(int index)
+    {
+        return { depthImages[index], depthImageViews[index], swapChainDepthFormat, swapChainExtent, depthSampleable, id };
+    }
+
     VkFormat SwapChain::findDepthFormat() 
     {
         return device.findSupportedFormat(
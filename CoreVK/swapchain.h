@@ -13,10 +13,26 @@
 
 namespace aveng {
 
+    /*
+    * Headless (see EngineDevice::isHeadless) there's no surface to present to. The swap chain then owns
+    * MAX_FRAMES_IN_FLIGHT offscreen color images, one per frame slot, left in TRANSFER_SRC_OPTIMAL at the
+    * end of the render pass. Acquiring waits on the slot's fence and hands out the slot's image, and
+    * submitting skips the semaphores and the present, so frames are paced by the fences alone.
+    */
     class SwapChain {
     public:
         static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
 
+        // The depth buffer of one swap chain image, for passes that read it back
+        struct DepthTarget {
+            VkImage image;
+            VkImageView view;
+            VkFormat format;
+            VkExtent2D extent;
+            bool sampleable;        // Created with VK_IMAGE_USAGE_SAMPLED_BIT
+            uint64_t swapChainId;   // Changes whenever the swap chain is recreated
+        };
+
         SwapChain(EngineDevice& deviceRef, VkExtent2D windowExtent);
         SwapChain(EngineDevice& deviceRef, VkExtent2D windowExtent, std::shared_ptr<SwapChain> previous);
         ~SwapChain();
@@ -28,6 +44,7 @@ namespace aveng {
         uint32_t            height() { return swapChainExtent.height; }
         size_t              imageCount() { return swapChainImages.size(); }
         VkRenderPass        getRenderPass() { return renderPass; }
+        VkRenderPass        getLoadRenderPass() { return loadRenderPass; }
         VkExtent2D          getSwapChainExtent() { return swapChainExtent; }
         VkFormat            getSwapChainImageFormat() { return swapChainImageFormat; }
         VkFramebuffer       getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
@@ -37,6 +54,7 @@ namespace aveng {
         VkImage&             getImage(int index) { return swapChainImages[index]; }
         size_t               swapChainImagesSize() { return swapChainImages.size(); }
         std::vector<VkImageView>& getSwapChainImageViews() { return swapChainImageViews; }
+        DepthTarget          getDepthTarget(int index);
 
         VkResult            submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
         VkResult            acquireNextImage(uint32_t* imageIndex);
@@ -58,6 +76,7 @@ namespace aveng {
     private:
         void init();
         void createSwapChain();
+        void createOffscreenImages();
         void createImageViews();
         void createDepthResources();
         void createRenderPass();
@@ -70,6 +89,8 @@ namespace aveng {
         VkPresentModeKHR chooseSwapPresentMode(
             const std::vector<VkPresentModeKHR>& availablePresentModes);
         VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
+        // What the render pass leaves the color attachment in for whoever takes it next
+        VkImageLayout colorFinalLayout() const { return headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; }
 
         VkFormat swapChainImageFormat;
         VkFormat swapChainDepthFormat;
@@ -77,17 +98,22 @@ namespace aveng {
 
         std::vector<VkFramebuffer> swapChainFramebuffers;
         VkRenderPass renderPass;
+        VkRenderPass loadRenderPass;       // Same attachments, loaded instead of cleared. Compatible with renderPass
 
         std::vector<VkImage> depthImages;
         std::vector<VkDeviceMemory> depthImageMemorys;
         std::vector<VkImageView> depthImageViews;
+        bool depthSampleable = false;
+        uint64_t id;
         std::vector<VkImage> swapChainImages;
         std::vector<VkImageView> swapChainImageViews;
+        std::vector<VkDeviceMemory> offscreenImageMemorys;     // Headless, backing swapChainImages
+        bool headless = false;
 
         EngineDevice& device;
         VkExtent2D windowExtent;
 
-        VkSwapchainKHR swapChain;
+        VkSwapchainKHR swapChain = VK_NULL_HANDLE;
         std::shared_ptr<SwapChain> oldSwapChain;
 
         std::vector<VkSemaphore> imageAvailableSemaphores;
@@ -81,9 +81,11 @@ namespace aveng {
 
         // Cleanup the font object
         ImGui_ImplVulkan_DestroyFontUploadObjects();
+        initialized = true;
     }
 
     AvengImgui::~AvengImgui() {
+        if (!initialized) return;
         vkDestroyDescriptorPool(device.device(), descriptorPool, nullptr);
         ImGui_ImplVulkan_Shutdown();
         ImGui_ImplGlfw_Shutdown();
@@ -158,6 +160,134 @@ namespace aveng {
                 "Frame = %.3f ms/frame (%.1f FPS)",
                 1000.0f / ImGui::GetIO().Framerate,
             ImGui::GetIO().Framerate);
+
+            ImGui::Text("Heap allocs/frame: %d\tArena used: %.1f KB", data.heapAllocs, data.arenaKB);
+
+            if (ImGui::CollapsingHeader("GPU Memory")) {
+                ImGui::Text("Blocks: %d", data.gpuBlocks);
+                ImGui::Text("Used / Reserved:\t%.2f / %.2f MB", data.gpuUsedMB, data.gpuReservedMB);
+                ImGui::Text("Fragmentation:\t%.3f", data.gpuFragmentation);
+                ImGui::Text("Last pass:\t%.3f -> %.3f (%d moves)", data.defragBefore, data.defragAfter, data.defragMoves);
+                if (data.defragRunning)
+                    ImGui::Text("Defragmenting...");
+                else if (ImGui::Button("Defragment"))
+                    data.requestDefrag = true;
+            }
+
+            if (ImGui::CollapsingHeader("Object Pass")) {
+                ImGui::RadioButton("Per object", &data.drawMode, DRAW_PER_OBJECT);
+                ImGui::SameLine();
+                ImGui::RadioButton("Instanced", &data.drawMode, DRAW_INSTANCED);
+                ImGui::SameLine();
+                ImGui::RadioButton("Indirect", &data.drawMode, DRAW_INDIRECT);
+                ImGui::SameLine();
+                ImGui::RadioButton("GPU culled", &data.drawMode, DRAW_GPU_CULLED);
+                ImGui::Text("Draw calls: %d\tIndirect commands: %d", data.drawCalls, data.indirectCommands);
+                ImGui::Text("Binds - pipeline: %d\ttexture: %d\tmesh: %d", data.pipelineBinds, data.textureBinds, data.meshBinds);
+                ImGui::Checkbox("Depth pre-pass", &data.depthPrepass);
+                if (data.drawMode == DRAW_PER_OBJECT) {
+                    ImGui::Checkbox("Parallel recording", &data.parallelRecording);
+                    ImGui::SameLine();
+                    ImGui::Text("Recording threads: %d", data.recordThreads);
+                    ImGui::Checkbox("Cache static objects", &data.cacheStatic);
+                    ImGui::SameLine();
+                    ImGui::Text("Static: %d\tRe-recorded: %d", data.staticObjects, data.staticRecords);
+                }
+                ImGui::Checkbox("Frustum culling", &data.frustumCulling);
+                if (data.drawMode == DRAW_GPU_CULLED) {
+                    ImGui::SameLine();
+                    ImGui::Checkbox("Occlusion culling", &data.occlusionCulling);
+                    ImGui::Text("Late pass: %d", data.lateObjects);
+                }
+                else {
+                    ImGui::SameLine();
+                    ImGui::Checkbox("Software occlusion", &data.softwareOcclusion);
+                    if (data.softwareOcclusion)
+                        ImGui::Text("Occluded: %d\tOccluder triangles: %d\t%.3f ms", data.occludedObjects, data.occluderTriangles, data.softwareOcclusionMs);
+                }
+                ImGui::Text("Visible: %d\tCulled: %d", data.visibleObjects, data.culledObjects);
+                ImGui::Text("Static batches: %d, from %d pieces", data.staticBatches, data.batchedObjects);
+                ImGui::Text("Matrix rebuilds: %d", data.matrixRebuilds);
+                ImGui::SameLine();
+                ImGui::Checkbox("Batch transforms", &data.batchTransforms);
+                if (ImGui::Button("Benchmark transforms")) data.requestTransformBenchmark = true;
+                if (data.transformBenchmarked) {
+                    ImGui::Text("10k  - scalar: %.3f ms\tbatch: %.3f ms\tthreaded: %.3f ms", data.transformScalarMs[0], data.transformBatchMs[0], data.transformParallelMs[0]);
+                    ImGui::Text("100k - scalar: %.3f ms\tbatch: %.3f ms\tthreaded: %.3f ms", data.transformScalarMs[1], data.transformBatchMs[1], data.transformParallelMs[1]);
+                    ImGui::Text("Max difference: %g", data.transformMaxError);
+                }
+                ImGui::Text("CPU record:\t%.3f ms", data.cpuRecordMs);
+                if (data.gpuTimestamps)
+                {
+                    ImGui::Text("GPU:\t\t%.3f ms", data.gpuObjectMs);
+                    if (data.depthPrepass)
+                        ImGui::Text("GPU pre-pass:\t%.3f ms\t(%.3f ms with the object pass)", data.gpuPrepassMs, data.gpuPrepassMs + data.gpuObjectMs);
+                    if (data.drawMode == DRAW_GPU_CULLED)
+                    {
+                        ImGui::Text("GPU cull:\t%.3f ms", data.gpuCullMs);
+                        ImGui::Text("GPU Hi-Z + late:\t%.3f ms", data.gpuOcclusionMs);
+                    }
+                }
+                else
+                    ImGui::Text("GPU:\t\tno timestamp support");
+
+                ImGui::Text("Stress objects: %d", data.stressObjects);
+                if (ImGui::Button("1k"))   data.requestStress = 1000;
+                ImGui::SameLine();
+                if (ImGui::Button("10k"))  data.requestStress = 10000;
+                ImGui::SameLine();
+                if (ImGui::Button("100k")) data.requestStress = 100000;
+                ImGui::SameLine();
+                if (ImGui::Button("Clear")) data.requestStress = 0;
+                ImGui::Checkbox("As a hierarchy", &data.stressHierarchy);
+                ImGui::SameLine();
+                ImGui::Checkbox("Spin root", &data.spinHierarchy);
+                ImGui::Text("Hierarchy - nodes: %d\tdepth: %d\tupdated: %d\t%.3f ms", data.hierarchyNodes, data.hierarchyLevels, data.hierarchyUpdated, data.hierarchyMs);
+            }
+
+            if (ImGui::CollapsingHeader("Lighting")) {
+                ImGui::Checkbox("Clustered point lights", &data.clusteredLighting);
+                ImGui::SameLine();
+                ImGui::Checkbox("Animate", &data.animateLights);
+                if (ImGui::Button("256"))  data.requestLights = 256;
+                ImGui::SameLine();
+                if (ImGui::Button("1024")) data.requestLights = 1024;
+                ImGui::SameLine();
+                if (ImGui::Button("4096")) data.requestLights = 4096;
+                ImGui::SameLine();
+                if (ImGui::Button("None")) data.requestLights = 0;
+                ImGui::Text("Billboards drawn: %d\tCulled: %d", data.lightBillboards, data.culledBillboards);
+                if (data.deferredShading) {
+                    ImGui::Text("Shading: deferred");
+                    if (data.gpuTimestamps)
+                        ImGui::Text("GPU G-buffer: %.3f ms\tLighting: %.3f ms", data.gpuObjectMs, data.gpuLightingMs);
+                }
+                else
+                    ImGui::Text("Shading: forward (--deferred to compare)");
+                if (data.clusteredLighting) {
+                    ImGui::Text("Lights: %d\tAssign: %.3f ms", data.clusterLights, data.clusterMs);
+                    ImGui::Text("Clusters lit: %d\tLight refs: %d\tBusiest: %d", data.clusterActive, data.clusterIndices, data.clusterMaxLights);
+                    if (data.clusterOverflowed)
+                        ImGui::Text("Light lists overflowed, some were cut short");
+                }
+            }
+
+            if (ImGui::CollapsingHeader("Resolution")) {
+                ImGui::Checkbox("Dynamic resolution", &data.dynamicResolution);
+                ImGui::SliderFloat("Target frame (ms)", &data.targetFrameMs, 4.f, 50.f);
+                ImGui::SliderFloat("Min scale", &data.minResolutionScale, .25f, data.maxResolutionScale);
+                ImGui::SliderFloat("Max scale", &data.maxResolutionScale, data.minResolutionScale, 1.f);
+                ImGui::Checkbox("Sharpen", &data.sharpenUpscale);
+                ImGui::SameLine();
+                ImGui::SliderFloat("Sharpness", &data.sharpness, 0.f, 1.f);
+                ImGui::Text("Scale: %.3f\tDrawn at: %d x %d", data.resolutionScale, data.renderWidth, data.renderHeight);
+                if (data.gpuTimestamps)
+                    ImGui::Text("GPU frame: %.3f ms", data.gpuFrameMs);
+                else
+                    ImGui::Text("No GPU timestamps, the scale stays put");
+                if (data.deferredShading)
+                    ImGui::Text("Forward shading only, deferred draws at full resolution");
+            }
             //ImGui::Text("c = %d", counter);
             ImGui::End();
         }
@@ -42,5 +42,6 @@ namespace aveng {
 	private:
 		EngineDevice& device;
 		VkDescriptorPool descriptorPool;
+		bool initialized = false;		// Headless runs never init, there's no window to drive it
 	};
 }  // namespace lve
\ No newline at end of file
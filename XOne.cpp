@@ -8,6 +8,10 @@
 #include "Core/Events/window_callbacks.h"
 #include "Core/Player/GameplayFunctions.h"
 
+#include <algorithm>
+#include <iomanip>
+#include <random>
+
 namespace aveng {
 
 	// Dynamic Helpers on window callback keys
@@ -18,17 +22,30 @@ namespace aveng {
 	bool WindowCallbacks::flightMode = false;
 	float WindowCallbacks::modPI = PI;
 
-	XOne::XOne() 
+	XOne::XOne(const AppOptions& appOptions) : options{ appOptions }
 	{
 		loadAppObjects();
 		Setup();
-		
+
+		// Picked up by the first frame as if the GUI had asked
+		data.requestStress = options.stressObjects;
+		data.requestLights = options.lights;
 	}
 
 	void XOne::run()
 	{
+		// Headless, the loop runs a fixed number of frames with no input and no GUI, timing each
+		bool headless = aveng_window.isHeadless();
+		int framesRendered = 0;
+		FrameTimings timings;
+		if (headless) {
+			timings.cpuFrameMs.reserve(options.headlessFrames);
+			timings.cpuRecordMs.reserve(options.headlessFrames);
+			timings.gpuFrameMs.reserve(options.headlessFrames);
+		}
+
 		// Set callback functions for keys bound to the window
-		glfwSetKeyCallback(aveng_window.getGLFWwindow(), WindowCallbacks::testKeyCallback);
+		if (!headless) glfwSetKeyCallback(aveng_window.getGLFWwindow(), WindowCallbacks::testKeyCallback);
 
 		//camera.setViewTarget(glm::vec3(-1.f, -2.f, -20.f), glm::vec3(0.f, 0.f, 3.5f));
 
@@ -38,11 +55,21 @@ namespace aveng {
 		viewerObject.transform.translation.z = -5.5f;
 		viewerObject.transform.translation.y = -2.5f;
 
+		uint64_t heapAllocations = heapAllocationCount();
+
+		auto runStart = std::chrono::high_resolution_clock::now();
+
 		// Render Loop
-		while (!aveng_window.shouldClose()) {
+		while (!aveng_window.shouldClose() && !(headless && framesRendered >= options.headlessFrames)) {
+
+			// Everything handed out last frame is dead by now
+			data.heapAllocs = static_cast<int>(heapAllocationCount() - heapAllocations);
+			data.arenaKB    = frameArena.used() / 1024.f;
+			heapAllocations = heapAllocationCount();
+			frameArena.reset();
 
 			// Potentially blocking
-			glfwPollEvents();
+			if (!headless) glfwPollEvents();
 
 			// Calculate time between iterations
 			auto newTime = std::chrono::high_resolution_clock::now();
@@ -53,6 +80,38 @@ namespace aveng {
 			updateCamera(frameTime, viewerObject, keyboardController, camera);
 			updateData();
 
+			// Benchmark objects asked for by the GUI
+			if (data.requestStress >= 0) {
+				spawnStressTest(data.requestStress);
+				data.requestStress = -1;
+			}
+
+			if (data.requestLights >= 0) {
+				spawnLights(data.requestLights);
+				data.requestLights = -1;
+			}
+			if (data.animateLights) animateLights(frameTime);
+
+			if (data.requestTransformBenchmark) {
+				runTransformBenchmark();
+				data.requestTransformBenchmark = false;
+			}
+
+			// Turning the root of the stress tree moves every node under it
+			if (stressLinked && data.spinHierarchy) {
+				scene.get<TransformComponent>(stressEntities.front()).rotate(glm::angleAxis(.25f * frameTime, glm::vec3{ 0.f, 1.f, 0.f }));
+			}
+
+			// Children's world matrices, parents first
+			auto hierarchyStart = std::chrono::high_resolution_clock::now();
+			data.hierarchyUpdated = static_cast<int>(hierarchy.update(scene, &workers));
+			data.hierarchyMs      = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - hierarchyStart).count();
+			data.hierarchyNodes   = static_cast<int>(hierarchy.nodeCount());
+			data.hierarchyLevels  = static_cast<int>(hierarchy.levelCount());
+
+			// Every transform that moved since last frame, in one batch rather than one at a time as they're drawn
+			if (data.batchTransforms) refreshTransforms(scene, &workers, &frameArena);
+
 			// Get a command buffer for this frame
 			VkCommandBuffer commandBuffer = renderer.beginFrame();
 
@@ -60,6 +119,8 @@ namespace aveng {
 
 				int frameIndex = renderer.getFrameIndex();
 
+				if (data.drawMode == DRAW_PER_OBJECT) ensureObjectBufferCapacity(frameIndex);
+
 				FrameContent frame_content = {
 					frameIndex,
 					frameTime,
@@ -67,29 +128,166 @@ namespace aveng {
 					camera,
 					globalDescriptorSets[frameIndex],
 					objectDescriptorSets[frameIndex],
-					appObjects
+					scene,
+					&frameArena,
+					&workers
 				};
 
 				// Pack our vertex shader uniform buffer
 				u_GlobalData.projection = camera.getProjection();
 				u_GlobalData.view = camera.getView();
 
+				// Point lights into this frame's clusters, the grid's description goes out with the rest of the UBO
+				u_GlobalData.clusterGrid = glm::uvec4{ LightClusterGrid::X, LightClusterGrid::Y, LightClusterGrid::Z, 0u };
+				if (data.clusteredLighting) {
+					auto clusterStart = std::chrono::high_resolution_clock::now();
+					LightClusterStats clusterStats = clusteredLighting.update(
+						frameIndex, scene, camera.getView(), camera.getProjection(), NEAR_PLANE, FAR_PLANE, &workers, &frameArena);
+					data.clusterMs         = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - clusterStart).count();
+					data.clusterLights     = static_cast<int>(clusterStats.lights);
+					data.clusterIndices    = static_cast<int>(clusterStats.indices);
+					data.clusterMaxLights  = static_cast<int>(clusterStats.maxPerCluster);
+					data.clusterActive     = static_cast<int>(clusterStats.activeClusters);
+					data.clusterOverflowed = clusterStats.overflowed;
+					u_GlobalData.clusterGrid.w = clusterStats.lights;
+				}
+				// Scaled, the forward scene is drawn at a fraction of the swap chain's extent that follows GPU time
+				bool scaled = data.dynamicResolution && !options.deferred;
+				if (scaled) dynamicResolution.update(data.gpuFrameMs, data.targetFrameMs, data.minResolutionScale, data.maxResolutionScale);
+				VkExtent2D extent = scaled ? dynamicResolution.renderExtent(renderer.getSwapChainExtent()) : renderer.getSwapChainExtent();
+				data.resolutionScale = scaled ? dynamicResolution.getScale() : 1.f;
+				data.renderWidth     = static_cast<int>(extent.width);
+				data.renderHeight    = static_cast<int>(extent.height);
+
+				const LightClusterGrid& clusterGrid = clusteredLighting.getGrid();
+				u_GlobalData.clusterParams = glm::vec4{ clusterGrid.sliceScale, clusterGrid.sliceBias, static_cast<float>(extent.width), static_cast<float>(extent.height) };
+
 				// Update our global uniform buffer 
 				u_GlobalBuffers[frameIndex]->writeToBuffer(&u_GlobalData);
 				u_GlobalBuffers[frameIndex]->flush();
 
+				// Relocate a few allocations ahead of the render pass, then point this frame's set at any moved textures
+				if (data.requestDefrag) {
+					defragmenter.requestPass();
+					data.requestDefrag = false;
+				}
+				defragmenter.step(commandBuffer);
+
+				// Cached static draws bind vertex buffers the defragmenter may be moving
+				if (defragmenter.isRunning()) objectRenderSystem.invalidateStaticCache();
+
+				if (imageSystem.consumeDescriptorsDirty(frameIndex)) {
+					const auto& imageInfo = imageSystem.descriptorInfoForAllImages();
+					AvengDescriptorSetWriter(*globalDescriptorSetLayout, *descriptorPool, &frameArena)
+						.writeImage(1, imageInfo.data(), imageInfo.size())
+						.overwrite(globalDescriptorSets[frameIndex]);
+					objectRenderSystem.invalidateStaticCache();
+				}
+
+				gpuTimer.beginFrame(commandBuffer, frameIndex);
+				gpuTimer.begin(commandBuffer, GPU_SCOPE_FRAME);
+
+				// Deferred, the object pass goes to this frame slot's G-buffer rather than the swap chain image. Scaled, the scene goes to an offscreen target
+				SwapChain::DepthTarget depthTarget = renderer.getDepthTarget();
+				VkCommandBufferInheritanceInfo inheritance = renderer.getRenderPassInheritance();
+				if (options.deferred) {
+					deferredRenderer.prepareFrame(frameIndex, renderer.getSwapChainExtent(), &frameArena);
+					depthTarget = deferredRenderer.getDepthTarget(frameIndex);
+					inheritance = deferredRenderer.getInheritance(frameIndex);
+				}
+				else if (scaled) {
+					dynamicResolution.prepareFrame(frameIndex, renderer.getSwapChainExtent(), &frameArena);
+					depthTarget = dynamicResolution.getDepthTarget(frameIndex);
+					inheritance = dynamicResolution.getInheritance(frameIndex);
+				}
+
+				// The forward scene's render pass, the swap chain's or the scaled one
+				auto beginScenePass = [&](VkSubpassContents contents, bool resume) {
+					if (scaled && resume) dynamicResolution.resumeScenePass(commandBuffer, frameIndex, contents);
+					else if (scaled) dynamicResolution.beginScenePass(commandBuffer, frameIndex, contents);
+					else if (resume) renderer.resumeSwapChainRenderPass(commandBuffer, contents);
+					else renderer.beginSwapChainRenderPass(commandBuffer, contents);
+				};
+				auto endScenePass = [&]() {
+					if (scaled) dynamicResolution.endScenePass(commandBuffer);
+					else renderer.endSwapChainRenderPass(commandBuffer);
+				};
+
+				// Compute work the object pass consumes, recorded outside of the render pass
+				auto recordStart = std::chrono::high_resolution_clock::now();
+				gpuTimer.begin(commandBuffer, GPU_SCOPE_CULLING);
+				objectRenderSystem.prepare(frame_content, data, depthTarget, inheritance);
+				gpuTimer.end(commandBuffer, GPU_SCOPE_CULLING);
+
+				// The depth pre-pass gets a render pass instance of its own, so it's timed apart from the object pass
+				// After it, the object pass keeps the depth it wrote rather than clearing
+				if (!options.deferred && objectRenderSystem.hasDepthPrepass()) {
+					gpuTimer.begin(commandBuffer, GPU_SCOPE_PREPASS);
+					beginScenePass(objectRenderSystem.subpassContents(), false);
+					objectRenderSystem.renderDepthPrepass(frame_content, data, *u_ObjBuffers[frameIndex]);
+					endScenePass();
+					gpuTimer.end(commandBuffer, GPU_SCOPE_PREPASS);
+				}
+
 				// Render
-				renderer.beginSwapChainRenderPass(commandBuffer);
+				if (options.deferred) {
+					recordDeferred(frame_content, depthTarget);
+				}
+				else if (objectRenderSystem.subpassContents() == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) {
+					// Nothing but vkCmdExecuteCommands may go in the pass, so it's timed from outside and resumed inline for the rest
+					gpuTimer.begin(commandBuffer, GPU_SCOPE_OBJECTS);
+					beginScenePass(VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, objectRenderSystem.hasDepthPrepass());
+					objectRenderSystem.render(frame_content, data, *u_ObjBuffers[frameIndex]);
+					endScenePass();
+					gpuTimer.end(commandBuffer, GPU_SCOPE_OBJECTS);
+					beginScenePass(VK_SUBPASS_CONTENTS_INLINE, true);
+				}
+				else {
+					beginScenePass(VK_SUBPASS_CONTENTS_INLINE, objectRenderSystem.hasDepthPrepass());
+
+					gpuTimer.begin(commandBuffer, GPU_SCOPE_OBJECTS);
+					objectRenderSystem.render(frame_content, data, *u_ObjBuffers[frameIndex]);
+					gpuTimer.end(commandBuffer, GPU_SCOPE_OBJECTS);
+				}
+
+				// Occlusion culling's late phase needs the depth written so far, so the render pass is split around it
+				if (!options.deferred && objectRenderSystem.hasLatePass(frame_content)) {
+					endScenePass();
+					gpuTimer.begin(commandBuffer, GPU_SCOPE_OCCLUSION);
+					objectRenderSystem.prepareLate(frame_content, depthTarget);
+					beginScenePass(VK_SUBPASS_CONTENTS_INLINE, true);
+					objectRenderSystem.renderLate(frame_content, data);
+					gpuTimer.end(commandBuffer, GPU_SCOPE_OCCLUSION);
+				}
+				data.cpuRecordMs = std::chrono::duration<float, std::chrono::milliseconds::period>(
+					std::chrono::high_resolution_clock::now() - recordStart).count();
 
-				objectRenderSystem.render(frame_content, data, *u_ObjBuffers[frameIndex]);
-				pointLightSystem.render(frame_content);
+				pointLightSystem.render(frame_content, data, u_GlobalData.lightPosition, u_GlobalData.lightColor);
 
-				aveng_imgui.newFrame();
-				aveng_imgui.runGUI(data);
-				aveng_imgui.render(commandBuffer);
+				// Scaled, the scene is done. Up to the swap chain's size, under the GUI
+				if (scaled) {
+					dynamicResolution.endScenePass(commandBuffer);
+					renderer.beginSwapChainRenderPass(commandBuffer);
+					dynamicResolution.renderUpscale(commandBuffer, frameIndex, data.sharpenUpscale ? data.sharpness : 0.f);
+				}
+
+				if (!headless) {
+					aveng_imgui.newFrame();
+					aveng_imgui.runGUI(data);
+					aveng_imgui.render(commandBuffer);
+				}
 
 				renderer.endSwapChainRenderPass(commandBuffer);
+				gpuTimer.end(commandBuffer, GPU_SCOPE_FRAME);
 				renderer.endFrame();
+
+				if (headless) {
+					timings.cpuFrameMs.push_back(frameTime * 1000.f);
+					timings.cpuRecordMs.push_back(data.cpuRecordMs);
+					// Zero until the first results come back MAX_FRAMES_IN_FLIGHT frames later
+					if (data.gpuTimestamps && data.gpuFrameMs > 0.f) timings.gpuFrameMs.push_back(data.gpuFrameMs);
+				}
+				framesRendered++;
 				
 			}
 
@@ -97,6 +295,49 @@ namespace aveng {
 
 		// Block until all GPU operations quit.
 		vkDeviceWaitIdle(engineDevice.device());
+
+		if (headless) {
+			float wallSeconds = std::chrono::duration<float, std::chrono::seconds::period>(std::chrono::high_resolution_clock::now() - runStart).count();
+			reportHeadlessRun(timings, wallSeconds);
+		}
+	}
+
+	/*
+	* @function XOne::reportHeadlessRun
+	* Print what a headless run's frames took: the mean, then the spread as min, median, 95th percentile
+	* and max. The first frames carry startup work, so the spread says more than the mean does.
+	*/
+	void XOne::reportHeadlessRun(FrameTimings& timings, float wallSeconds)
+	{
+		auto report = [](const char* name, std::vector<float>& samples) {
+			if (samples.empty()) {
+				std::cout << "\t" << name << ":\tno samples" << std::endl;
+				return;
+			}
+			std::sort(samples.begin(), samples.end());
+			float sum = 0.f;
+			for (float sample : samples) sum += sample;
+			auto percentile = [&](float p) { return samples[static_cast<size_t>(p * (samples.size() - 1))]; };
+			std::ios_base::fmtflags flags = std::cout.flags();
+			std::streamsize precision = std::cout.precision();
+			std::cout << "\t" << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(3)
+				<< " avg " << std::setw(8) << sum / samples.size() << " ms   min " << std::setw(8) << samples.front()
+				<< "   p50 " << std::setw(8) << percentile(.5f) << "   p95 " << std::setw(8) << percentile(.95f)
+				<< "   max " << std::setw(8) << samples.back() << std::endl;
+			std::cout.flags(flags);
+			std::cout.precision(precision);
+		};
+
+		VkExtent2D extent = renderer.getSwapChainExtent();
+		size_t frames = timings.cpuFrameMs.size();
+		std::cout << "Headless run - " << engineDevice.properties.deviceName << ", " << extent.width << "x" << extent.height
+			<< ", " << frames << " frames in " << wallSeconds << " s (" << (wallSeconds > 0.f ? frames / wallSeconds : 0.f) << " fps)" << std::endl;
+		std::cout << "\tObjects: " << data.num_objs << "\tLights: " << lightEntities.size()
+			<< "\tShading: " << (options.deferred ? "deferred" : "forward") << std::endl;
+		report("CPU frame", timings.cpuFrameMs);
+		report("CPU record", timings.cpuRecordMs);
+		if (gpuTimer.isSupported()) report("GPU frame", timings.gpuFrameMs);
+		else std::cout << "\tGPU frame:\tno timestamp queries on this device" << std::endl;
 	}
 
 	/*
@@ -106,14 +347,51 @@ namespace aveng {
 	{
 
 		auto ship = AvengAppObject::createAppObject(THEME_1);
-		ship.model = AvengModel::createModelFromFile(engineDevice, "3D/ship.obj");
+		ship.model = AvengModel::createModelFromFile(engineDevice, "3D/ship.obj", &geometryArena);
+
+		/*
+		* For the software occlusion pass a ship can stand in as a coarse box, 12 triangles rather than the whole render mesh.
+		* An occluder must never cover more than the mesh it stands for, and the hull isn't convex: a box
+		* from its bounds, even shrunk, can poke out past the mesh and hide things that should show.
+		* So it's opt in (--ship-occluders), only for scenes where the box is known to sit inside.
+		*/
+		std::shared_ptr<const OccluderMesh> hull;
+		if (options.shipOccluders)
+		{
+			const AvengModel::Bounds& shipBounds = ship.model->getBounds();
+			hull = OccluderMesh::box(shipBounds.center, shipBounds.extents * 0.5f);
+		}
+		ship.occluder = hull;
 		ship.transform.translation = { 0.f, 0.f, 0.f };
-		appObjects.emplace(ship.getId(), std::move(ship));
+		spawnAppObject(scene, std::move(ship));
 
 		auto ship_1 = AvengAppObject::createAppObject(THEME_3);
-		ship_1.model = AvengModel::createModelFromFile(engineDevice, "3D/ship.obj");
+		ship_1.model = AvengModel::createModelFromFile(engineDevice, "3D/ship.obj", &geometryArena);
+		ship_1.occluder = hull;
 		ship_1.transform.translation = { 25.f, 0.f, 0.f };
-		appObjects.emplace(ship_1.getId(), std::move(ship_1));
+		spawnAppObject(scene, std::move(ship_1));
+
+		// A floor of ground tiles. They never move and share a texture, so they're merged into one mesh per chunk
+		{
+			const int tiles = 16;
+			const float tileSpacing = 13.6f;		// plane.obj is 136 wide
+			auto plane = std::make_shared<AvengModel::Builder>();
+			plane->loadModel("3D/plane.obj");
+
+			AvengStaticBatcher batcher{ engineDevice, &geometryArena, tileSpacing * 4 };
+			for (int i = 0; i < tiles; i++)
+			{
+				for (int j = 0; j < tiles; j++)
+				{
+					TransformComponent tile{};
+					tile.translation = { tileSpacing * (i - tiles / 2), -.1f, tileSpacing * (j - tiles / 2) };
+					tile.scale = { .1f, .1f, .1f };
+					batcher.add(plane, tile, THEME_2);
+				}
+			}
+			data.batchedObjects = static_cast<int>(batcher.pieceCount());
+			data.staticBatches = static_cast<int>(batcher.build(scene, true));		// The floor hides whatever is below it
+		}
 
 		// AvengModel::drawTriangle(engineDevice, { 1.0f, 1.0f, 1.0f });
 
@@ -166,7 +444,7 @@ namespace aveng {
 					sphere.model = AvengModel::createModelFromFile(engineDevice, "3D/sphere.obj");
 					sphere.transform.translation = { static_cast<float>(i) * 1.5f, static_cast<float>(j) * -1.0f, static_cast<float>(k) * 2.0f };
 					sphere.transform.scale = {0.1f, 0.1f, 0.1f};
-					appObjects.emplace(sphere.getId(), std::move(sphere));
+					spawnAppObject(scene, std::move(sphere));
 				
 				}
 			
@@ -179,18 +457,242 @@ namespace aveng {
 	void XOne::updateCamera(float frameTime, AvengAppObject& viewerObject, KeyboardController& keyboardController, AvengCamera& camera)
 	{
 		aspect = renderer.getAspectRatio();
-		// Updates the viewer object transform component based on key input, proportional to the time elapsed since the last frame
-		keyboardController.moveCameraXZ(aveng_window.getGLFWwindow(), frameTime);
-		camera.setViewYXZ(viewerObject.transform.translation + glm::vec3(0.f, 0.f, -.80f), viewerObject.transform.rotation + glm::vec3());
-		camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 1000.f);
+		// Updates the viewer object transform component based on key input, proportional to the time elapsed since the last frame.
+		// Headless there are no keys, the camera stays where run put it
+		if (!aveng_window.isHeadless()) keyboardController.moveCameraXZ(aveng_window.getGLFWwindow(), frameTime);
+		camera.setViewYXZ(viewerObject.transform.translation + glm::vec3(0.f, 0.f, -.80f), viewerObject.transform.getRotation());
+		camera.setPerspectiveProjection(glm::radians(50.f), aspect, NEAR_PLANE, FAR_PLANE);
 	}
 
 	void XOne::updateData()
 	{
 		data.cameraView = camera.getCameraView();
 		data.cameraPos  = viewerObject.transform.translation;
-		data.cameraRot  = viewerObject.transform.rotation;
+		data.cameraRot  = viewerObject.transform.getRotation();
 		data.fly_mode   = WindowCallbacks::flightMode;
+
+		AvengAllocator::Stats memStats = engineDevice.allocator().getStats();
+		data.gpuBlocks        = memStats.blockCount;
+		data.gpuUsedMB        = memStats.usedBytes / (1024.f * 1024.f);
+		data.gpuReservedMB    = memStats.reservedBytes / (1024.f * 1024.f);
+		data.gpuFragmentation = memStats.fragmentation();
+		data.defragBefore     = defragmenter.getStatsBefore().fragmentation();
+		data.defragAfter      = defragmenter.getStatsAfter().fragmentation();
+		data.defragMoves      = defragmenter.getMoveCount();
+		data.defragRunning    = defragmenter.isRunning();
+
+		data.gpuObjectMs      = gpuTimer.milliseconds(GPU_SCOPE_OBJECTS);
+		data.gpuCullMs        = gpuTimer.milliseconds(GPU_SCOPE_CULLING);
+		data.gpuOcclusionMs   = gpuTimer.milliseconds(GPU_SCOPE_OCCLUSION);
+		data.gpuLightingMs    = gpuTimer.milliseconds(GPU_SCOPE_LIGHTING);
+		data.gpuPrepassMs     = gpuTimer.milliseconds(GPU_SCOPE_PREPASS);
+		data.gpuFrameMs       = gpuTimer.milliseconds(GPU_SCOPE_FRAME);
+		data.gpuTimestamps    = gpuTimer.isSupported();
+		data.stressObjects    = static_cast<int>(stressEntities.size());
+		data.matrixRebuilds   = static_cast<int>(TransformComponent::takeRebuildCount());	// Over the last frame
+	}
+
+	/*
+	* @function XOne::spawnStressTest
+	* Replace the benchmark spheres with count new ones on a cube grid in front of the camera.
+	* They share a single mesh and cycle through 4 textures, so the instanced path draws them
+	* in 4 calls, the indirect path in 1, and the per object path issues one per sphere. 0 removes them.
+	* With data.stressHierarchy every sphere after the first is attached to sphere (n - 1) / 4, a tree
+	* about log4(count) deep, placed so the grid looks the same.
+	*/
+	void XOne::spawnStressTest(int count)
+	{
+		// Children before parents
+		for (auto entity = stressEntities.rbegin(); entity != stressEntities.rend(); ++entity) {
+			scene.destroy(*entity);
+		}
+		stressEntities.clear();
+		stressLinked = false;
+
+		if (count == 0) return;
+
+		// Kept across runs, arena space is never given back
+		if (!stressModel) {
+			stressModel = AvengModel::createModelFromFile(engineDevice, "3D/sphere.obj", &geometryArena);
+		}
+
+		int side = static_cast<int>(std::ceil(std::cbrt(static_cast<float>(count))));
+		stressEntities.reserve(count);
+
+		auto gridPosition = [side](int n) {
+			return glm::vec3{
+				static_cast<float>(n % side) * 1.5f,
+				static_cast<float>(n / side % side) * -1.5f,
+				static_cast<float>(n / (side * side)) * 1.5f + 10.f
+			};
+		};
+		const float scale = 0.1f;
+		stressLinked = data.stressHierarchy;
+
+		for (int n = 0; n < count; n++)
+		{
+			TransformComponent transform{};
+			transform.translation = gridPosition(n);
+			transform.scale = { scale, scale, scale };
+
+			// Relative to the parent, which carries the scale for the whole tree
+			if (stressLinked && n > 0) {
+				transform.translation = (gridPosition(n) - gridPosition((n - 1) / 4)) / scale;
+				transform.scale = { 1.f, 1.f, 1.f };
+			}
+
+			VisualComponent visual{};
+			visual.tex_id = THEME_1 + n % 4;
+
+			Entity entity = scene.create();
+			scene.add<TransformComponent>(entity, transform);
+			scene.add<VisualComponent>(entity, visual);
+			scene.add<MetaComponent>(entity, { SCENE });
+			scene.add<ModelComponent>(entity, { stressModel });
+			stressEntities.push_back(entity);
+
+			if (stressLinked && n > 0) hierarchy.attach(scene, entity, stressEntities[(n - 1) / 4]);
+		}
+	}
+
+	/*
+	* @function XOne::spawnLights
+	* Replace the GUI's point lights with count new ones spread over the stress test's grid, each with
+	* its own color and circling its own center, so every light moves every frame. 0 removes them.
+	*/
+	void XOne::spawnLights(int count)
+	{
+		for (Entity entity : lightEntities) scene.destroy(entity);
+		lightEntities.clear();
+		lightOrbits.clear();
+
+		if (count == 0) return;
+
+		std::mt19937 random{ 42 };
+		std::uniform_real_distribution<float> across{ -10.f, 40.f };
+		std::uniform_real_distribution<float> height{ -35.f, 2.f };
+		std::uniform_real_distribution<float> deep{ 5.f, 50.f };
+		std::uniform_real_distribution<float> unit{ 0.f, 1.f };
+
+		lightEntities.reserve(count);
+		lightOrbits.reserve(count);
+		for (int n = 0; n < count; n++)
+		{
+			LightOrbit orbit{ { across(random), height(random), deep(random) }, 1.f + 3.f * unit(random), .3f + unit(random), 6.2831853f * unit(random) };
+
+			PointLightComponent light{};
+			light.color = glm::vec3{ .3f, .3f, .3f } + .7f * glm::vec3{ unit(random), unit(random), unit(random) };
+			light.intensity = 2.f + 4.f * unit(random);
+			light.radius = 2.f + 3.f * unit(random);
+
+			Entity entity = scene.create();
+			scene.add<TransformComponent>(entity, TransformComponent{ orbit.center });
+			scene.add<PointLightComponent>(entity, light);
+			lightEntities.push_back(entity);
+			lightOrbits.push_back(orbit);
+		}
+	}
+
+	void XOne::animateLights(float frameTime)
+	{
+		lightTime += frameTime;
+		for (size_t n = 0; n < lightEntities.size(); n++)
+		{
+			const LightOrbit& orbit = lightOrbits[n];
+			float angle = orbit.phase + orbit.speed * lightTime;
+			scene.get<TransformComponent>(lightEntities[n]).translation = orbit.center + orbit.radius * glm::vec3{ std::cos(angle), 0.f, std::sin(angle) };
+		}
+	}
+
+	/*
+	* @function XOne::runTransformBenchmark
+	* Time the scalar, batched and threaded matrix builds at 10k and 100k random transforms.
+	* Stalls the frame it runs in, so only when asked for from the GUI.
+	*/
+	void XOne::runTransformBenchmark()
+	{
+		const size_t counts[2] = { 10000, 100000 };
+		data.transformMaxError = 0.f;
+
+		for (int n = 0; n < 2; n++)
+		{
+			TransformBenchmark result = benchmarkTransforms(counts[n], &workers);
+			data.transformScalarMs[n]   = result.scalarMs;
+			data.transformBatchMs[n]    = result.batchMs;
+			data.transformParallelMs[n] = result.parallelMs;
+			data.transformMaxError      = std::max(data.transformMaxError, result.maxError);
+		}
+		data.transformBenchmarked = true;
+	}
+
+	/*
+	* @function XOne::ensureObjectBufferCapacity
+	* The per object path gives every draw its own slot of the dynamic uniform buffer (slot 0 is unused).
+	* Grow this frame's buffer when the scene outgrows it and point the frame's object descriptor set at the new one.
+	* This frame slot's last submission has retired, and the old buffer goes through the deletion queue.
+	*/
+	void XOne::ensureObjectBufferCapacity(int frameIndex)
+	{
+		VkDeviceSize alignment = engineDevice.properties.limits.minUniformBufferOffsetAlignment;
+		VkDeviceSize required = alignment * (scene.size() + 1);
+		if (u_ObjBuffers[frameIndex]->getBufferSize() >= required) return;
+
+		u_ObjBuffers[frameIndex] = std::make_unique<AvengBuffer>(engineDevice,
+			sizeof(ObjectRenderSystem::ObjectUniformData),
+			static_cast<uint32_t>((scene.size() + 1) * 2),
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			alignment);
+		u_ObjBuffers[frameIndex]->map();
+
+		auto objBufferInfo = u_ObjBuffers[frameIndex]->descriptorInfo(sizeof(ObjectRenderSystem::ObjectUniformData), 0);
+		AvengDescriptorSetWriter(*objDescriptorSetLayout, *descriptorPool, &frameArena)
+			.writeBuffer(0, &objBufferInfo)
+			.overwrite(objectDescriptorSets[frameIndex]);
+	}
+
+	/*
+	* @function XOne::recordDeferred
+	* The object pass into the G-buffer, the depth pre-pass and occlusion culling's late phase included,
+	* then the lighting pass. Timed per pass, and leaves the swap chain render pass begun for what is
+	* drawn forward on top.
+	*/
+	void XOne::recordDeferred(FrameContent& frame_content, const SwapChain::DepthTarget& depthTarget)
+	{
+		VkCommandBuffer commandBuffer = frame_content.commandBuffer;
+		int frameIndex = frame_content.frameIndex;
+		VkSubpassContents contents = objectRenderSystem.subpassContents();
+
+		if (objectRenderSystem.hasDepthPrepass()) {
+			gpuTimer.begin(commandBuffer, GPU_SCOPE_PREPASS);
+			deferredRenderer.beginGeometryPass(commandBuffer, frameIndex, contents);
+			objectRenderSystem.renderDepthPrepass(frame_content, data, *u_ObjBuffers[frameIndex]);
+			deferredRenderer.endGeometryPass(commandBuffer);
+			gpuTimer.end(commandBuffer, GPU_SCOPE_PREPASS);
+		}
+
+		gpuTimer.begin(commandBuffer, GPU_SCOPE_OBJECTS);
+		if (objectRenderSystem.hasDepthPrepass()) deferredRenderer.resumeGeometryPass(commandBuffer, frameIndex, contents);
+		else deferredRenderer.beginGeometryPass(commandBuffer, frameIndex, contents);
+		objectRenderSystem.render(frame_content, data, *u_ObjBuffers[frameIndex]);
+		deferredRenderer.endGeometryPass(commandBuffer);
+		gpuTimer.end(commandBuffer, GPU_SCOPE_OBJECTS);
+
+		if (objectRenderSystem.hasLatePass(frame_content)) {
+			gpuTimer.begin(commandBuffer, GPU_SCOPE_OCCLUSION);
+			objectRenderSystem.prepareLate(frame_content, depthTarget);
+			deferredRenderer.resumeGeometryPass(commandBuffer, frameIndex);
+			objectRenderSystem.renderLate(frame_content, data);
+			deferredRenderer.endGeometryPass(commandBuffer);
+			gpuTimer.end(commandBuffer, GPU_SCOPE_OCCLUSION);
+		}
+
+		deferredRenderer.finishGeometry(commandBuffer, frameIndex);
+		renderer.beginSwapChainRenderPass(commandBuffer);
+
+		gpuTimer.begin(commandBuffer, GPU_SCOPE_LIGHTING);
+		deferredRenderer.renderLighting(frame_content);
+		gpuTimer.end(commandBuffer, GPU_SCOPE_LIGHTING);
 	}
 
 	/*
@@ -206,10 +708,13 @@ namespace aveng {
 			<< "\nSize of Dynamic Uniform Buffer:\t" <<
 			sizeof(ObjectRenderSystem::ObjectUniformData)
 			* engineDevice.properties.limits.minUniformBufferOffsetAlignment
-			* appObjects.size() << " Bytes"
+			* scene.size() << " Bytes"
 			<< "\nSize of ObjectUniformBuffer Data\t" << sizeof(ObjectRenderSystem::ObjectUniformData)
 			<< std::endl;
 
+		// Leave a core for the main thread
+		workers.setThreadCount(std::max(1u, std::thread::hardware_concurrency()) - 1);
+
 		VkPhysicalDeviceFeatures m;
 		vkGetPhysicalDeviceFeatures(engineDevice.physicalDevice(), &m);
 		if (!m.shaderSampledImageArrayDynamicIndexing) {
@@ -227,6 +732,7 @@ namespace aveng {
 			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,			SwapChain::MAX_FRAMES_IN_FLIGHT * 2)
 			.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, SwapChain::MAX_FRAMES_IN_FLIGHT * 8)
 			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, SwapChain::MAX_FRAMES_IN_FLIGHT * 2)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,			SwapChain::MAX_FRAMES_IN_FLIGHT * 3)
 			.build();
 
 		// Create uniform buffers mapped into device memory
@@ -242,6 +748,9 @@ namespace aveng {
 			u_GlobalBuffers[i]->map();
 		}
 
+		// Light and cluster buffers, fixed size so the global sets are written once below
+		clusteredLighting.initialize();
+
 		if (sizeof(ObjectRenderSystem::ObjectUniformData) > engineDevice.properties.limits.minUniformBufferOffsetAlignment)
 		{
 			// We'll need to update our alignment should this ever be the case.
@@ -250,7 +759,7 @@ namespace aveng {
 
 		for (int i = 0; i < u_ObjBuffers.size(); i++) {
 			u_ObjBuffers[i] = std::make_unique<AvengBuffer>(engineDevice,
-				sizeof(ObjectRenderSystem::ObjectUniformData) * engineDevice.properties.limits.minUniformBufferOffsetAlignment * appObjects.size(), // The size <VkDeviceSize> of the dynamic uniform buffer 
+				sizeof(ObjectRenderSystem::ObjectUniformData) * engineDevice.properties.limits.minUniformBufferOffsetAlignment * scene.size(), // The size <VkDeviceSize> of the dynamic uniform buffer 
 				1,
 				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
@@ -260,15 +769,18 @@ namespace aveng {
 
 		std::cout << "XOne -- Creating global Descriptors" << std::endl;
 		// Descriptor Layout 0 -- Global
-		std::unique_ptr<AvengDescriptorSetLayout> globalDescriptorSetLayout =
+		globalDescriptorSetLayout =
 			AvengDescriptorSetLayout::Builder(engineDevice)
 			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS, 1)
 			.addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, imageSystem.descriptorInfoForAllImages().size())	// Combined image samplers use 1 descriptor for each image
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)	// Point lights
+			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)	// Offset and count of each cluster's lights
+			.addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)	// Light indices
 			.build();
 
 		std::cout << "XOne -- Creating obj Descriptors" << std::endl;
 		// Descriptor Set 1 -- Per object
-		std::unique_ptr<AvengDescriptorSetLayout> objDescriptorSetLayout =
+		objDescriptorSetLayout =
 			AvengDescriptorSetLayout::Builder(engineDevice)
 			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS, 1)
 			.build();
@@ -282,11 +794,17 @@ namespace aveng {
 		{
 			// Write first set - Uniform Buffer containing our global-UBO and our Imager Sampler
 			auto bufferInfo = u_GlobalBuffers[i]->descriptorInfo(sizeof(GlobalUbo), 0);
-			auto imageInfo = imageSystem.descriptorInfoForAllImages();
+			const auto& imageInfo = imageSystem.descriptorInfoForAllImages();
+			auto lightInfo = clusteredLighting.lightBufferInfo(i);
+			auto clusterInfo = clusteredLighting.clusterBufferInfo(i);
+			auto lightIndexInfo = clusteredLighting.indexBufferInfo(i);
 			std::cout << "Writing Global DescriptorSet" << std::endl;
 			AvengDescriptorSetWriter(*globalDescriptorSetLayout, *descriptorPool)
 				.writeBuffer(0, &bufferInfo)	// First Binding descriptor: Buffer
 				.writeImage(1, imageInfo.data(), imageInfo.size()) // Second Binding descriptor: Image
+				.writeBuffer(2, &lightInfo)
+				.writeBuffer(3, &clusterInfo)
+				.writeBuffer(4, &lightIndexInfo)
 				.build(globalDescriptorSets[i]);
 
 			std::cout << "Writing Object DescriptorSet" << std::endl;
@@ -297,22 +815,43 @@ namespace aveng {
 				.build(objectDescriptorSets[i]);
 		}
 
-		// Rendering subsystem initializers
+		// Rendering subsystem initializers. Deferred, the object pipelines are made for the G-buffer pass instead
+		data.deferredShading = options.deferred;
+		if (options.deferred) {
+			deferredRenderer.initialize(
+				renderer.getSwapChainRenderPass(),
+				globalDescriptorSetLayout->getDescriptorSetLayout()
+			);
+		}
 		objectRenderSystem.initialize(
-			renderer.getSwapChainRenderPass(),
+			options.deferred ? deferredRenderer.getGeometryRenderPass() : renderer.getSwapChainRenderPass(),
 			globalDescriptorSetLayout->getDescriptorSetLayout(),
-			objDescriptorSetLayout->getDescriptorSetLayout()
+			objDescriptorSetLayout->getDescriptorSetLayout(),
+			options.deferred
 		);
 		pointLightSystem.initialize(
 			renderer.getSwapChainRenderPass(),
 			globalDescriptorSetLayout->getDescriptorSetLayout()
 		);
-		// GUI
-		aveng_imgui.init(
-			aveng_window,
-			renderer.getSwapChainRenderPass(),
-			renderer.getImageCount()
-		);
+		// Only the forward scene scales, so deferred it never draws
+		if (!options.deferred) {
+			dynamicResolution.initialize(
+				renderer.getSwapChainRenderPass(),
+				renderer.getSwapChainImageFormat(),
+				engineDevice.findSupportedFormat(
+					{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+					VK_IMAGE_TILING_OPTIMAL,
+					VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+			);
+		}
+		// GUI, headless there's no window to put it in
+		if (!aveng_window.isHeadless()) {
+			aveng_imgui.init(
+				aveng_window,
+				renderer.getSwapChainRenderPass(),
+				renderer.getImageCount()
+			);
+		}
 	}
 
 	void XOne::pendulum(EngineDevice& engineDevice, int _max_rows)
@@ -352,7 +891,7 @@ namespace aveng {
 				gameObj.transform.translation = { 0.0f, static_cast<float>((i * -1.0f)), 0.0f };
 				gameObj.transform.scale = { .4f, 0.4f, 0.4f };
 
-				appObjects.emplace(gameObj.getId(), std::move(gameObj));
+				spawnAppObject(scene, std::move(gameObj));
 			}
 			row_modifier++;
 		}
@@ -7,21 +7,43 @@
 #include "CoreVK/aveng_descriptors.h"
 #include "Core/Renderer/AvengImageSystem.h"
 #include "Core/Renderer/PointLightSystem.h"
+#include "Core/Renderer/ClusteredLighting.h"
+#include "Core/Renderer/DeferredRenderer.h"
+#include "Core/Renderer/DynamicResolution.h"
 #include "Core/Scene/app_object.h"
+#include "Core/Scene/aveng_static_batcher.h"
+#include "Core/Scene/aveng_transform_hierarchy.h"
+#include "Core/Math/aveng_transform_batch.h"
 #include "GUI/aveng_imgui.h"
 #include "Core/aveng_window.h"
 #include "CoreVK/EngineDevice.h"
 #include "CoreVk/aveng_buffer.h"
+#include "CoreVK/aveng_defragmenter.h"
+#include "CoreVK/aveng_geometry_arena.h"
+#include "CoreVK/aveng_gpu_timer.h"
 #include "Core/Renderer/Renderer.h"
 #include "Core/Peripheral/KeyboardController.h"
+#include "Core/Utils/aveng_frame_arena.h"
+#include "Core/Utils/threadpool.h"
 
 namespace aveng {
 
+	// Chosen on the command line, see main.cpp
+	struct AppOptions {
+		bool deferred = false;		// --deferred, the object pass fills a G-buffer that DeferredRenderer lights
+		int headlessFrames = 0;		// --headless N, N frames offscreen without a window or GUI, then a timing report
+		int stressObjects = -1;		// --stress N, benchmark spheres spawned before the first frame
+		int lights = -1;			// --lights N, point lights spawned before the first frame
+		bool shipOccluders = false;	// --ship-occluders, the ships occlude as boxes, see loadAppObjects
+	};
+
 	class XOne {
 
 	public:
 		static constexpr int WIDTH = 800;
 		static constexpr int HEIGHT = 600;
+		static constexpr float NEAR_PLANE = 0.1f;
+		static constexpr float FAR_PLANE = 1000.f;
 
 		struct GlobalUbo {
 			glm::mat4 projection{ 1.f };
@@ -29,10 +51,13 @@ namespace aveng {
 			glm::vec4 ambientLightColor{0.f, 0.f, 1.f, .04f};
 			glm::vec3 lightPosition{ 5.0f, -1.0f, 2.8f };
 			alignas(16) glm::vec4 lightColor{ 1.f, 1.f, 1.f, 1.f };
+			// Clustered point lights, see ClusteredLighting
+			alignas(16) glm::uvec4 clusterGrid{ 0u };	// Clusters along x, y and z, w is the light count
+			glm::vec4 clusterParams{ 0.f };				// Slice scale and bias, then the framebuffer's width and height
 			//alignas(16) glm::vec3 lightDirection = glm::normalize(glm::vec3{ -1.f, -3.f, 1.f });
 		};
 
-		XOne();
+		XOne(const AppOptions& options = {});
 		~XOne(){};
 
 		XOne(const XOne&) = delete;
@@ -49,6 +74,20 @@ namespace aveng {
 		void Setup();
 		void updateCamera(float frameTime, AvengAppObject& viewerObject, KeyboardController& cameraController, AvengCamera& camera);
 		void updateData();
+		void spawnStressTest(int count);
+		void spawnLights(int count);
+		void animateLights(float frameTime);
+		void runTransformBenchmark();
+		void ensureObjectBufferCapacity(int frameIndex);
+		void recordDeferred(FrameContent& frame_content, const SwapChain::DepthTarget& depthTarget);
+
+		// Headless, what each frame took. Reported once the run's frames are done
+		struct FrameTimings {
+			std::vector<float> cpuFrameMs;		// Between loop iterations, paced by the frame slots' fences
+			std::vector<float> cpuRecordMs;
+			std::vector<float> gpuFrameMs;		// GPU_SCOPE_FRAME, when the device has timestamps
+		};
+		void reportHeadlessRun(FrameTimings& timings, float wallSeconds);
 		glm::vec3 clear_color = { 0.0f, 0.0f, 0.0f };
 
 		/*
@@ -56,11 +95,15 @@ namespace aveng {
 		* See:  12.6.2 of the C++ Standard
 		*/
 
+		AppOptions options;
 		Data data;
-		// The window API - Stack allocated
-		AvengWindow aveng_window{ WIDTH, HEIGHT, "Vulkan 0" };
+		// The window API - Stack allocated. Headless there's no window, only its extent
+		AvengWindow aveng_window{ WIDTH, HEIGHT, "Vulkan 0", options.headlessFrames > 0 };
 		AvengAppObject viewerObject{ AvengAppObject::createAppObject(1000) };
 		EngineDevice engineDevice{ aveng_window };
+		AvengDefragmenter defragmenter{ engineDevice };
+		AvengGpuTimer gpuTimer{ engineDevice };
+		AvengGeometryArena geometryArena{ engineDevice, sizeof(AvengModel::Vertex), 1u << 20, 4u << 20 };	// 1M vertices, 4M indices
 		ImageSystem imageSystem{ engineDevice };
 		Renderer renderer{ aveng_window, engineDevice };
 		AvengImgui aveng_imgui{ engineDevice };
@@ -68,20 +111,51 @@ namespace aveng {
 		GlobalUbo u_GlobalData{};
 		ObjectRenderSystem objectRenderSystem{ engineDevice, viewerObject };
 		PointLightSystem pointLightSystem{ engineDevice };
+		ClusteredLighting clusteredLighting{ engineDevice };
+		DeferredRenderer deferredRenderer{ engineDevice };
+		DynamicResolution dynamicResolution{ engineDevice };
 		KeyboardController keyboardController{ viewerObject, data };
 
 		float aspect;
 		float frameTime;
-		AvengAppObject::Map appObjects;
+		FrameArena frameArena{};
+		ThreadPool workers;
+		AvengRegistry scene;
 
 		// This declaration must occur after the renderer initializes
 		std::unique_ptr<AvengDescriptorPool> descriptorPool{};
+		std::unique_ptr<AvengDescriptorSetLayout> globalDescriptorSetLayout{};
+		std::unique_ptr<AvengDescriptorSetLayout> objDescriptorSetLayout{};
 
 		std::vector<std::unique_ptr<AvengBuffer>> u_GlobalBuffers;
 		std::vector<std::unique_ptr<AvengBuffer>> u_ObjBuffers;
 		std::vector<VkDescriptorSet> globalDescriptorSets;
 		std::vector<VkDescriptorSet> objectDescriptorSets;
 
+		// Spheres spawned from the GUI to benchmark the object pass, all sharing one mesh
+		static constexpr uint32_t GPU_SCOPE_OBJECTS = 0;
+		static constexpr uint32_t GPU_SCOPE_CULLING = 1;
+		static constexpr uint32_t GPU_SCOPE_OCCLUSION = 2;
+		static constexpr uint32_t GPU_SCOPE_LIGHTING = 3;		// DeferredRenderer's lighting pass
+		static constexpr uint32_t GPU_SCOPE_PREPASS = 4;		// ObjectRenderSystem's depth pre-pass
+		static constexpr uint32_t GPU_SCOPE_FRAME = 5;			// Everything, what DynamicResolution follows
+		std::shared_ptr<AvengModel> stressModel;
+		std::vector<Entity> stressEntities;
+		bool stressLinked = false;		// stressEntities form a tree under the first one
+
+		AvengTransformHierarchy hierarchy;
+
+		// Point lights spawned from the GUI, each circling its own center
+		struct LightOrbit {
+			glm::vec3 center;
+			float radius;
+			float speed;
+			float phase;
+		};
+		std::vector<Entity> lightEntities;
+		std::vector<LightOrbit> lightOrbits;
+		float lightTime = 0.f;
+
 	};
 
 }
@@ -6,4 +6,18 @@ C:\VulkanSDK\1.4.309.0\Bin\glslc.exe shaders\point_light.vert -o shaders\point_l
 C:\VulkanSDK\1.4.309.0\Bin\glslc.exe shaders\point_light.frag -o shaders\point_light.frag.spv
 C:\VulkanSDK\1.4.309.0\Bin\glslc.exe shaders\vv.vert -o shaders\vv.vert.spv
 C:\VulkanSDK\1.4.309.0\Bin\glslc.exe shaders\ff.frag -o shaders\ff.frag.spv
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe shaders\instanced_shader.vert -o shaders\instanced_shader.vert.spv
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe shaders\instanced_shader.frag -o shaders\instanced_shader.frag.spv
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe shaders\cull.comp -o shaders\cull.comp.spv
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe shaders\compact.comp -o shaders\compact.comp.spv
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe shaders\hiz_reduce.comp -o shaders\hiz_reduce.comp.spv
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe shaders\gbuffer.frag -o shaders\gbuffer.frag.spv
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe shaders\gbuffer_instanced.frag -o shaders\gbuffer_instanced.frag.spv
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe shaders\deferred_lighting.vert -o shaders\deferred_lighting.vert.spv
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe shaders\deferred_lighting.frag -o shaders\deferred_lighting.frag.spv
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe shaders\depth_only.vert -o shaders\depth_only.vert.spv
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe shaders\depth_only_instanced.vert -o shaders\depth_only_instanced.vert.spv
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe shaders\depth_only.frag -o shaders\depth_only.frag.spv
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe shaders\upscale.vert -o shaders\upscale.vert.spv
+C:\VulkanSDK\1.4.309.0\Bin\glslc.exe shaders\upscale.frag -o shaders\upscale.frag.spv
 pause
\ No newline at end of file
@@ -1,13 +1,28 @@
 #include "XOne.h"
 #include "avpch.h"
+#include <cstdlib>
+#include <string>
 // #include "Apps/Gravity.h"
 
 #define LOG(a) std::cout << a << std::endl
 
-int main(void)
+int main(int argc, char** argv)
 {
 	std::vector<int> int_vec; // Wat?
-	aveng::XOne app{};
+
+	aveng::AppOptions options{};
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--deferred") options.deferred = true;
+		// Benchmarks: --headless 500 --stress 4096 --lights 1024
+		else if (arg == "--headless" && i + 1 < argc) options.headlessFrames = std::atoi(argv[++i]);
+		else if (arg == "--stress" && i + 1 < argc) options.stressObjects = std::atoi(argv[++i]);
+		else if (arg == "--lights" && i + 1 < argc) options.lights = std::atoi(argv[++i]);
+		else if (arg == "--ship-occluders") options.shipOccluders = true;
+	}
+
+	aveng::XOne app{ options };
 
 	try {
 		app.run();
@@ -0,0 +1,44 @@
+// Clustered point lights, see ClusteredLighting. The including shader declares GlobalUbo as ubo first
+
+struct PointLight {
+	vec4 position;	// World space, w is the radius
+	vec4 color;		// w is intensity
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer LightBuffer {
+	PointLight lights[];
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer ClusterBuffer {
+	uvec2 clusters[];	// Offset into lightIndices and count
+};
+
+layout(std430, set = 0, binding = 4) readonly buffer LightIndexBuffer {
+	uint lightIndices[];
+};
+
+// Diffuse light at positionWorld from the point lights in this fragment's cluster
+vec3 clusterLighting(vec3 positionWorld, vec3 normal) {
+	if (ubo.clusterGrid.w == 0u) return vec3(0.0);
+
+	float depth = (ubo.view * vec4(positionWorld, 1.0)).z;
+	uvec3 cell = uvec3(
+		gl_FragCoord.xy / ubo.clusterParams.zw * vec2(ubo.clusterGrid.xy),
+		max(log(depth) * ubo.clusterParams.x + ubo.clusterParams.y, 0.0));
+	cell = min(cell, ubo.clusterGrid.xyz - 1u);
+	uvec2 range = clusters[cell.x + ubo.clusterGrid.x * (cell.y + ubo.clusterGrid.y * cell.z)];
+
+	vec3 light = vec3(0.0);
+	for (uint i = 0u; i < range.y; i++) {
+		PointLight pointLight = lights[lightIndices[range.x + i]];
+		vec3 toLight = pointLight.position.xyz - positionWorld;
+		float distanceSquared = dot(toLight, toLight);
+
+		// Inverse square, windowed down to 0 at the radius so the cut off doesn't show
+		float window = clamp(1.0 - distanceSquared / (pointLight.position.w * pointLight.position.w), 0.0, 1.0);
+		float attenuation = window * window / (distanceSquared + 1.0);
+		float facing = max(dot(normal, toLight * inversesqrt(max(distanceSquared, 0.0001))), 0.0);
+		light += pointLight.color.xyz * pointLight.color.w * attenuation * facing;
+	}
+	return light;
+}
@@ -0,0 +1,52 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// Shades the G-buffer once per pixel, as simple_shader.frag would have. See DeferredRenderer
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	vec4 ambientLightColor; // w is intensity
+	vec3 lightPosition;
+	vec4 lightColor;
+	uvec4 clusterGrid;		// Clusters along x, y and z, w is the light count
+	vec4 clusterParams;		// Slice scale and bias, then the framebuffer's width and height
+} ubo;
+
+#include "cluster_lighting.glsl"
+#include "octahedral.glsl"
+
+layout(set = 1, binding = 0) uniform usampler2D gbufferSurface;	// Written by gbuffer.frag
+layout(set = 1, binding = 1) uniform sampler2D gbufferDepth;
+
+layout(push_constant) uniform Push {
+	mat4 inverseViewProjection;
+} push;
+
+void main() {
+
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(gbufferDepth, pixel, 0).r;
+
+	// Nothing was drawn here, the swap chain's clear color and depth stay
+	if (depth >= 1.0) discard;
+	gl_FragDepth = depth;
+
+	uvec2 surface = texelFetch(gbufferSurface, pixel, 0).xy;
+	vec3 albedo = unpackUnorm4x8(surface.x).rgb;
+	vec3 normal = octDecode(unpackSnorm2x16(surface.y));
+
+	// Back to world space through the depth the object pass wrote
+	vec2 ndc = gl_FragCoord.xy / ubo.clusterParams.zw * 2.0 - 1.0;
+	vec4 position = push.inverseViewProjection * vec4(ndc, depth, 1.0);
+	vec3 positionWorld = position.xyz / position.w;
+
+	vec3 directionToLight = ubo.lightPosition - positionWorld;
+	vec3 lightColor = ubo.lightColor.xyz * ubo.lightColor.w;
+	vec3 ambientLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
+	vec3 diffuseLight = lightColor * max(dot(normal, normalize(directionToLight)), 0);
+
+	outColor = vec4((diffuseLight + ambientLight + clusterLighting(positionWorld, normal)) * albedo, 1.0);
+}
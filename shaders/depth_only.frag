@@ -0,0 +1,5 @@
+#version 450
+
+// Nothing to shade, the pre-pass only writes depth
+void main() {
+}
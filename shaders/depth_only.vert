@@ -0,0 +1,22 @@
+#version 450
+
+// The depth pre-pass, see ObjectRenderSystem::hasDepthPrepass. Only the position is read
+layout(location = 0) in vec3 position;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+} ubo;
+
+layout(push_constant) uniform Push {
+	mat4 modelMatrix;
+	mat4 normalMatrix;
+} push;
+
+// Has to match simple_shader.vert exactly
+invariant gl_Position;
+
+void main() {
+	vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
+	gl_Position = ubo.projection * ubo.view * positionWorld;
+}
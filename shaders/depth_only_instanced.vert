@@ -0,0 +1,18 @@
+#version 450
+
+// The depth pre-pass of the instanced paths, see ObjectRenderSystem::hasDepthPrepass
+layout(location = 0) in vec3 position;
+layout(location = 4) in mat4 i_modelMatrix;		// Occupies locations 4 - 7
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+} ubo;
+
+// Has to match instanced_shader.vert exactly
+invariant gl_Position;
+
+void main() {
+	vec4 positionWorld = i_modelMatrix * vec4(position, 1.0);
+	gl_Position = ubo.projection * ubo.view * positionWorld;
+}
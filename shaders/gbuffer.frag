@@ -0,0 +1,34 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// simple_shader.frag's surface without its lighting, written to the G-buffer when shading is deferred. See DeferredRenderer
+
+layout(set = 0, binding = 1) uniform sampler2D texSampler[8];
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragPosWorld;
+layout(location = 2) in vec3 fragNormalWorld;
+layout(location = 3) in vec2 fragTexCoord;
+
+// Albedo as unorm rgba8, then the world space normal octahedral encoded in two snorm16s
+layout(location = 0) out uvec2 outSurface;
+
+layout(set = 1, binding = 0) uniform ObjectUniformData {
+    uint texIndex;
+} u_ObjData;
+
+#include "octahedral.glsl"
+
+void main() {
+
+    vec4 result = vec4(fragColor, 1.0);
+
+    if (u_ObjData.texIndex != 8) {  // 8 will omit texture and default to vertex colors
+        result = texture(texSampler[u_ObjData.texIndex], fragTexCoord);
+    }
+
+    // Gamma correction
+    float gamma = 1.1;
+    result.rgb = pow(result.rgb, vec3(1.0 / gamma));
+
+    outSurface = uvec2(packUnorm4x8(vec4(result.rgb, 1.0)), packSnorm2x16(octEncode(normalize(fragNormalWorld))));
+}
@@ -0,0 +1,32 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// gbuffer.frag for the instanced pipeline, the texture comes with the instance. See DeferredRenderer
+
+layout(set = 0, binding = 1) uniform sampler2D texSampler[8];
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragPosWorld;
+layout(location = 2) in vec3 fragNormalWorld;
+layout(location = 3) in vec2 fragTexCoord;
+// Uniform within each draw, ObjectRenderSystem splits groups on texture changes
+layout(location = 4) flat in uint texIndex;
+
+// Albedo as unorm rgba8, then the world space normal octahedral encoded in two snorm16s
+layout(location = 0) out uvec2 outSurface;
+
+#include "octahedral.glsl"
+
+void main() {
+
+    vec4 result = vec4(fragColor, 1.0);
+
+    if (texIndex != 8) {  // 8 will omit texture and default to vertex colors
+        result = texture(texSampler[texIndex], fragTexCoord);
+    }
+
+    // Gamma correction
+    float gamma = 1.1;
+    result.rgb = pow(result.rgb, vec3(1.0 / gamma));
+
+    outSurface = uvec2(packUnorm4x8(vec4(result.rgb, 1.0)), packSnorm2x16(octEncode(normalize(fragNormalWorld))));
+}
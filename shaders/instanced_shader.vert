@@ -0,0 +1,40 @@
+#version 450
+
+// <Vertex> object
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 v_fragColor;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec2 v_fragTexCoord;
+
+// Per instance, see ObjectRenderSystem::InstanceData
+layout(location = 4) in mat4 i_modelMatrix;		// Occupies locations 4 - 7
+layout(location = 8) in mat3 i_normalMatrix;	// Occupies locations 8 - 10
+layout(location = 11) in uint i_texIndex;
+
+layout(location = 0) out vec3 f_fragColor;
+layout(location = 1) out vec3 f_fragPosWorld;
+layout(location = 2) out vec3 f_fragNormalWorld;
+layout(location = 3) out vec2 f_fragTexCoord;
+layout(location = 4) flat out uint f_texIndex;
+
+// Bit for bit what depth_only.vert computes, or the EQUAL depth test behind the pre-pass would fail
+invariant gl_Position;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	vec4 ambientLightColor; // w is intensity
+	vec3 lightPosition;
+	vec4 lightColor;
+} ubo;
+
+void main() {
+	vec4 positionWorld = i_modelMatrix * vec4(position, 1.0);
+	gl_Position = ubo.projection * ubo.view * positionWorld;
+
+	f_fragNormalWorld = normalize(i_normalMatrix * normal);
+	f_fragPosWorld    = positionWorld.xyz;
+	f_fragColor		  = v_fragColor;
+	f_fragTexCoord    = v_fragTexCoord;
+	f_texIndex        = i_texIndex;
+}
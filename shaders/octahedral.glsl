@@ -0,0 +1,19 @@
+// Unit normals folded onto the [-1, 1] square and back, for the G-buffer's two snorm16s. See DeferredRenderer
+
+vec2 octEncode(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	if (n.z < 0.0) {
+		vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+		n.xy = (1.0 - abs(n.yx)) * signs;
+	}
+	return n.xy;
+}
+
+vec3 octDecode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0) {
+		vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+		n.xy = (1.0 - abs(n.yx)) * signs;
+	}
+	return normalize(n);
+}
@@ -1,6 +1,7 @@
 #version 450
 
 layout(location=0) in vec2 fragOffset;
+layout(location=1) in vec3 fragColor;
 layout(location=0) out vec4 outColor;
 
 layout(set = 0, binding = 0) uniform GlobalUbo {
@@ -17,5 +18,6 @@ void main()
 	if (dis >= 1.0) {	// This effectively means anything beyond a 1 unit radius gets discarded, turning our square into a circle
 		discard;	// fragment shader keyword
 	}
-	outColor = vec4(ubo.lightColor.xyz, 1.0);
+	// Faded out towards the edge, blended back to front
+	outColor = vec4(fragColor, 1.0 - smoothstep(0.6, 1.0, dis));
 }
\ No newline at end of file
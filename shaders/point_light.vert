@@ -9,7 +9,12 @@ const vec2 OFFSETS[6] = vec2[](
   vec2(1.0, 1.0)
 );
 
+// Per instance, see PointLightSystem::Billboard
+layout(location = 0) in vec4 lightPosition;	// w is the billboard's radius
+layout(location = 1) in vec4 lightColor;
+
 layout (location = 0) out vec2 fragOffset;
+layout (location = 1) out vec3 fragColor;
 
 layout(set = 0, binding = 0) uniform GlobalUbo {
 	mat4 projection;
@@ -19,14 +24,14 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 	vec4 lightColor;
 } ubo;
 
-const float LIGHT_RADIUS = 0.561; // Can be a push constant?
-
 void main() {
 
 	fragOffset = OFFSETS[gl_VertexIndex]; // gl_VertexIndex contains the index of the current vertex being processed
 
-	vec4 lightCameraSpace = ubo.view * vec4(ubo.lightPosition, 1.0);
-	vec4 positionCameraSpace = lightCameraSpace + LIGHT_RADIUS * vec4(fragOffset, 0.0, 0.0);
+	fragColor = lightColor.xyz;
+
+	vec4 lightCameraSpace = ubo.view * vec4(lightPosition.xyz, 1.0);
+	vec4 positionCameraSpace = lightCameraSpace + lightPosition.w * vec4(fragOffset, 0.0, 0.0);
 
 	gl_Position = ubo.projection * positionCameraSpace;
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
 layout(set = 0, binding = 1) uniform sampler2D texSampler[8];
 layout(location = 0) in vec3 fragColor;
@@ -14,8 +15,12 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 	vec4 ambientLightColor; // w is intensity
 	vec3 lightPosition;
 	vec4 lightColor;
+	uvec4 clusterGrid;		// Clusters along x, y and z, w is the light count
+	vec4 clusterParams;		// Slice scale and bias, then the framebuffer's width and height
 } ubo;
 
+#include "cluster_lighting.glsl"
+
 layout(set = 1, binding = 0) uniform ObjectUniformData {
     uint texIndex;
 } u_ObjData;
@@ -39,6 +44,6 @@ void main() {
 	vec3 ambientLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
 	vec3 diffuseLight = lightColor * max(dot(normalize(fragNormalWorld), normalize(directionToLight)), 0);
 
-    outColor = vec4((diffuseLight + ambientLight) * result.rgb, 1.0);
+    outColor = vec4((diffuseLight + ambientLight + clusterLighting(fragPosWorld, normalize(fragNormalWorld))) * result.rgb, 1.0);
     
 }
\ No newline at end of file
@@ -11,6 +11,9 @@ layout(location = 1) out vec3 f_fragPosWorld;
 layout(location = 2) out vec3 f_fragNormalWorld;
 layout(location = 3) out vec2 f_fragTexCoord;
 
+// Bit for bit what depth_only.vert computes, or the EQUAL depth test behind the pre-pass would fail
+invariant gl_Position;
+
 layout(set = 0, binding = 0) uniform GlobalUbo {
 	mat4 projection;
 	mat4 view;
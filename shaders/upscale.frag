@@ -0,0 +1,40 @@
+#version 450
+
+// The scaled scene up to the swap chain's size, see DynamicResolution
+layout(location = 0) in vec2 uv;
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform sampler2D scene;
+
+layout(push_constant) uniform Push {
+	vec2 uvScale;		// The drawn corner of the target
+	vec2 texelSize;
+	float sharpness;	// 0 is plain bilinear
+} push;
+
+// Bilinear, kept half a texel inside the drawn corner. Past it is whatever an earlier, larger frame left
+vec3 fetch(vec2 at) {
+	vec2 inset = push.texelSize * 0.5;
+	return texture(scene, clamp(at, inset, push.uvScale - inset)).rgb;
+}
+
+void main() {
+	vec2 at = uv * push.uvScale;
+	vec3 center = fetch(at);
+	if (push.sharpness <= 0.0) {
+		outColor = vec4(center, 1.0);
+		return;
+	}
+
+	// Unsharp mask against the four neighbouring source texels, held to their range so edges don't ring
+	vec3 north = fetch(at - vec2(0.0, push.texelSize.y));
+	vec3 south = fetch(at + vec2(0.0, push.texelSize.y));
+	vec3 west  = fetch(at - vec2(push.texelSize.x, 0.0));
+	vec3 east  = fetch(at + vec2(push.texelSize.x, 0.0));
+
+	vec3 blur = (north + south + west + east) * 0.25;
+	vec3 lowest  = min(center, min(min(north, south), min(west, east)));
+	vec3 highest = max(center, max(max(north, south), max(west, east)));
+	outColor = vec4(clamp(center + (center - blur) * push.sharpness, lowest, highest), 1.0);
+}